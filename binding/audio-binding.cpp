@@ -24,6 +24,12 @@
 #include "binding-util.h"
 #include "exception.h"
 
+/* Streams open and prebuffer their file under their own lock,
+ * which can take a while, so let other Ruby threads run.
+ * Sound effects share unlocked state and stay on the GVL */
+#define STREAM_PLAY(exp) callWithoutGVL([&] { exp });
+#define EMITTER_PLAY(exp) GUARD_EXC(exp)
+
 #define DEF_PLAY_STOP_POS(entity) \
 	RB_METHOD(audio_##entity##Play) \
 	{ \
@@ -33,7 +39,10 @@
 		int pitch = 100; \
 		double pos = 0.0; \
         rb_get_args(argc, argv, "z|iif", &filename, &volume, &pitch, &pos RB_ARG_END); \
-		GUARD_EXC( shState->audio().entity##Play(filename, volume, pitch, pos); ) \
+		VALUE pathObj = rb_obj_freeze(rb_str_new_cstr(filename)); \
+		const char *path = RSTRING_PTR(pathObj); \
+		STREAM_PLAY( shState->audio().entity##Play(path, volume, pitch, pos); ) \
+		RB_GC_GUARD(pathObj); \
 		return Qnil; \
 	} \
 	RB_METHOD(audio_##entity##Stop) \
@@ -48,7 +57,7 @@
 		return rb_float_new(shState->audio().entity##Pos()); \
 	}
 
-#define DEF_PLAY_STOP(entity) \
+#define DEF_PLAY_STOP(entity, guard) \
 	RB_METHOD(audio_##entity##Play) \
 	{ \
 		RB_UNUSED_PARAM; \
@@ -56,7 +65,10 @@
 		int volume = 100; \
 		int pitch = 100; \
 		rb_get_args(argc, argv, "z|ii", &filename, &volume, &pitch RB_ARG_END); \
-		GUARD_EXC( shState->audio().entity##Play(filename, volume, pitch); ) \
+		VALUE pathObj = rb_obj_freeze(rb_str_new_cstr(filename)); \
+		const char *path = RSTRING_PTR(pathObj); \
+		guard( shState->audio().entity##Play(path, volume, pitch); ) \
+		RB_GC_GUARD(pathObj); \
 		return Qnil; \
 	} \
 	RB_METHOD(audio_##entity##Stop) \
@@ -111,7 +123,11 @@ RB_METHOD(audio_bgmPlay)
     double pos = 0.0;
     VALUE track = Qnil;
     rb_get_args(argc, argv, "z|iifo", &filename, &volume, &pitch, &pos, &track RB_ARG_END);
-    GUARD_EXC( shState->audio().bgmPlay(filename, volume, pitch, pos, MAYBE_NIL_TRACK(track)); )
+    VALUE pathObj = rb_obj_freeze(rb_str_new_cstr(filename));
+    const char *path = RSTRING_PTR(pathObj);
+    int trackv = MAYBE_NIL_TRACK(track);
+    STREAM_PLAY( shState->audio().bgmPlay(path, volume, pitch, pos, trackv); )
+    RB_GC_GUARD(pathObj);
     return Qnil;
 }
 
@@ -154,7 +170,7 @@ RB_METHOD(audio_bgmSetVolume)
 
 DEF_PLAY_STOP_POS( bgs )
 
-DEF_PLAY_STOP( me )
+DEF_PLAY_STOP( me, STREAM_PLAY )
 
 DEF_AUDIO_PROP_I(GlobalBGMVolume)
 DEF_AUDIO_PROP_I(GlobalSFXVolume)
@@ -173,7 +189,7 @@ RB_METHOD(audio_bgmFade)
 DEF_FADE( bgs )
 DEF_FADE( me )
 
-DEF_PLAY_STOP( se )
+DEF_PLAY_STOP( se, EMITTER_PLAY )
 
 RB_METHOD(audioReset)
 {
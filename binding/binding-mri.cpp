@@ -23,6 +23,7 @@
 #include "filesystem/filesystem.h"
 #include "display/graphics.h"
 #include "display/font.h"
+#include "input/input.h"
 #include "system/system.h"
 
 #include "util/util.h"
@@ -1226,6 +1227,11 @@ static void mriBindingExecute() {
     
     mriBindingInit();
     
+    /* Input logs only reproduce a run if rand() does as well */
+    uint32_t seed;
+    if (shState->input().randomSeed(seed))
+        rb_funcall(rb_mKernel, rb_intern("srand"), 1, UINT2NUM(seed));
+    
     std::string &customScript = conf.customScript;
     if (!customScript.empty())
         runCustomScript(customScript);
@@ -23,8 +23,11 @@
 
 #include "exception.h"
 #include "sharedstate.h"
+#include "graphics.h"
 #include "src/util/util.h"
 
+#include <ruby/thread.h>
+
 #include <assert.h>
 #include <stdarg.h>
 #include <string.h>
@@ -74,6 +77,52 @@ void raiseRbExc(const Exception &exc) {
   rb_raise(excClass, "%s", exc.msg.c_str());
 }
 
+struct NoGVLCall {
+  void (*func)(void *);
+  void *data;
+  bool gfxLock;
+  Exception *exc;
+};
+
+static void *noGVLCallRun(void *arg) {
+  NoGVLCall *call = static_cast<NoGVLCall *>(arg);
+
+  /* Taken without the GVL, so a Ruby thread holding the
+   * GVL while it waits for the lock can't deadlock us */
+  if (call->gfxLock)
+    GFX_LOCK;
+
+  try {
+    call->func(call->data);
+  } catch (const Exception &exc) {
+    call->exc = new Exception(exc);
+  }
+
+  if (call->gfxLock)
+    GFX_UNLOCK;
+
+  return 0;
+}
+
+void callWithoutGVL(void (*func)(void *), void *data, bool gfxLock) {
+  NoGVLCall call = {func, data, gfxLock, 0};
+
+  rb_thread_call_without_gvl(noGVLCallRun, &call, 0, 0);
+
+  if (!call.exc)
+    return;
+
+  /* rb_raise() longjmps out of here, so nothing that needs
+   * destructing may be alive in this frame when it's called */
+  char msg[1024];
+  snprintf(msg, sizeof(msg), "%s", call.exc->msg.c_str());
+
+  VALUE excClass = getRbData()->exc[excToRbExc[call.exc->type]];
+  delete call.exc;
+
+  rb_raise(excClass, "%s", msg);
+}
+
 void raiseDisposedAccess(VALUE self) {
   const char *klassName = RTYPEDDATA_TYPE(self)->wrap_struct_name;
   char buf[32];
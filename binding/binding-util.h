@@ -64,6 +64,20 @@ struct Exception;
 
 void raiseRbExc(const Exception &exc);
 
+/* Runs 'func(data)' with the GVL released, so other Ruby threads
+ * can keep going meanwhile. With 'gfxLock', GFX_LOCK is taken for
+ * the duration; note that it only locks anything while
+ * Graphics.thread_safe is set. 'func' must not touch
+ * any Ruby object or API; an Exception thrown from it is raised
+ * once the GVL has been reacquired. As that longjmps out of the
+ * caller, callers must not hold objects with destructors */
+void callWithoutGVL(void (*func)(void *), void *data, bool gfxLock);
+
+template<typename F>
+static inline void callWithoutGVL(F func, bool gfxLock = false) {
+    callWithoutGVL([](void *f) { (*static_cast<F *>(f))(); }, &func, gfxLock);
+}
+
 #define DECL_TYPE(Klass) extern rb_data_type_t Klass##Type
 
 /* TODO: can mkxp use RUBY_TYPED_FREE_IMMEDIATELY here? */
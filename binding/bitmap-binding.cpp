@@ -28,6 +28,10 @@
 #include "sharedstate.h"
 #include "graphics.h"
 
+#include <algorithm>
+#include <limits.h>
+#include <stdint.h>
+
 DEF_TYPE(Bitmap);
 
 static const char *objAsStringPtr(VALUE obj) {
@@ -60,7 +64,12 @@ RB_METHOD(bitmapInitialize) {
         char *filename;
         rb_get_args(argc, argv, "z", &filename RB_ARG_END);
         
-        GFX_GUARD_EXC(b = new Bitmap(filename);)
+        // Reading and decoding can take a while for large images.
+        // A frozen copy keeps the path safe from other threads
+        VALUE pathObj = rb_obj_freeze(rb_str_new_cstr(filename));
+        const char *path = RSTRING_PTR(pathObj);
+        callWithoutGVL([&] { b = new Bitmap(path); }, true);
+        RB_GC_GUARD(pathObj);
     } else {
         int width, height;
         rb_get_args(argc, argv, "ii", &width, &height RB_ARG_END);
@@ -229,6 +238,66 @@ RB_METHOD(bitmapSetPixel) {
     return self;
 }
 
+/* RGBA byte size of 'rect', raising if it doesn't fit an int */
+static int pixelRectSize(const IntRect &rect) {
+    const uint64_t size = (uint64_t) std::max(rect.w, 0) * (uint64_t) std::max(rect.h, 0) * 4;
+    
+    if (size > INT_MAX)
+        rb_raise(rb_eArgError, "Pixel rectangle too large (%ix%i)", rect.w, rect.h);
+    
+    return (int) size;
+}
+
+RB_METHOD(bitmapGetPixels) {
+    Bitmap *b = getPrivateData<Bitmap>(self);
+    
+    IntRect rect;
+    
+    if (argc == 1) {
+        VALUE rectObj;
+        rb_get_args(argc, argv, "o", &rectObj RB_ARG_END);
+        
+        rect = getPrivateDataCheck<Rect>(rectObj, RectType)->toIntRect();
+    } else {
+        rb_get_args(argc, argv, "iiii", &rect.x, &rect.y, &rect.w, &rect.h RB_ARG_END);
+    }
+    
+    int size = pixelRectSize(rect);
+    VALUE ret = rb_str_new(0, size);
+    
+    GFX_GUARD_EXC(b->getPixels(rect, RSTRING_PTR(ret), size););
+    
+    return ret;
+}
+
+RB_METHOD(bitmapSetPixels) {
+    Bitmap *b = getPrivateData<Bitmap>(self);
+    
+    IntRect rect;
+    VALUE str;
+    
+    if (argc == 2) {
+        VALUE rectObj;
+        rb_get_args(argc, argv, "oo", &rectObj, &str RB_ARG_END);
+        
+        rect = getPrivateDataCheck<Rect>(rectObj, RectType)->toIntRect();
+    } else {
+        rb_get_args(argc, argv, "iiiio", &rect.x, &rect.y, &rect.w, &rect.h,
+                    &str RB_ARG_END);
+    }
+    
+    SafeStringValue(str);
+    
+    pixelRectSize(rect);
+    
+    if (RSTRING_LEN(str) > INT_MAX)
+        rb_raise(rb_eArgError, "Pixel buffer too large (%ld bytes)", (long) RSTRING_LEN(str));
+    
+    GFX_GUARD_EXC(b->setPixels(rect, RSTRING_PTR(str), (int) RSTRING_LEN(str)););
+    
+    return self;
+}
+
 RB_METHOD(bitmapHueChange) {
     Bitmap *b = getPrivateData<Bitmap>(self);
     
@@ -426,7 +495,24 @@ RB_METHOD(bitmapSaveToFile) {
     
     Bitmap *b = getPrivateData<Bitmap>(self);
     
-    GFX_GUARD_EXC(b->saveToFile(RSTRING_PTR(str)););
+    VALUE pathObj = rb_str_new_frozen(str);
+    const char *path = RSTRING_PTR(pathObj);
+    callWithoutGVL([&] { b->saveToFile(path); }, true);
+    RB_GC_GUARD(pathObj);
+    
+    return RUBY_Qnil;
+}
+
+RB_METHOD(bitmapSaveToFileAsync) {
+    RB_UNUSED_PARAM;
+    
+    VALUE str;
+    rb_scan_args(argc, argv, "1", &str);
+    SafeStringValue(str);
+    
+    Bitmap *b = getPrivateData<Bitmap>(self);
+    
+    GFX_GUARD_EXC(b->saveToFileAsync(RSTRING_PTR(str)););
     
     return RUBY_Qnil;
 }
@@ -533,6 +619,83 @@ RB_METHOD(bitmapGotoPlay){
     return RUBY_Qnil;
 }
 
+// Batch versions of the above, taking an Array of Bitmaps. Animations
+// started by one call begin on the same clock tick and stay in step.
+// Every element is checked before any of them is touched, and before
+// anything with a destructor is live, so raising here skips nothing.
+static void checkBitmapArray(VALUE ary)
+{
+    Check_Type(ary, T_ARRAY);
+    
+    for (long i = 0; i < RARRAY_LEN(ary); i++)
+        getPrivateDataCheck<Bitmap>(rb_ary_entry(ary, i), BitmapType);
+}
+
+template<class F>
+static void eachBitmap(VALUE ary, F func)
+{
+    for (long i = 0; i < RARRAY_LEN(ary); i++)
+        func(getPrivateData<Bitmap>(rb_ary_entry(ary, i)));
+}
+
+RB_METHOD(bitmapPlayAll){
+    RB_UNUSED_PARAM;
+    
+    VALUE bitmapsObj;
+    
+    rb_get_args(argc, argv, "o", &bitmapsObj RB_ARG_END);
+    
+    checkBitmapArray(bitmapsObj);
+    
+    GFX_GUARD_EXC(eachBitmap(bitmapsObj, [](Bitmap *b) { b->play(); }););
+    
+    return RUBY_Qnil;
+}
+
+RB_METHOD(bitmapStopAll){
+    RB_UNUSED_PARAM;
+    
+    VALUE bitmapsObj;
+    
+    rb_get_args(argc, argv, "o", &bitmapsObj RB_ARG_END);
+    
+    checkBitmapArray(bitmapsObj);
+    
+    GFX_GUARD_EXC(eachBitmap(bitmapsObj, [](Bitmap *b) { b->stop(); }););
+    
+    return RUBY_Qnil;
+}
+
+RB_METHOD(bitmapGotoStopAll){
+    RB_UNUSED_PARAM;
+    
+    VALUE bitmapsObj;
+    int frame;
+    
+    rb_get_args(argc, argv, "oi", &bitmapsObj, &frame RB_ARG_END);
+    
+    checkBitmapArray(bitmapsObj);
+    
+    GFX_GUARD_EXC(eachBitmap(bitmapsObj, [frame](Bitmap *b) { b->gotoAndStop(frame); }););
+    
+    return RUBY_Qnil;
+}
+
+RB_METHOD(bitmapGotoPlayAll){
+    RB_UNUSED_PARAM;
+    
+    VALUE bitmapsObj;
+    int frame;
+    
+    rb_get_args(argc, argv, "oi", &bitmapsObj, &frame RB_ARG_END);
+    
+    checkBitmapArray(bitmapsObj);
+    
+    GFX_GUARD_EXC(eachBitmap(bitmapsObj, [frame](Bitmap *b) { b->gotoAndPlay(frame); }););
+    
+    return RUBY_Qnil;
+}
+
 RB_METHOD(bitmapFrames){
     RB_UNUSED_PARAM;
     
@@ -751,6 +914,8 @@ void bitmapBindingInit() {
     _rb_define_method(klass, "clear", bitmapClear);
     _rb_define_method(klass, "get_pixel", bitmapGetPixel);
     _rb_define_method(klass, "set_pixel", bitmapSetPixel);
+    _rb_define_method(klass, "get_pixels", bitmapGetPixels);
+    _rb_define_method(klass, "set_pixels", bitmapSetPixels);
     _rb_define_method(klass, "hue_change", bitmapHueChange);
     _rb_define_method(klass, "draw_text", bitmapDrawText);
     _rb_define_method(klass, "text_size", bitmapTextSize);
@@ -758,6 +923,7 @@ void bitmapBindingInit() {
     _rb_define_method(klass, "raw_data", bitmapGetRawData);
     _rb_define_method(klass, "raw_data=", bitmapSetRawData);
     _rb_define_method(klass, "to_file", bitmapSaveToFile);
+    _rb_define_method(klass, "to_file_async", bitmapSaveToFileAsync);
     
     _rb_define_method(klass, "gradient_fill_rect", bitmapGradientFillRect);
     _rb_define_method(klass, "clear_rect", bitmapClearRect);
@@ -774,6 +940,10 @@ void bitmapBindingInit() {
     _rb_define_method(klass, "stop", bitmapStop);
     _rb_define_method(klass, "goto_and_stop", bitmapGotoStop);
     _rb_define_method(klass, "goto_and_play", bitmapGotoPlay);
+    rb_define_class_method(klass, "play_all", bitmapPlayAll);
+    rb_define_class_method(klass, "stop_all", bitmapStopAll);
+    rb_define_class_method(klass, "goto_and_stop_all", bitmapGotoStopAll);
+    rb_define_class_method(klass, "goto_and_play_all", bitmapGotoPlayAll);
     _rb_define_method(klass, "frame_count", bitmapFrames);
     _rb_define_method(klass, "current_frame", bitmapCurrentFrame);
     _rb_define_method(klass, "add_frame", bitmapAddFrame);
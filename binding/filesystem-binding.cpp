@@ -25,6 +25,7 @@
 
 #include "filesystem.h"
 #include "sharedstate.h"
+#include "savewriter.h"
 #include "src/util/util.h"
 
 #include "ruby/encoding.h"
@@ -137,10 +138,39 @@ RB_METHOD(fileIntBinmode) {
 }
 
 
+typedef struct {
+    const char *filename;
+    std::string *bytes;
+    bool hit;
+} takePrefetchedCbArgs;
+
 VALUE
 kernelLoadDataInt(const char *filename, bool rubyExc, bool raw) {
     //rb_gc_start();
     
+    // If the file was prefetched, this may have to wait
+    // for the worker to finish reading it
+    std::string bytes;
+    takePrefetchedCbArgs pfargs {filename, &bytes, false};
+    
+    if (shState->fileSystem().hasPrefetches()) {
+        rb_thread_call_without_gvl([](void* args) -> void* {
+            takePrefetchedCbArgs *a = (takePrefetchedCbArgs*)args;
+            a->hit = shState->fileSystem().takePrefetched(a->filename, *a->bytes);
+            return 0;
+        }, (void*)&pfargs, 0, 0);
+    }
+    
+    if (pfargs.hit) {
+        VALUE data = rb_str_new(bytes.data(), bytes.size());
+        
+        if (raw)
+            return data;
+        
+        VALUE marsh = rb_const_get(rb_cObject, rb_intern("Marshal"));
+        return rb_funcall2(marsh, rb_intern("load"), 1, &data);
+    }
+    
     VALUE port = fileIntForPath(filename, rubyExc);
     VALUE result;
     if (!raw) {
@@ -171,25 +201,105 @@ RB_METHOD(kernelLoadData) {
     return kernelLoadDataInt(RSTRING_PTR(filename), true, rawv);
 }
 
+RB_METHOD(kernelLoadDataPrefetch) {
+    RB_UNUSED_PARAM;
+    
+    VALUE paths;
+    rb_get_args(argc, argv, "o", &paths RB_ARG_END);
+    
+    if (!RB_TYPE_P(paths, RUBY_T_ARRAY)) {
+        VALUE ary = rb_ary_new();
+        rb_ary_push(ary, paths);
+        paths = ary;
+    }
+    
+    for (long i = 0; i < RARRAY_LEN(paths); ++i) {
+        VALUE path = rb_ary_entry(paths, i);
+        SafeStringValue(path);
+        
+        shState->fileSystem().prefetch(RSTRING_PTR(path));
+    }
+    
+    return Qnil;
+}
+
+static void saveWriterFlush() {
+    rb_thread_call_without_gvl([](void*) -> void* {
+        shState->saveWriter().flush();
+        return 0;
+    }, 0, 0, 0);
+}
+
 RB_METHOD(kernelSaveData) {
     RB_UNUSED_PARAM;
     
     VALUE obj;
     VALUE filename;
+    VALUE async;
     
-    rb_get_args(argc, argv, "oS", &obj, &filename RB_ARG_END);
+    rb_scan_args(argc, argv, "21", &obj, &filename, &async);
+    SafeStringValue(filename);
     
-    VALUE file = rb_file_open_str(filename, "wb");
+    bool asyncv = shState->config().asyncSaveData;
+    if (!NIL_P(async))
+        rb_bool_arg(async, &asyncv);
     
     VALUE marsh = rb_const_get(rb_cObject, rb_intern("Marshal"));
     
+    if (asyncv) {
+        // Serialize here, where the object graph can't change
+        // under our feet, and leave the disk to the writer
+        VALUE data = rb_funcall2(marsh, rb_intern("dump"), 1, &obj);
+        std::string bytes(RSTRING_PTR(data), RSTRING_LEN(data));
+        
+        shState->saveWriter().queue(RSTRING_PTR(filename), bytes);
+        shState->fileSystem().dropPrefetched(RSTRING_PTR(filename));
+        
+        return Qnil;
+    }
+    
+    // Don't let an older background write land on top of this one
+    if (shState->saveWriter().isPending(RSTRING_PTR(filename)))
+        saveWriterFlush();
+    
+    VALUE file = rb_file_open_str(filename, "wb");
+    
     VALUE v[] = {obj, file};
     rb_funcall2(marsh, rb_intern("dump"), ARRAY_SIZE(v), v);
     
     rb_io_close(file);
     
+    shState->fileSystem().dropPrefetched(RSTRING_PTR(filename));
+    
     return Qnil;
 }
+
+RB_METHOD(kernelSaveDataPending) {
+    RB_UNUSED_PARAM;
+    
+    VALUE filename = Qnil;
+    rb_scan_args(argc, argv, "01", &filename);
+    
+    if (NIL_P(filename))
+        return rb_bool_new(shState->saveWriter().isPending());
+    
+    SafeStringValue(filename);
+    
+    return rb_bool_new(shState->saveWriter().isPending(RSTRING_PTR(filename)));
+}
+
+RB_METHOD(kernelSaveDataWait) {
+    RB_UNUSED_PARAM;
+    
+    saveWriterFlush();
+    
+    std::string error;
+    if (shState->saveWriter().takeError(error))
+        raiseRbExc(Exception(Exception::MKXPError, "%s", error.c_str()));
+    
+    return Qnil;
+}
+
 static VALUE stringForceUTF8(RB_BLOCK_CALL_FUNC_ARGLIST(arg, callback_arg))
 {
     if (RB_TYPE_P(arg, RUBY_T_STRING) && ENCODING_IS_ASCII8BIT(arg))
@@ -222,7 +332,10 @@ void fileIntBindingInit() {
     _rb_define_method(klass, "close", fileIntClose);
     
     _rb_define_module_function(rb_mKernel, "load_data", kernelLoadData);
+    _rb_define_module_function(rb_mKernel, "load_data_prefetch", kernelLoadDataPrefetch);
     _rb_define_module_function(rb_mKernel, "save_data", kernelSaveData);
+    _rb_define_module_function(rb_mKernel, "save_data_pending?", kernelSaveDataPending);
+    _rb_define_module_function(rb_mKernel, "save_data_wait", kernelSaveDataWait);
     
     /* We overload the built-in 'Marshal::load()' function to silently
      * insert our utf8proc that ensures all read strings will be
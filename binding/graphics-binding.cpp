@@ -22,6 +22,9 @@
 #include "config.h"
 #include "graphics.h"
 #include "sharedstate.h"
+#include "frameprofiler.h"
+#include "imagewriter.h"
+#include "filesystem.h"
 #include "binding-util.h"
 #include "binding-types.h"
 #include "exception.h"
@@ -57,6 +60,27 @@ RB_METHOD(graphicsAverageFrameRate)
     return ret;
 }
 
+RB_METHOD(graphicsFrameTimeStats)
+{
+    RB_UNUSED_PARAM;
+    
+    FrameTimeStats stats;
+    
+    GFX_LOCK;
+    shState->graphics().frameTimeStats(stats);
+    GFX_UNLOCK;
+    
+    VALUE ret = rb_hash_new();
+    rb_hash_aset(ret, ID2SYM(rb_intern("samples")), INT2NUM(stats.samples));
+    rb_hash_aset(ret, ID2SYM(rb_intern("mean")), rb_float_new(stats.mean));
+    rb_hash_aset(ret, ID2SYM(rb_intern("stddev")), rb_float_new(stats.stddev));
+    rb_hash_aset(ret, ID2SYM(rb_intern("min")), rb_float_new(stats.min));
+    rb_hash_aset(ret, ID2SYM(rb_intern("max")), rb_float_new(stats.max));
+    rb_hash_aset(ret, ID2SYM(rb_intern("sleep_slack")), rb_float_new(stats.sleepSlack));
+    
+    return ret;
+}
+
 RB_METHOD(graphicsFreeze)
 {
     RB_UNUSED_PARAM;
@@ -321,12 +345,22 @@ RB_METHOD(graphicsPlayMovie)
     return Qnil;
 }
 
-void graphicsScreenshotInternal(const char *filename)
+RB_METHOD(graphicsScreenshot)
 {
-    GFX_GUARD_EXC(shState->graphics().screenshot(filename););
+    RB_UNUSED_PARAM;
+
+    VALUE filename;
+    rb_scan_args(argc, argv, "1", &filename);
+    SafeStringValue(filename);
+    
+    VALUE pathObj = rb_str_new_frozen(filename);
+    const char *path = RSTRING_PTR(pathObj);
+    callWithoutGVL([&] { shState->graphics().screenshot(path); }, true);
+    RB_GC_GUARD(pathObj);
+    return Qnil;
 }
 
-RB_METHOD(graphicsScreenshot)
+RB_METHOD(graphicsScreenshotAsync)
 {
     RB_UNUSED_PARAM;
 
@@ -334,10 +368,89 @@ RB_METHOD(graphicsScreenshot)
     rb_scan_args(argc, argv, "1", &filename);
     SafeStringValue(filename);
     
-    rb_thread_call_without_gvl([](void* fn) -> void* {
-        graphicsScreenshotInternal((const char*)fn);
-        return 0;
-    }, (void*)RSTRING_PTR(filename), 0, 0);
+    GFX_GUARD_EXC(shState->graphics().screenshotAsync(RSTRING_PTR(filename)););
+    return Qnil;
+}
+
+RB_METHOD(graphicsImageWritesPending)
+{
+    RB_UNUSED_PARAM;
+    
+    VALUE filename = Qnil;
+    rb_scan_args(argc, argv, "01", &filename);
+    
+    if (NIL_P(filename))
+        return rb_bool_new(shState->imageWriter().isPending());
+    
+    SafeStringValue(filename);
+    std::string path = shState->fileSystem().normalize(RSTRING_PTR(filename), 1, 1);
+    
+    return rb_bool_new(shState->imageWriter().isPending(path.c_str()));
+}
+
+RB_METHOD(graphicsWaitImageWrites)
+{
+    RB_UNUSED_PARAM;
+    
+    callWithoutGVL([] { shState->imageWriter().flush(); }, true);
+    
+    std::string error;
+    if (shState->imageWriter().takeError(error))
+        raiseRbExc(Exception(Exception::MKXPError, "%s", error.c_str()));
+    
+    return Qnil;
+}
+
+static VALUE profilePhaseHash(const double *times)
+{
+    VALUE hash = rb_hash_new();
+    
+    for (int i = 0; i < FrameProfiler::PhaseCount; ++i)
+        rb_hash_aset(hash, ID2SYM(rb_intern(FrameProfiler::phaseName((FrameProfiler::Phase) i))),
+                     rb_float_new(times[i]));
+    
+    return hash;
+}
+
+RB_METHOD(graphicsProfile)
+{
+    RB_UNUSED_PARAM;
+    
+    FrameProfiler::FrameTimes times;
+    
+    GFX_LOCK;
+    bool valid = shState->profiler().lastFrame(times);
+    GFX_UNLOCK;
+    
+    if (!valid)
+        return Qnil;
+    
+    VALUE ret = rb_hash_new();
+    rb_hash_aset(ret, ID2SYM(rb_intern("frame")), UINT2NUM(times.frame));
+    rb_hash_aset(ret, ID2SYM(rb_intern("cpu")), profilePhaseHash(times.cpu));
+    rb_hash_aset(ret, ID2SYM(rb_intern("gpu")), times.gpuValid ? profilePhaseHash(times.gpu) : Qnil);
+    
+    return ret;
+}
+
+RB_METHOD(graphicsProfileOutput)
+{
+    RB_UNUSED_PARAM;
+    
+    VALUE csvPath = Qnil, tracePath = Qnil;
+    rb_scan_args(argc, argv, "02", &csvPath, &tracePath);
+    
+    const char *csv = NIL_P(csvPath) ? "" : StringValueCStr(csvPath);
+    const char *trace = NIL_P(tracePath) ? "" : StringValueCStr(tracePath);
+    
+    /* Only outputs that were passed are touched; nil closes one */
+    GFX_GUARD_EXC(
+        if (argc >= 1)
+            shState->profiler().setCsvPath(csv);
+        if (argc >= 2)
+            shState->profiler().setTracePath(trace);
+    );
+    
     return Qnil;
 }
 
@@ -355,6 +468,7 @@ DEF_GRA_PROP_I(SmoothScaling)
 DEF_GRA_PROP_B(IntegerScaling)
 DEF_GRA_PROP_B(LastMileScaling)
 DEF_GRA_PROP_B(Threadsafe)
+DEF_GRA_PROP_B(Profiling)
 
 #define INIT_GRA_PROP_BIND(PropName, prop_name_s) \
 { \
@@ -372,12 +486,16 @@ void graphicsBindingInit()
     _rb_define_module_function(module, "transition", graphicsTransition);
     _rb_define_module_function(module, "frame_reset", graphicsFrameReset);
     _rb_define_module_function(module, "screenshot", graphicsScreenshot);
+    _rb_define_module_function(module, "screenshot_async", graphicsScreenshotAsync);
+    _rb_define_module_function(module, "image_writes_pending?", graphicsImageWritesPending);
+    _rb_define_module_function(module, "wait_image_writes", graphicsWaitImageWrites);
     
     _rb_define_module_function(module, "__reset__", graphicsReset);
     
     INIT_GRA_PROP_BIND( FrameRate,  "frame_rate"  );
     INIT_GRA_PROP_BIND( FrameCount, "frame_count" );
     _rb_define_module_function(module, "average_frame_rate", graphicsAverageFrameRate);
+    _rb_define_module_function(module, "frame_time_stats", graphicsFrameTimeStats);
 
     _rb_define_module_function(module, "width", graphicsWidth);
     _rb_define_module_function(module, "height", graphicsHeight);
@@ -410,4 +528,8 @@ void graphicsBindingInit()
     INIT_GRA_PROP_BIND( IntegerScaling,   "integer_scaling"    );
     INIT_GRA_PROP_BIND( LastMileScaling,  "last_mile_scaling"  );
     INIT_GRA_PROP_BIND( Threadsafe,       "thread_safe"        );
+    
+    INIT_GRA_PROP_BIND( Profiling,        "profiling"          );
+    _rb_define_module_function(module, "profile", graphicsProfile);
+    _rb_define_module_function(module, "profile_output", graphicsProfileOutput);
 }
@@ -164,6 +164,19 @@ RB_METHOD(inputRepeatTime) {
     return rb_float_new(shState->input().repeatTime(num));
 }
 
+RB_METHOD(inputPressTime) {
+    RB_UNUSED_PARAM;
+    
+    rb_check_argc(argc, 1);
+    
+    VALUE button;
+    rb_scan_args(argc, argv, "1", &button);
+    
+    int num = getButtonArg(&button);
+    
+    return rb_float_new(shState->input().pressTime(num));
+}
+
 RB_METHOD(inputPressEx) {
     RB_UNUSED_PARAM;
     
@@ -248,6 +261,20 @@ RB_METHOD(inputRepeatTimeEx) {
     return rb_float_new(shState->input().repeatTimeEx(NUM2INT(button), 1));
 }
 
+RB_METHOD(inputPressTimeEx) {
+    RB_UNUSED_PARAM;
+    
+    VALUE button;
+    rb_scan_args(argc, argv, "1", &button);
+    
+    if (SYMBOL_P(button)) {
+        int num = getScancodeArg(&button);
+        return rb_float_new(shState->input().pressTimeEx(num, 0));
+    }
+    
+    return rb_float_new(shState->input().pressTimeEx(NUM2INT(button), 1));
+}
+
 RB_METHOD(inputDir4) {
     RB_UNUSED_PARAM;
     
@@ -590,12 +617,14 @@ void inputBindingInit() {
     _rb_define_module_function(module, "release?", inputRelease);
     _rb_define_module_function(module, "count", inputCount);
     _rb_define_module_function(module, "time?", inputRepeatTime);
+    _rb_define_module_function(module, "press_time", inputPressTime);
     _rb_define_module_function(module, "pressex?", inputPressEx);
     _rb_define_module_function(module, "triggerex?", inputTriggerEx);
     _rb_define_module_function(module, "repeatex?", inputRepeatEx);
     _rb_define_module_function(module, "releaseex?", inputReleaseEx);
     _rb_define_module_function(module, "repeatcount", inputCountEx);
     _rb_define_module_function(module, "timeex?", inputRepeatTimeEx);
+    _rb_define_module_function(module, "press_timeex", inputPressTimeEx);
     _rb_define_module_function(module, "dir4", inputDir4);
     _rb_define_module_function(module, "dir8", inputDir8);
     
@@ -143,6 +143,89 @@ RB_METHOD(tableSetAt) {
   return argv[argc - 1];
 }
 
+RB_METHOD(tableFill) {
+  Table *t = getPrivateData<Table>(self);
+
+  int value;
+  int x = 0, y = 0, z = 0;
+  int width = t->xSize(), height = t->ySize(), depth = t->zSize();
+
+  rb_get_args(argc, argv, "i|iiiiii", &value, &x, &y, &z, &width, &height,
+              &depth RB_ARG_END);
+
+  t->fill(value, x, y, z, width, height, depth);
+
+  return self;
+}
+
+RB_METHOD(tableCopyRect) {
+  Table *t = getPrivateData<Table>(self);
+
+  VALUE srcObj;
+  int srcX, srcY, srcZ = 0;
+  int width, height, depth;
+  int dstX, dstY, dstZ = 0;
+
+  switch (argc) {
+  case 7:
+    /* 2D form, copies every layer both tables have */
+    rb_get_args(argc, argv, "oiiiiii", &srcObj, &srcX, &srcY, &width, &height,
+                &dstX, &dstY RB_ARG_END);
+    depth = t->zSize();
+    break;
+  case 10:
+    rb_get_args(argc, argv, "oiiiiiiiii", &srcObj, &srcX, &srcY, &srcZ,
+                &width, &height, &depth, &dstX, &dstY, &dstZ RB_ARG_END);
+    break;
+  default:
+    rb_raise(rb_eArgError, "wrong number of arguments (%d for 7 or 10)", argc);
+  }
+
+  Table *src = getPrivateDataCheck<Table>(srcObj, TableType);
+
+  t->copyRect(*src, srcX, srcY, srcZ, width, height, depth, dstX, dstY, dstZ);
+
+  return self;
+}
+
+RB_METHOD(tableBlit) {
+  Table *t = getPrivateData<Table>(self);
+
+  VALUE srcObj;
+  int x = 0, y = 0, z = 0;
+
+  rb_get_args(argc, argv, "o|iii", &srcObj, &x, &y, &z RB_ARG_END);
+
+  Table *src = getPrivateDataCheck<Table>(srcObj, TableType);
+
+  t->copyRect(*src, 0, 0, 0, src->xSize(), src->ySize(), src->zSize(), x, y,
+              z);
+
+  return self;
+}
+
+RB_METHOD(tableToBytes) {
+  RB_UNUSED_PARAM;
+
+  Table *t = getPrivateData<Table>(self);
+
+  VALUE str = rb_str_new(0, t->rawSize());
+  t->getRaw(RSTRING_PTR(str));
+
+  return str;
+}
+
+RB_METHOD(tableFromBytes) {
+  Table *t = getPrivateData<Table>(self);
+
+  VALUE str;
+  rb_get_args(argc, argv, "S", &str RB_ARG_END);
+
+  GUARD_EXC(t->setRaw(RSTRING_PTR(str), RSTRING_LEN(str));)
+
+  return self;
+}
+
 MARSH_LOAD_FUN(Table)
 INITCOPY_FUN(Table)
 
@@ -162,4 +245,9 @@ void tableBindingInit() {
   _rb_define_method(klass, "zsize", tableZSize);
   _rb_define_method(klass, "[]", tableGetAt);
   _rb_define_method(klass, "[]=", tableSetAt);
+  _rb_define_method(klass, "fill", tableFill);
+  _rb_define_method(klass, "copy_rect", tableCopyRect);
+  _rb_define_method(klass, "blit", tableBlit);
+  _rb_define_method(klass, "to_bytes", tableToBytes);
+  _rb_define_method(klass, "from_bytes", tableFromBytes);
 }
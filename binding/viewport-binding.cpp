@@ -75,6 +75,8 @@ DEF_GFX_PROP_OBJ_VAL(Viewport, Tone, Tone, "tone")
 DEF_GFX_PROP_I(Viewport, OX)
 DEF_GFX_PROP_I(Viewport, OY)
 
+DEF_GFX_PROP_B(Viewport, Cache)
+
 void viewportBindingInit() {
     VALUE klass = rb_define_class("Viewport", rb_cObject);
     rb_define_alloc_func(klass, classAllocate<&ViewportType>);
@@ -90,4 +92,5 @@ void viewportBindingInit() {
     INIT_PROP_BIND(Viewport, OY, "oy");
     INIT_PROP_BIND(Viewport, Color, "color");
     INIT_PROP_BIND(Viewport, Tone, "tone");
+    INIT_PROP_BIND(Viewport, Cache, "cache");
 }
@@ -0,0 +1,39 @@
+
+uniform sampler2D texture;
+
+uniform lowp vec4 tone;
+
+uniform lowp float opacity;
+uniform lowp vec4 color;
+
+/* Source rect of one repetition (x, y, w, h),
+ * in normalized texture coordinates */
+uniform vec4 tileRect;
+
+varying vec2 v_texCoord;
+
+const vec3 lumaF = vec3(.299, .587, .114);
+
+void main()
+{
+	/* Wrap into the source rect */
+	vec2 coord = tileRect.xy + mod(v_texCoord - tileRect.xy, tileRect.zw);
+
+	/* Sample source color */
+	vec4 frag = texture2D(texture, coord);
+	
+	/* Apply gray */
+	float luma = dot(frag.rgb, lumaF);
+	frag.rgb = mix(frag.rgb, vec3(luma), tone.w);
+	
+	/* Apply tone */
+	frag.rgb += tone.rgb;
+
+	/* Apply opacity */
+	frag.a *= opacity;
+	
+	/* Apply color */
+	frag.rgb = mix(frag.rgb, color.rgb, color.a);
+	
+	gl_FragColor = frag;
+}
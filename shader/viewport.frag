@@ -0,0 +1,32 @@
+
+uniform sampler2D texture;
+
+uniform lowp vec4 tone;
+uniform lowp vec4 color;
+uniform lowp vec4 flash;
+
+varying vec2 v_texCoord;
+
+const vec3 lumaF = vec3(.299, .587, .114);
+
+void main()
+{
+	/* Sample source color */
+	vec4 frag = texture2D(texture, v_texCoord);
+
+	/* Apply gray */
+	float luma = dot(frag.rgb, lumaF);
+	frag.rgb = mix(frag.rgb, vec3(luma), tone.w);
+
+	/* Apply tone (clamped, as it would be in the
+	 * framebuffer before color and flash blend in) */
+	frag.rgb = clamp(frag.rgb + tone.rgb, 0.0, 1.0);
+
+	/* Apply color */
+	frag.rgb = mix(frag.rgb, color.rgb, color.a);
+
+	/* Apply flash */
+	frag.rgb = mix(frag.rgb, flash.rgb, flash.a);
+
+	gl_FragColor = frag;
+}
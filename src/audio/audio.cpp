@@ -30,6 +30,7 @@
 
 #include <string>
 #include <vector>
+#include <mutex>
 
 #include <SDL_thread.h>
 #include <SDL_timer.h>
@@ -44,6 +45,11 @@ struct AudioPrivate
 
 	SyncPoint &syncPoint;
 
+	/* Guards 'volume' and multi-track operations. The play calls
+	 * run without the GVL, so they can race any other call;
+	 * the streams themselves are guarded by their own locks */
+	std::mutex stateMutex;
+
 	struct
 	{
 		int bgm = 100;
@@ -316,6 +322,8 @@ void Audio::bgmPlay(const char *filename,
                     float pos,
                     int track)
 {
+    std::lock_guard<std::mutex> lock(p->stateMutex);
+    
     int vol = clamp(volume, 0, 100);
     if (track == -127) {
         for (int i = 0; i < (int)p->bgmTracks.size(); i++) {
@@ -333,6 +341,8 @@ void Audio::bgmPlay(const char *filename,
 
 void Audio::bgmStop(int track)
 {
+    std::lock_guard<std::mutex> lock(p->stateMutex);
+    
     if (track == -127) {
         for (auto track : p->bgmTracks)
             track->stop();
@@ -345,6 +355,8 @@ void Audio::bgmStop(int track)
 
 void Audio::bgmFade(int time, int track)
 {
+    std::lock_guard<std::mutex> lock(p->stateMutex);
+    
     if (track == -127) {
         for (auto track : p->bgmTracks)
             track->fadeOut(time);
@@ -357,6 +369,8 @@ void Audio::bgmFade(int time, int track)
 
 int Audio::bgmGetVolume(int track)
 {
+    std::lock_guard<std::mutex> lock(p->stateMutex);
+    
     if (track == -127)
         return p->bgmTracks[0]->getVolume(AudioStream::BaseRatio) * 100;
     
@@ -365,6 +379,8 @@ int Audio::bgmGetVolume(int track)
 
 void Audio::bgmSetVolume(int volume, int track)
 {
+    std::lock_guard<std::mutex> lock(p->stateMutex);
+    
     float vol = clamp(volume, 0, 100) / 100.0;
     if (track == -127) {
         for (auto track : p->bgmTracks)
@@ -382,6 +398,8 @@ void Audio::bgsPlay(const char *filename,
                     int pitch,
                     float pos)
 {
+	std::lock_guard<std::mutex> lock(p->stateMutex);
+
 	int vol = clamp(volume, 0, 100);
 	p->volume.bgsCurrent = vol;
 	p->bgs.play(filename, (vol * p->volume.sfx) / 100, pitch, pos);
@@ -402,6 +420,8 @@ void Audio::mePlay(const char *filename,
                    int volume,
                    int pitch)
 {
+	std::lock_guard<std::mutex> lock(p->stateMutex);
+
 	int vol = clamp(volume, 0, 100);
 	p->volume.meCurrent = vol;
 	p->me.play(filename, (vol * p->volume.bgm) / 100, pitch);
@@ -443,6 +463,8 @@ float Audio::bgsPos()
 
 void Audio::reset()
 {
+    std::lock_guard<std::mutex> lock(p->stateMutex);
+    
     for (auto track : p->bgmTracks) {
     	track->stop();
     }
@@ -464,6 +486,8 @@ int Audio::getGlobalSFXVolume() const
 
 void Audio::setGlobalBGMVolume(int value)
 {
+	std::lock_guard<std::mutex> lock(p->stateMutex);
+
 	p->volume.bgm = clamp(value, 0, 100);
 
 	int i = 0;
@@ -481,6 +505,8 @@ void Audio::setGlobalBGMVolume(int value)
 
 void Audio::setGlobalSFXVolume(int value)
 {
+	std::lock_guard<std::mutex> lock(p->stateMutex);
+
 	p->volume.sfx = clamp(value, 0, 100);
 
 	p->bgs.lockStream();
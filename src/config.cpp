@@ -152,6 +152,9 @@ void Config::read(int argc, char *argv[]) {
         {"fixedFramerate", 0},
         {"frameSkip", false},
         {"syncToRefreshrate", false},
+        {"spinWaitLimiter", true},
+        {"vrrPacing", false},
+        {"skipUnchangedFrames", true},
         {"solidFonts", json::array({})},
 #if defined(__APPLE__) && defined(__aarch64__)
         {"preferMetalRenderer", true},
@@ -167,11 +170,15 @@ void Config::read(int argc, char *argv[]) {
         {"integerScalingActive", false},
         {"integerScalingLastMile", true},
         {"maxTextureSize", 0},
+        {"tileAtlasCacheSize", 64},
+        {"gifResidentFrames", 32},
         {"gameFolder", ""},
         {"anyAltToggleFS", false},
         {"enableReset", false},
         {"enableSettings", true},
         {"allowSymlinks", false},
+        {"asyncSaveData", false},
+        {"pngCompressionLevel", 6},
         {"dataPathOrg", ""},
         {"dataPathApp", ""},
         {"iconPath", ""},
@@ -192,6 +199,13 @@ void Config::read(int argc, char *argv[]) {
         {"JITMinCalls", 10000},
         {"YJITEnable", false},
         {"dumpAtlas", false},
+        {"headless", false},
+        {"headlessDumpInterval", 0},
+        {"headlessDumpPath", ""},
+        {"inputRecordPath", ""},
+        {"inputReplayPath", ""},
+        {"profileCsvPath", ""},
+        {"profileTracePath", ""},
         /*
         {"bindingNames", json::object({
             {"a", "A"},
@@ -214,6 +228,14 @@ try { exp } catch (...) {}
     editor.debug = false;
     editor.battleTest = false;
     
+    /* Command line overrides for the headless and input log
+     * options, applied after the config files are read */
+    bool argHeadless = false;
+    int argDumpInterval = -1;
+    std::string argDumpPath;
+    std::string argRecordPath;
+    std::string argReplayPath;
+    
     if (argc > 1) {
         if (!strcmp(argv[1], "debug") || !strcmp(argv[1], "test"))
             editor.debug = true;
@@ -221,7 +243,17 @@ try { exp } catch (...) {}
             editor.battleTest = true;
         
         for (int i = 1; i < argc; i++) {
-            if (strcmp(argv[i], "debug"))
+            if (!strcmp(argv[i], "--headless"))
+                argHeadless = true;
+            else if (!strncmp(argv[i], "--headless-dump=", 16))
+                argDumpInterval = atoi(argv[i] + 16);
+            else if (!strncmp(argv[i], "--headless-dump-path=", 21))
+                argDumpPath = argv[i] + 21;
+            else if (!strncmp(argv[i], "--record-input=", 15))
+                argRecordPath = argv[i] + 15;
+            else if (!strncmp(argv[i], "--replay-input=", 15))
+                argReplayPath = argv[i] + 15;
+            else if (strcmp(argv[i], "debug"))
                 launchArgs.push_back(argv[i]);
         }
     }
@@ -286,6 +318,9 @@ try { exp } catch (...) {}
     SET_OPT(fixedFramerate, integer);
     SET_OPT(frameSkip, boolean);
     SET_OPT(syncToRefreshrate, boolean);
+    SET_OPT(spinWaitLimiter, boolean);
+    SET_OPT(vrrPacing, boolean);
+    SET_OPT(skipUnchangedFrames, boolean);
     fillStringVec(opts["solidFonts"], solidFonts);
     for (std::string & solidFont : solidFonts)
         std::transform(solidFont.begin(), solidFont.end(), solidFont.begin(),
@@ -298,6 +333,8 @@ try { exp } catch (...) {}
     SET_OPT_CUSTOMKEY(integerScaling.active, integerScalingActive, boolean);
     SET_OPT_CUSTOMKEY(integerScaling.lastMileScaling, integerScalingLastMile, boolean);
     SET_OPT(maxTextureSize, integer);
+    SET_OPT(tileAtlasCacheSize, integer);
+    SET_OPT(gifResidentFrames, integer);
     SET_OPT(anyAltToggleFS, boolean);
     SET_OPT(enableReset, boolean);
     SET_OPT(enableSettings, boolean);
@@ -305,7 +342,16 @@ try { exp } catch (...) {}
     SET_OPT_CUSTOMKEY(BGM.trackCount, BGMTrackCount, integer);
     SET_STRINGOPT(customScript, customScript);
     SET_OPT(useScriptNames, boolean);
+    SET_OPT(asyncSaveData, boolean);
+    SET_OPT(pngCompressionLevel, integer);
     SET_OPT(dumpAtlas, boolean);
+    SET_OPT_CUSTOMKEY(headless.enabled, headless, boolean);
+    SET_OPT_CUSTOMKEY(headless.dumpInterval, headlessDumpInterval, integer);
+    SET_STRINGOPT(headless.dumpPath, headlessDumpPath);
+    SET_STRINGOPT(inputLog.recordPath, inputRecordPath);
+    SET_STRINGOPT(inputLog.replayPath, inputReplayPath);
+    SET_STRINGOPT(profile.csvPath, profileCsvPath);
+    SET_STRINGOPT(profile.tracePath, profileTracePath);
     
     fillStringVec(opts["preloadScript"], preloadScripts);
     fillStringVec(opts["RTP"], rtps);
@@ -353,9 +399,36 @@ try { exp } catch (...) {}
     if (getEnvironmentBool("SteamTenfoot", false))
         fullscreen = true;
     
+    // Headless mode, either from the command line, the environment or the config
+    headless.enabled = argHeadless || getEnvironmentBool("MKXPZ_HEADLESS", headless.enabled);
+    if (argDumpInterval >= 0)
+        headless.dumpInterval = argDumpInterval;
+    if (!argDumpPath.empty())
+        headless.dumpPath = argDumpPath;
+    
+    if (!argRecordPath.empty())
+        inputLog.recordPath = argRecordPath;
+    if (!argReplayPath.empty())
+        inputLog.replayPath = argReplayPath;
+    
+    if (headless.enabled) {
+        // Nothing is presented, so there's nothing to sync to
+        fullscreen = false;
+        vsync = false;
+        syncToRefreshrate = false;
+    }
+    
     raw = optsJ;
 }
 
+bool Config::headlessRequested(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++)
+        if (!strcmp(argv[i], "--headless"))
+            return true;
+    
+    return getEnvironmentBool("MKXPZ_HEADLESS", false);
+}
+
 static void setupScreenSize(Config &conf) {
     if (conf.defScreenW <= 0)
         conf.defScreenW = (conf.rgssVersion == 1 ? 640 : 544);
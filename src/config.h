@@ -63,12 +63,17 @@ struct Config {
     int fixedFramerate;
     bool frameSkip;
     bool syncToRefreshrate;
+    bool spinWaitLimiter;
+    bool vrrPacing;
+    bool skipUnchangedFrames;
     
     std::vector<std::string> solidFonts;
     
     bool subImageFix;
     bool enableBlitting;
     int maxTextureSize;
+    int tileAtlasCacheSize;
+    int gifResidentFrames;
     
     struct {
         bool active;
@@ -82,6 +87,8 @@ struct Config {
     bool enableReset;
     bool enableSettings;
     bool allowSymlinks;
+    bool asyncSaveData;
+    int pngCompressionLevel;
     bool pathCache;
     
     std::string dataPathOrg;
@@ -138,6 +145,28 @@ struct Config {
     } yjit;
 
     bool dumpAtlas;
+    
+    /* Render offscreen without presenting or frame limiting,
+     * for automated benchmarks (--headless) */
+    struct {
+        bool enabled;
+        int dumpInterval;
+        std::string dumpPath;
+    } headless;
+    
+    /* Record the game's input to, or play it back from a
+     * file (--record-input, --replay-input) */
+    struct {
+        std::string recordPath;
+        std::string replayPath;
+    } inputLog;
+    
+    /* Frame profiler output files; profiling starts
+     * enabled when either is set */
+    struct {
+        std::string csvPath;
+        std::string tracePath;
+    } profile;
 
     /*
     // Keybinding action name mappings
@@ -166,6 +195,10 @@ struct Config {
     
     void read(int argc, char *argv[]);
     void readGameINI();
+    
+    /* Checks the command line and environment only, for use
+     * before SDL is initialized */
+    static bool headlessRequested(int argc, char *argv[]);
 };
 
 #endif // CONFIG_H
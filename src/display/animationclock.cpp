@@ -0,0 +1,99 @@
+/*
+** animationclock.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "animationclock.h"
+
+#include <algorithm>
+
+AnimationClock::AnimationClock()
+    : time(0),
+      runningCount(0)
+{}
+
+void AnimationClock::tick(double time)
+{
+	this->time = time;
+
+	for (size_t i = 0; i < pending.size(); ++i)
+	{
+		pending[i]->startTime = time;
+		pending[i]->pending = false;
+	}
+
+	pending.clear();
+
+	/* Durations may have changed since the last tick,
+	 * so a finished timer can also become running again */
+	runningCount = 0;
+
+	for (size_t i = 0; i < started.size(); ++i)
+	{
+		Timer &timer = *started[i];
+
+		timer.running = timer.duration < 0 || elapsed(timer) < timer.duration;
+
+		if (timer.running)
+			++runningCount;
+	}
+
+	for (size_t i = 0; i < started.size(); ++i)
+		started[i]->ticked();
+}
+
+void AnimationClock::start(Timer &timer)
+{
+	if (!timer.started)
+	{
+		timer.started = true;
+		started.push_back(&timer);
+	}
+
+	if (!timer.running)
+	{
+		timer.running = true;
+		++runningCount;
+	}
+
+	if (timer.pending)
+		return;
+
+	timer.pending = true;
+	pending.push_back(&timer);
+}
+
+void AnimationClock::cancel(Timer &timer)
+{
+	if (timer.running)
+	{
+		timer.running = false;
+		--runningCount;
+	}
+
+	if (timer.started)
+	{
+		timer.started = false;
+		started.erase(std::find(started.begin(), started.end(), &timer));
+	}
+
+	if (!timer.pending)
+		return;
+
+	timer.pending = false;
+	pending.erase(std::find(pending.begin(), pending.end(), &timer));
+}
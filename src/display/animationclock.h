@@ -0,0 +1,103 @@
+/*
+** animationclock.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANIMATIONCLOCK_H
+#define ANIMATIONCLOCK_H
+
+#include "sigslot/signal.hpp"
+
+#include <vector>
+
+/* Common time base of all animated Bitmaps. It is ticked once
+ * per rendered frame, and playing animations derive their
+ * current frame from the time of the last tick, so they don't
+ * need any per-frame work of their own and never drift apart.
+ *
+ * Animations started between two ticks begin counting at the
+ * next one; all animations started together stay in step. */
+class AnimationClock
+{
+public:
+	struct Timer
+	{
+		/* Clock time the animation started at */
+		double startTime;
+
+		/* Seconds after which the animation has reached its end
+		 * and stops changing; negative if it never does */
+		double duration;
+
+		/* Emitted on every tick while started, so the owner can
+		 * tell whether its animation moved on. Handlers must
+		 * not start or cancel any timer */
+		sigslot::signal<> ticked;
+
+		Timer()
+		    : startTime(0),
+		      duration(-1),
+		      pending(false),
+		      started(false),
+		      running(false)
+		{}
+
+	private:
+		friend class AnimationClock;
+		bool pending;
+		bool started;
+		bool running;
+	};
+
+	AnimationClock();
+
+	/* Time of the last tick, in seconds */
+	double now() const { return time; }
+
+	/* Advances the clock to 'time', starts every timer that
+	 * was waiting for it and retires those that reached
+	 * the end of their duration */
+	void tick(double time);
+
+	/* Starts 'timer' at the next tick */
+	void start(Timer &timer);
+
+	/* Has to be called before a started
+	 * timer goes out of scope */
+	void cancel(Timer &timer);
+
+	/* Whether any timer was started, hasn't been cancelled
+	 * since and hadn't reached its end at the last tick, ie.
+	 * whether the next tick may change what's on screen */
+	bool hasRunningTimers() const { return runningCount > 0; }
+
+	bool isPending(const Timer &timer) const { return timer.pending; }
+
+	/* Seconds 'timer' has been running; 0 while pending */
+	double elapsed(const Timer &timer) const
+	{
+		return timer.pending ? 0 : time - timer.startTime;
+	}
+
+private:
+	double time;
+	std::vector<Timer*> pending;
+	std::vector<Timer*> started;
+	unsigned int runningCount;
+};
+
+#endif // ANIMATIONCLOCK_H
@@ -41,9 +41,13 @@
 #include "texpool.h"
 #include "shader.h"
 #include "filesystem.h"
+#include "imagewriter.h"
+#include "gifstream.h"
+#include "animationclock.h"
 #include "font.h"
 #include "eventthread.h"
 #include "graphics.h"
+#include "scene.h"
 #include "system.h"
 #include "util/util.h"
 
@@ -52,6 +56,7 @@
 #include "sigslot/signal.hpp"
 
 #include <math.h>
+#include <limits.h>
 #include <algorithm>
 
 extern "C" {
@@ -65,6 +70,13 @@ throw Exception(Exception::MKXPError, \
 "Operation not supported for mega surfaces"); \
 }
 
+/* Upper bound for the textures a mega surface is split into
+ * for drawing; smaller tiles mean finer grained residency */
+#define MEGA_TILE_SIZE 2048
+
+/* Tiles that weren't drawn from for this long are released */
+#define MEGA_TILE_IDLE_MS 2000
+
 #define GUARD_ANIMATED \
 { \
 if (p->animation.enabled) \
@@ -103,6 +115,223 @@ static IntRect normalizedRect(const IntRect &rect)
 }
 
 
+// Software raster ops for mega surfaces, which never get a texture.
+// These go through pixman so they end up on its SIMD compositing paths.
+
+static pixman_image_t *wrapSurface(SDL_Surface *surf)
+{
+    /* ABGR8888 has the same layout as pixman's a8b8g8r8 */
+    return pixman_image_create_bits(PIXMAN_a8b8g8r8, surf->w, surf->h,
+                                    (uint32_t*) surf->pixels, surf->pitch);
+}
+
+static bool clipToSurface(IntRect &rect, SDL_Surface *surf)
+{
+    rect = normalizedRect(rect);
+    
+    int x2 = std::min(rect.x + rect.w, surf->w);
+    int y2 = std::min(rect.y + rect.h, surf->h);
+    
+    rect.x = std::max(rect.x, 0);
+    rect.y = std::max(rect.y, 0);
+    rect.w = x2 - rect.x;
+    rect.h = y2 - rect.y;
+    
+    return rect.w > 0 && rect.h > 0;
+}
+
+/* pixman composites premultiplied colors, while bitmaps store
+ * straight alpha; these convert an area in place */
+static void premultiplyArea(SDL_Surface *surf, const IntRect &rect)
+{
+    for (int y = rect.y; y < rect.y + rect.h; ++y)
+    {
+        uint8_t *px = (uint8_t*) surf->pixels + y*surf->pitch + rect.x*4;
+        
+        for (int x = 0; x < rect.w; ++x, px += 4)
+        {
+            if (px[3] == 255)
+                continue;
+            
+            px[0] = (px[0] * px[3] + 127) / 255;
+            px[1] = (px[1] * px[3] + 127) / 255;
+            px[2] = (px[2] * px[3] + 127) / 255;
+        }
+    }
+}
+
+static void unpremultiplyArea(SDL_Surface *surf, const IntRect &rect)
+{
+    for (int y = rect.y; y < rect.y + rect.h; ++y)
+    {
+        uint8_t *px = (uint8_t*) surf->pixels + y*surf->pitch + rect.x*4;
+        
+        for (int x = 0; x < rect.w; ++x, px += 4)
+        {
+            if (px[3] == 255 || px[3] == 0)
+                continue;
+            
+            px[0] = std::min(255, (px[0] * 255 + px[3] / 2) / px[3]);
+            px[1] = std::min(255, (px[1] * 255 + px[3] / 2) / px[3]);
+            px[2] = std::min(255, (px[2] * 255 + px[3] / 2) / px[3]);
+        }
+    }
+}
+
+static uint32_t colorToPixel(const SDL_PixelFormat *format, const Vec4 &color)
+{
+    return SDL_MapRGBA(format,
+                       clamp<float>(color.x, 0, 1) * 255.0f,
+                       clamp<float>(color.y, 0, 1) * 255.0f,
+                       clamp<float>(color.z, 0, 1) * 255.0f,
+                       clamp<float>(color.w, 0, 1) * 255.0f);
+}
+
+static void megaFillRect(SDL_Surface *surf, IntRect rect, uint32_t pixel)
+{
+    if (!clipToSurface(rect, surf))
+        return;
+    
+    pixman_fill((uint32_t*) surf->pixels, surf->pitch / 4, 32,
+                rect.x, rect.y, rect.w, rect.h, pixel);
+}
+
+static pixman_color_t premultipliedColor(const Vec4 &color)
+{
+    float a = clamp<float>(color.w, 0, 1);
+    
+    pixman_color_t c;
+    c.red   = clamp<float>(color.x, 0, 1) * a * 0xFFFF;
+    c.green = clamp<float>(color.y, 0, 1) * a * 0xFFFF;
+    c.blue  = clamp<float>(color.z, 0, 1) * a * 0xFFFF;
+    c.alpha = a * 0xFFFF;
+    
+    return c;
+}
+
+static void megaGradientFillRect(SDL_Surface *surf, const IntRect &rect,
+                                 const Vec4 &color1, const Vec4 &color2,
+                                 bool vertical)
+{
+    IntRect clipped = rect;
+    
+    if (!clipToSurface(clipped, surf))
+        return;
+    
+    /* Gradient endpoints span the unclipped rect */
+    IntRect norm = normalizedRect(rect);
+    
+    pixman_point_fixed_t p1, p2;
+    p1.x = pixman_int_to_fixed(norm.x);
+    p1.y = pixman_int_to_fixed(norm.y);
+    p2.x = pixman_int_to_fixed(vertical ? norm.x : norm.x + norm.w);
+    p2.y = pixman_int_to_fixed(vertical ? norm.y + norm.h : norm.y);
+    
+    pixman_gradient_stop_t stops[2];
+    stops[0].x = pixman_int_to_fixed(0);
+    stops[0].color = premultipliedColor(color1);
+    stops[1].x = pixman_int_to_fixed(1);
+    stops[1].color = premultipliedColor(color2);
+    
+    pixman_image_t *grad = pixman_image_create_linear_gradient(&p1, &p2, stops, 2);
+    pixman_image_t *dst = wrapSurface(surf);
+    
+    pixman_image_composite32(PIXMAN_OP_SRC, grad, 0, dst,
+                             clipped.x, clipped.y, 0, 0,
+                             clipped.x, clipped.y, clipped.w, clipped.h);
+    
+    pixman_image_unref(dst);
+    pixman_image_unref(grad);
+    
+    unpremultiplyArea(surf, clipped);
+}
+
+/* Samples 'srcRect' of 'src' scaled to 'destRect' of 'dst'. Negative
+ * extents mirror the image, same as on the GPU path. With 'blend' set
+ * the result is composited using the bitmap blit equation (straight
+ * alpha "over", see shader/bitmapBlit.frag), otherwise it replaces
+ * the destination pixels */
+static void megaStretchBlt(SDL_Surface *dst, const IntRect &destRect,
+                           SDL_Surface *src, const IntRect &srcRect,
+                           int opacity, bool smooth, bool blend)
+{
+    IntRect dNorm = normalizedRect(destRect);
+    IntRect sNorm = normalizedRect(srcRect);
+    
+    if (dNorm.w == 0 || dNorm.h == 0 || sNorm.w == 0 || sNorm.h == 0)
+        return;
+    
+    bool flipX = (destRect.w < 0) != (srcRect.w < 0);
+    bool flipY = (destRect.h < 0) != (srcRect.h < 0);
+    
+    double scaleX = (double) sNorm.w / dNorm.w;
+    double scaleY = (double) sNorm.h / dNorm.h;
+    
+    /* Maps destination to source space, relative to
+     * the destination rect origin */
+    pixman_transform_t trans;
+    pixman_transform_init_identity(&trans);
+    trans.matrix[0][0] = pixman_double_to_fixed(flipX ? -scaleX : scaleX);
+    trans.matrix[0][2] = pixman_double_to_fixed(flipX ? sNorm.x + sNorm.w : sNorm.x);
+    trans.matrix[1][1] = pixman_double_to_fixed(flipY ? -scaleY : scaleY);
+    trans.matrix[1][2] = pixman_double_to_fixed(flipY ? sNorm.y + sNorm.h : sNorm.y);
+    
+    pixman_image_t *srcImg = wrapSurface(src);
+    pixman_image_set_transform(srcImg, &trans);
+    pixman_image_set_filter(srcImg, smooth ? PIXMAN_FILTER_BILINEAR : PIXMAN_FILTER_NEAREST, 0, 0);
+    pixman_image_set_repeat(srcImg, PIXMAN_REPEAT_PAD);
+    
+    pixman_image_t *dstImg = wrapSurface(dst);
+    
+    if (!blend)
+    {
+        pixman_image_composite32(PIXMAN_OP_SRC, srcImg, 0, dstImg,
+                                 0, 0, 0, 0,
+                                 dNorm.x, dNorm.y, dNorm.w, dNorm.h);
+    }
+    else
+    {
+        IntRect clipped = dNorm;
+        
+        if (clipToSurface(clipped, dst))
+        {
+            /* Resample into a premultiplied temporary first */
+            SDL_Surface *tmp = SDL_CreateRGBSurface(0, dNorm.w, dNorm.h, 32,
+                                                    dst->format->Rmask, dst->format->Gmask,
+                                                    dst->format->Bmask, dst->format->Amask);
+            
+            if (!tmp)
+            {
+                pixman_image_unref(dstImg);
+                pixman_image_unref(srcImg);
+                throw Exception(Exception::SDLError, "Error creating temporary surface for blitting: %s",
+                                SDL_GetError());
+            }
+            
+            pixman_image_t *tmpImg = wrapSurface(tmp);
+            pixman_image_composite32(PIXMAN_OP_SRC, srcImg, 0, tmpImg,
+                                     0, 0, 0, 0, 0, 0, dNorm.w, dNorm.h);
+            premultiplyArea(tmp, IntRect(0, 0, dNorm.w, dNorm.h));
+            
+            pixman_color_t maskColor = { 0, 0, 0, (uint16_t) (opacity * 0x101) };
+            pixman_image_t *mask = pixman_image_create_solid_fill(&maskColor);
+            
+            premultiplyArea(dst, clipped);
+            pixman_image_composite32(PIXMAN_OP_OVER, tmpImg, mask, dstImg,
+                                     clipped.x - dNorm.x, clipped.y - dNorm.y, 0, 0,
+                                     clipped.x, clipped.y, clipped.w, clipped.h);
+            unpremultiplyArea(dst, clipped);
+            
+            pixman_image_unref(mask);
+            pixman_image_unref(tmpImg);
+            SDL_FreeSurface(tmp);
+        }
+    }
+    
+    pixman_image_unref(dstImg);
+    pixman_image_unref(srcImg);
+}
+
 // libnsgif loading callbacks, taken pretty much straight from their tests
 
 static void *gif_bitmap_create(int width, int height)
@@ -161,54 +390,83 @@ struct BitmapPrivate
         
         bool enabled;
         bool playing;
-        bool needsReset;
         bool loop;
         std::vector<TEXFBO> frames;
         float fps;
         int lastFrame;
-        double startTime, playTime;
+        
+        /* Runs on shState->animationClock() while playing */
+        AnimationClock::Timer timer;
+        
+        /* Frame owners were last notified about */
+        unsigned int shownFrame;
+        
+        /* Long GIFs are played back from a stream instead
+         * of 'frames', which then stays empty */
+        GifStream *stream;
+        
+        inline int frameCount() const {
+            return stream ? stream->frameCount() : (int)frames.size();
+        }
+        
+        inline TEXFBO &frameTex(int i) {
+            return stream ? stream->frame(i) : frames[i];
+        }
+        
+        /* Decodes a streamed animation into 'frames', for
+         * operations that work on all of them at once */
+        void unstream() {
+            if (!stream) return;
+            
+            stream->decodeAll(frames);
+            delete stream;
+            stream = 0;
+        }
         
         inline unsigned int currentFrameIRaw() {
             if (fps <= 0) return lastFrame;
-            return floor(lastFrame + (playTime / (1 / fps)));
+            return floor(lastFrame + shState->animationClock().elapsed(timer) * fps);
         }
         
         unsigned int currentFrameI() {
-            if (!playing || needsReset) return lastFrame;
+            if (!playing || shState->animationClock().isPending(timer)) return lastFrame;
             int i = currentFrameIRaw();
-            return (loop) ? fmod(i, frames.size()) : (i > (int)frames.size() - 1) ? (int)frames.size() - 1 : i;
+            return (loop) ? fmod(i, frameCount()) : (i > frameCount() - 1) ? frameCount() - 1 : i;
         }
         
         inline TEXFBO &currentFrame() {
             int i = currentFrameI();
-            return frames[i];
+            return frameTex(i);
+        }
+        
+        /* Lets the clock know when a non-looping
+         * animation will have reached its last frame */
+        void updateDuration() {
+            if (loop && fps > 0)
+                timer.duration = -1;
+            else if (fps <= 0 || lastFrame >= frameCount() - 1)
+                timer.duration = 0;
+            else
+                timer.duration = (frameCount() - 1 - lastFrame) / fps;
         }
         
         inline void play() {
             playing = true;
-            needsReset = true;
+            shownFrame = lastFrame;
+            updateDuration();
+            shState->animationClock().start(timer);
+            SceneRevision::bump();
         }
         
         inline void stop() {
             lastFrame = currentFrameI();
             playing = false;
+            shState->animationClock().cancel(timer);
+            SceneRevision::bump();
         }
         
         inline void seek(int frame) {
-            lastFrame = clamp(frame, 0, (int)frames.size());
-        }
-        
-        void updateTimer() {
-            if (needsReset) {
-                lastFrame = currentFrameI();
-                playTime = 0;
-                startTime = shState->runTime();
-                needsReset = false;
-                return;
-            }
-            
-            playTime = shState->runTime() - startTime;
-            return;
+            lastFrame = clamp(frame, 0, frameCount());
         }
     } animation;
     
@@ -220,16 +478,46 @@ struct BitmapPrivate
     
     /* "Mega surfaces" are a hack to allow Tilesets to be used
      * whose Bitmaps don't fit into a regular texture. They're
-     * kept in RAM and will throw an error if they're used in
-     * any context other than as Tilesets */
+     * kept in RAM; blits, fills and gradients on them are done
+     * in software, other operations throw an error */
     SDL_Surface *megaSurface;
     
+    /* Mega surfaces are drawn through a grid of textures that
+     * each fit the GPU. Tiles are uploaded from the surface when
+     * first drawn from and re-uploaded when it changes under them.
+     * Tiles that go unused are deleted outright, so only those in
+     * view stay resident (the texture pool would hold on to them) */
+    struct MegaTile
+    {
+        TEXFBO gl;
+        bool dirty;
+        uint32_t lastUse;
+        
+        MegaTile()
+        : dirty(true),
+        lastUse(0)
+        {}
+    };
+    
+    struct
+    {
+        int size;
+        int cols;
+        std::vector<MegaTile> tiles;
+    } megaTiles;
+    
     /* A cached version of the bitmap in client memory, for
      * getPixel calls. Is invalidated any time the bitmap
      * is modified */
     SDL_Surface *surface;
     SDL_PixelFormat *format;
     
+    /* Area of 'surface' written by setPixel that hasn't been
+     * uploaded to the texture yet. Pixel writes are combined
+     * here and flushed as one upload before the texture is
+     * next used by the GPU (see flushPixels) */
+    IntRect pendingPixels;
+    
     /* The 'tainted' area describes which parts of the
      * bitmap are not cleared, ie. don't have 0 opacity.
      * If we're blitting / drawing text to a cleared part
@@ -238,6 +526,9 @@ struct BitmapPrivate
      * ourselves the expensive blending calculation */
     pixman_region16_t tainted;
 
+    /* See Bitmap::contentKey() */
+    std::string contentKey;
+
     // For high-resolution texture replacement.
     Bitmap *selfHires;
     Bitmap *selfLores;
@@ -258,12 +549,11 @@ struct BitmapPrivate
         animation.enabled = false;
         animation.playing = false;
         animation.loop = true;
-        animation.playTime = 0;
-        animation.startTime = 0;
         animation.fps = 0;
         animation.lastFrame = 0;
-        
-        prepareCon = shState->prepareDraw.connect(&BitmapPrivate::prepare, this);
+        animation.shownFrame = 0;
+        animation.stream = 0;
+        animation.timer.ticked.connect(&BitmapPrivate::onAnimationTick, this);
         
         font = &shState->defaultFont();
         pixman_region_init(&tainted);
@@ -272,19 +562,124 @@ struct BitmapPrivate
     ~BitmapPrivate()
     {
         prepareCon.disconnect();
+        shState->animationClock().cancel(animation.timer);
         SDL_FreeFormat(format);
         pixman_region_fini(&tainted);
     }
     
     TEXFBO &getGLTypes() {
-        return (animation.enabled) ? animation.currentFrame() : gl;
+        if (animation.enabled)
+            return animation.currentFrame();
+        
+        flushPixels();
+        
+        return gl;
     }
     
     void prepare()
     {
-        if (!animation.enabled || !animation.playing) return;
+        releaseIdleMegaTiles();
+    }
+    
+    /* A frame advance is a modification like any other, so
+     * owners (and the viewport caches they're in) find out */
+    void onAnimationTick()
+    {
+        unsigned int frame = animation.currentFrameI();
+        
+        if (frame == animation.shownFrame)
+            return;
+        
+        animation.shownFrame = frame;
+        onModified(false);
+    }
+    
+    void initMegaTiles()
+    {
+        megaTiles.size = std::min(glState.caps.maxTexSize, MEGA_TILE_SIZE);
+        megaTiles.cols = (megaSurface->w + megaTiles.size - 1) / megaTiles.size;
+        
+        int rows = (megaSurface->h + megaTiles.size - 1) / megaTiles.size;
+        megaTiles.tiles.resize(megaTiles.cols * rows);
+        
+        /* Only mega surfaces need per-frame work; animations
+         * run off the shared clock */
+        prepareCon = shState->prepareDraw.connect(&BitmapPrivate::prepare, this);
+    }
+    
+    IntRect megaTileRect(int index) const
+    {
+        int x = (index % megaTiles.cols) * megaTiles.size;
+        int y = (index / megaTiles.cols) * megaTiles.size;
+        
+        return IntRect(x, y,
+                       std::min(megaTiles.size, megaSurface->w - x),
+                       std::min(megaTiles.size, megaSurface->h - y));
+    }
+    
+    TEXFBO &megaTile(int index)
+    {
+        MegaTile &tile = megaTiles.tiles[index];
+        IntRect rect = megaTileRect(index);
+        
+        if (tile.gl.tex == TEX::ID(0))
+        {
+            TEXFBO::init(tile.gl);
+            TEXFBO::allocEmpty(tile.gl, rect.w, rect.h);
+            TEXFBO::linkFBO(tile.gl);
+            tile.dirty = true;
+        }
+        
+        if (tile.dirty)
+        {
+            TEX::bind(tile.gl.tex);
+            GLMeta::subRectImageUpload(megaSurface->w, rect.x, rect.y,
+                                       0, 0, rect.w, rect.h, megaSurface, GL_RGBA);
+            GLMeta::subRectImageEnd();
+            
+            tile.dirty = false;
+        }
+        
+        tile.lastUse = SDL_GetTicks();
+        
+        return tile.gl;
+    }
+    
+    /* Marks tiles overlapping 'rect' for re-upload */
+    void dirtyMegaTiles(const IntRect &rect)
+    {
+        IntRect norm = normalizedRect(rect);
+        
+        for (size_t i = 0; i < megaTiles.tiles.size(); ++i)
+        {
+            IntRect part = megaTileRect(i).intersected(norm);
+            
+            if (part.w > 0 && part.h > 0)
+                megaTiles.tiles[i].dirty = true;
+        }
+    }
+    
+    void releaseIdleMegaTiles()
+    {
+        uint32_t now = SDL_GetTicks();
+        
+        for (MegaTile &tile : megaTiles.tiles)
+        {
+            if (tile.gl.tex == TEX::ID(0) || now - tile.lastUse < MEGA_TILE_IDLE_MS)
+                continue;
+            
+            TEXFBO::fini(tile.gl);
+            tile.gl = TEXFBO();
+        }
+    }
+    
+    void releaseMegaTiles()
+    {
+        for (MegaTile &tile : megaTiles.tiles)
+            if (tile.gl.tex != TEX::ID(0))
+                TEXFBO::fini(tile.gl);
         
-        animation.updateTimer();
+        megaTiles.tiles.clear();
     }
     
     void allocSurface()
@@ -294,6 +689,55 @@ struct BitmapPrivate
                                        format->Bmask, format->Amask);
     }
     
+    /* Reads the texture back into the cached client
+     * memory surface, if it isn't valid already */
+    void ensureSurface()
+    {
+        if (surface)
+            return;
+        
+        allocSurface();
+        
+        FBO::bind(gl.fbo);
+        
+        glState.viewport.pushSet(IntRect(0, 0, gl.width, gl.height));
+        
+        ::gl.ReadPixels(0, 0, gl.width, gl.height, GL_RGBA, GL_UNSIGNED_BYTE, surface->pixels);
+        
+        glState.viewport.pop();
+    }
+    
+    void addPendingPixels(const IntRect &rect)
+    {
+        if (pendingPixels.w <= 0 || pendingPixels.h <= 0)
+        {
+            pendingPixels = rect;
+            return;
+        }
+        
+        int x1 = std::min(pendingPixels.x, rect.x);
+        int y1 = std::min(pendingPixels.y, rect.y);
+        int x2 = std::max(pendingPixels.x + pendingPixels.w, rect.x + rect.w);
+        int y2 = std::max(pendingPixels.y + pendingPixels.h, rect.y + rect.h);
+        
+        pendingPixels = IntRect(x1, y1, x2 - x1, y2 - y1);
+    }
+    
+    /* Uploads the pending setPixel area in one go */
+    void flushPixels()
+    {
+        if (pendingPixels.w <= 0 || pendingPixels.h <= 0)
+            return;
+        
+        const IntRect &r = pendingPixels;
+        
+        TEX::bind(gl.tex);
+        GLMeta::subRectImageUpload(surface->w, r.x, r.y, r.x, r.y, r.w, r.h, surface, GL_RGBA);
+        GLMeta::subRectImageEnd();
+        
+        pendingPixels = IntRect();
+    }
+    
     void clearTaintedArea()
     {
         pixman_region_fini(&tainted);
@@ -351,6 +795,7 @@ struct BitmapPrivate
             shader.setTexSize(Vec2i(cframe.width, cframe.height));
             return;
         }
+        flushPixels();
         TEX::bind(gl.tex);
         if (selfLores && substituteLoresSize) {
             shader.setTexSize(Vec2i(selfLores->width(), selfLores->height()));
@@ -360,9 +805,69 @@ struct BitmapPrivate
         }
     }
     
+    /* Draws 'sourceRect' of 'source' into 'destRect', going
+     * through the blend shader if existing contents or reduced
+     * opacity have to be taken into account */
+    void blitTexture(const IntRect &destRect,
+                     TEXFBO &source, const IntRect &sourceRect,
+                     int opacity, bool smooth)
+    {
+        if (opacity == 255 && !touchesTaintedArea(destRect))
+        {
+            /* Fast blit */
+            GLMeta::blitBegin(getGLTypes());
+            GLMeta::blitSource(source);
+            GLMeta::blitRectangle(sourceRect, destRect, smooth);
+            GLMeta::blitEnd();
+            
+            return;
+        }
+        
+        /* Fragment pipeline */
+        float normOpacity = (float) opacity / 255.0f;
+        
+        TEXFBO &gpTex = shState->gpTexFBO(abs(destRect.w), abs(destRect.h));
+        
+        GLMeta::blitBegin(gpTex);
+        GLMeta::blitSource(getGLTypes());
+        GLMeta::blitRectangle(destRect, IntRect(0, 0, abs(destRect.w), abs(destRect.h)));
+        GLMeta::blitEnd();
+        
+        FloatRect bltSubRect((float) sourceRect.x / source.width,
+                             (float) sourceRect.y / source.height,
+                             ((float) source.width / sourceRect.w) * ((float) abs(destRect.w) / gpTex.width),
+                             ((float) source.height / sourceRect.h) * ((float) abs(destRect.h) / gpTex.height));
+        
+        BltShader &shader = shState->shaders().blt;
+        shader.bind();
+        TEX::bind(source.tex);
+        shader.setTexSize(Vec2i(source.width, source.height));
+        shader.setSource();
+        shader.setDestination(gpTex.tex);
+        shader.setSubRect(bltSubRect);
+        shader.setOpacity(normOpacity);
+        
+        Quad &quad = shState->gpQuad();
+        quad.setTexPosRect(sourceRect, destRect);
+        quad.setColor(Vec4(1, 1, 1, normOpacity));
+        
+        bindFBO();
+        pushSetViewport(shader);
+        
+        if (smooth)
+            TEX::setSmooth(true);
+        
+        blitQuad(quad);
+        
+        popViewport();
+        
+        if (smooth)
+            TEX::setSmooth(false);
+    }
+    
     void bindFBO()
     {
-        FBO::bind((animation.enabled) ? animation.currentFrame().fbo : gl.fbo);
+        FBO::bind(getGLTypes().fbo);
     }
     
     void pushSetViewport(ShaderBase &shader) const
@@ -414,12 +919,19 @@ struct BitmapPrivate
     
     void onModified(bool freeSurface = true)
     {
+        contentKey.clear();
+        
         if (surface && freeSurface)
         {
+            /* Anything pending must have been flushed
+             * before the texture was modified */
+            assert(pendingPixels.w <= 0 || pendingPixels.h <= 0);
+            
             SDL_FreeSurface(surface);
             surface = 0;
         }
         
+        SceneRevision::bump();
         self->modified();
     }
 };
@@ -559,6 +1071,7 @@ Bitmap::Bitmap(const char *filename)
                 p->gl.selfHires = &p->selfHires->getGLTypes();
             }
             p->addTaintedArea(rect());
+            p->contentKey = filename;
             return;
         }
         
@@ -578,6 +1091,17 @@ Bitmap::Bitmap(const char *filename)
         if (fcount > fcount_partial) {
             Debug() << "Non-fatal error reading" << filename << ": Only decoded" << fcount_partial << "out of" << fcount << "frames";
         }
+        
+        // Only keep a window of frames on the GPU for long animations
+        int resident = shState->config().gifResidentFrames;
+        if (resident > 0 && fcount_partial > resident) {
+            // Takes over the gif data, also when it throws
+            p->animation.stream = new GifStream(handler.gif, handler.gif_data, resident);
+            
+            p->addTaintedArea(rect());
+            return;
+        }
+        
         for (int i = 0; i < fcount_partial; i++) {
             if (i > 0) {
                 int status = gif_decode_frame(handler.gif, i);
@@ -625,6 +1149,8 @@ Bitmap::Bitmap(const char *filename)
     SDL_Surface *imgSurf = handler.surface;
 
     initFromSurface(imgSurf, hiresBitmap, false);
+    
+    p->contentKey = filename;
 }
 
 Bitmap::Bitmap(int width, int height, bool isHires)
@@ -674,6 +1200,7 @@ Bitmap::Bitmap(void *pixeldata, int width, int height)
         p = new BitmapPrivate(this);
         p->megaSurface = surface;
         SDL_SetSurfaceBlendMode(p->megaSurface, SDL_BLENDMODE_NONE);
+        p->initMegaTiles();
     }
     else
     {
@@ -724,8 +1251,8 @@ Bitmap::Bitmap(const Bitmap &other, int frame)
             GLMeta::blitSource(other.getGLTypes());
         }
         else {
-            auto &frames = other.getFrames();
-            GLMeta::blitSource(frames[clamp(frame, 0, (int)frames.size() - 1)]);
+            auto &animation = other.p->animation;
+            GLMeta::blitSource(animation.frameTex(clamp(frame, 0, animation.frameCount() - 1)));
         }
         GLMeta::blitRectangle(rect(), rect(), true);
         GLMeta::blitEnd();
@@ -736,11 +1263,9 @@ Bitmap::Bitmap(const Bitmap &other, int frame)
         p->animation.width = other.width();
         p->animation.height = other.height();
         p->animation.lastFrame = 0;
-        p->animation.playTime = 0;
-        p->animation.startTime = 0;
         p->animation.loop = other.getLooping();
         
-        for (TEXFBO &sourceframe : other.getFrames()) {
+        for (int i = 0; i < other.p->animation.frameCount(); i++) {
             TEXFBO newframe;
             try {
                 newframe = shState->texPool().request(p->animation.width, p->animation.height);
@@ -751,7 +1276,7 @@ Bitmap::Bitmap(const Bitmap &other, int frame)
             }
             
             GLMeta::blitBegin(newframe);
-            GLMeta::blitSource(sourceframe);
+            GLMeta::blitSource(other.p->animation.frameTex(i));
             GLMeta::blitRectangle(rect(), rect(), true);
             GLMeta::blitEnd();
             
@@ -822,6 +1347,7 @@ void Bitmap::initFromSurface(SDL_Surface *imgSurf, Bitmap *hiresBitmap, bool for
         p->selfHires = hiresBitmap;
         p->megaSurface = imgSurf;
         SDL_SetSurfaceBlendMode(p->megaSurface, SDL_BLENDMODE_NONE);
+        p->initMegaTiles();
     }
     else
     {
@@ -1052,235 +1578,104 @@ void Bitmap::stretchBlt(IntRect destRect,
     if(shrinkRects(sourceRect.y, sourceRect.h, source.height(), destRect.y, destRect.h, height()))
         return;
     
-    SDL_Surface *srcSurf = source.megaSurface();
-    SDL_Surface *blitTemp = 0;
-    bool touchesTaintedArea = p->touchesTaintedArea(destRect);
-    bool unpack_subimage = srcSurf && gl.unpack_subimage;
-    
-    if (!srcSurf && opacity == 255 && !touchesTaintedArea)
+    if (p->megaSurface)
     {
-        /* Fast blit */
-        GLMeta::blitBegin(getGLTypes());
-        GLMeta::blitSource(source.getGLTypes());
-        GLMeta::blitRectangle(sourceRect, destRect, smooth);
-        GLMeta::blitEnd();
+        /* No texture to draw to, composite in software */
+        SDL_Surface *srcSurf = source.megaSurface();
+        SDL_Surface *srcCopy = 0;
+        
+        if (!srcSurf)
+        {
+            source.ensureNonAnimated();
+            source.p->ensureSurface();
+            srcSurf = source.p->surface;
+        }
+        else if (srcSurf == p->megaSurface)
+        {
+            /* Source and destination overlap */
+            srcSurf = srcCopy = SDL_ConvertSurfaceFormat(srcSurf, SDL_PIXELFORMAT_ABGR8888, 0);
+            
+            if (!srcCopy)
+                throw Exception(Exception::SDLError, "Error creating temporary surface for blitting: %s",
+                                SDL_GetError());
+        }
+        
+        bool blend = opacity < 255 || p->touchesTaintedArea(destRect);
+        
+        try
+        {
+            megaStretchBlt(p->megaSurface, destRect, srcSurf, sourceRect, opacity, smooth, blend);
+        }
+        catch (const Exception &e)
+        {
+            if (srcCopy)
+                SDL_FreeSurface(srcCopy);
+            throw e;
+        }
+        
+        if (srcCopy)
+            SDL_FreeSurface(srcCopy);
+        
+        p->dirtyMegaTiles(destRect);
+        p->addTaintedArea(destRect);
+        p->onModified();
+        return;
     }
-    else
+    
+    if (source.p->megaSurface)
     {
-        if (srcSurf)
+        /* Mirror the destination instead of the source,
+         * so the tile parts below can be computed forwards */
+        if (sourceRect.w < 0)
         {
-            SDL_Rect srcRect = sourceRect;
-            bool subImageFix = shState->config().subImageFix;
-            bool srcRectTooBig = srcRect.w > glState.caps.maxTexSize ||
-                                 srcRect.h > glState.caps.maxTexSize;
-            bool srcSurfTooBig = !unpack_subimage && (
-                                     srcSurf->w > glState.caps.maxTexSize || 
-                                     srcSurf->h > glState.caps.maxTexSize
-                                 );
-            
-            if (srcRectTooBig || srcSurfTooBig)
-            {
-                int error;
-                if (srcRectTooBig)
-                {
-                    /* We have to resize it here anyway, so use software resizing */
-                    blitTemp =
-                        SDL_CreateRGBSurface(0, abs(destRect.w), abs(destRect.h), p->format->BitsPerPixel,
-                                             p->format->Rmask, p->format->Gmask,
-                                             p->format->Bmask, p->format->Amask);
-                    if (!blitTemp)
-                        throw Exception(Exception::SDLError, "Error creating temporary surface for blitting: %s",
-                                        SDL_GetError());
-                    
-                    if (smooth)
-                    {
-                        error = SDL_SoftStretchLinear(srcSurf, &srcRect, blitTemp, 0);
-                        smooth = false;
-                    }
-                    else
-                    {
-                        SDL_Rect tmpRect = {0, 0, blitTemp->w, blitTemp->h};
-                        error = SDL_LowerBlitScaled(srcSurf, &srcRect, blitTemp, &tmpRect);
-                    }
-                    unpack_subimage = false;
-                }
-                else
-                {
-                    /* Just crop it, let the shader resize it later */
-                    blitTemp =
-                        SDL_CreateRGBSurface(0, sourceRect.w, sourceRect.h, p->format->BitsPerPixel,
-                                             p->format->Rmask, p->format->Gmask,
-                                             p->format->Bmask, p->format->Amask);
-                    if (!blitTemp)
-                        throw Exception(Exception::SDLError, "Error creating temporary surface for blitting: %s",
-                                        SDL_GetError());
-                    
-                    SDL_Rect tmpRect = {0, 0, blitTemp->w, blitTemp->h};
-                    error = SDL_LowerBlit(srcSurf, &srcRect, blitTemp, &tmpRect);
-                }
-                
-                if (error)
-                {
-                    SDL_FreeSurface(blitTemp);
-                    throw Exception(Exception::SDLError, "Failed to blit surface: %s", SDL_GetError());
-                }
-                
-                srcSurf = blitTemp;
-                
-                sourceRect.w = srcSurf->w;
-                sourceRect.h = srcSurf->h;
-                sourceRect.x = 0;
-                sourceRect.y = 0;
-            }
-            
-            if (opacity == 255 && !touchesTaintedArea)
-            {
-                if (!subImageFix &&
-                    sourceRect.w == destRect.w && sourceRect.h == destRect.h &&
-                    (unpack_subimage || (srcSurf->w == sourceRect.w && srcSurf->h == sourceRect.h))
-                   )
-                {
-                    /* No scaling needed */
-                    TEX::bind(getGLTypes().tex);
-                    if (unpack_subimage)
-                    {
-                        gl.PixelStorei(GL_UNPACK_ROW_LENGTH, srcSurf->w);
-                        gl.PixelStorei(GL_UNPACK_SKIP_PIXELS, sourceRect.x);
-                        gl.PixelStorei(GL_UNPACK_SKIP_ROWS, sourceRect.y);
-                    }
-                    TEX::uploadSubImage(destRect.x, destRect.y,
-                                        destRect.w, destRect.h,
-                                        srcSurf->pixels, GL_RGBA);
-                    
-                    if (unpack_subimage)
-                        GLMeta::subRectImageEnd();
-                }
-                else
-                {
-                    /* Resizing or subImageFix involved: need to use intermediary TexFBO */
-                    TEXFBO *gpTF;
-                    if (unpack_subimage)
-                        gpTF = &shState->gpTexFBO(sourceRect.w, sourceRect.h);
-                    else
-                        gpTF = &shState->gpTexFBO(srcSurf->w, srcSurf->h);
-                    TEX::bind(gpTF->tex);
-                    
-                    if (unpack_subimage)
-                    {
-                        gl.PixelStorei(GL_UNPACK_ROW_LENGTH, srcSurf->w);
-                        gl.PixelStorei(GL_UNPACK_SKIP_PIXELS, sourceRect.x);
-                        gl.PixelStorei(GL_UNPACK_SKIP_ROWS, sourceRect.y);
-                        sourceRect.x = 0;
-                        sourceRect.y = 0;
-                        TEX::uploadSubImage(0, 0, sourceRect.w, sourceRect.h, srcSurf->pixels, GL_RGBA);
-                        GLMeta::subRectImageEnd();
-                    }
-                    else
-                    {
-                        TEX::uploadSubImage(0, 0, srcSurf->w, srcSurf->h, srcSurf->pixels, GL_RGBA);
-                    }
-                    
-                    GLMeta::blitBegin(getGLTypes());
-                    GLMeta::blitSource(*gpTF);
-                    GLMeta::blitRectangle(sourceRect, destRect, smooth);
-                    GLMeta::blitEnd();
-                }
-            }
+            sourceRect.x += sourceRect.w;
+            sourceRect.w = -sourceRect.w;
+            destRect.x += destRect.w;
+            destRect.w = -destRect.w;
         }
-        if (opacity < 255 || touchesTaintedArea)
+        
+        if (sourceRect.h < 0)
         {
-            /* We're touching a tainted area or still need to reduce opacity */
-             
-            /* Fragment pipeline */
-            float normOpacity = (float) opacity / 255.0f;
-            
-            TEXFBO &gpTex = shState->gpTexFBO(abs(destRect.w), abs(destRect.h));
-            Vec2i gpTexSize;
-            
-            GLMeta::blitBegin(gpTex);
-            GLMeta::blitSource(getGLTypes());
-            GLMeta::blitRectangle(destRect, IntRect(0, 0, abs(destRect.w), abs(destRect.h)));
-            GLMeta::blitEnd();
-            
-            int sourceWidth, sourceHeight;
-            FloatRect bltSubRect;
-            if (srcSurf)
-            {
-                if (unpack_subimage)
-                {
-                    shState->ensureTexSize(sourceRect.w, sourceRect.h, gpTexSize);
-                }
-                else
-                {
-                    shState->ensureTexSize(srcSurf->w, srcSurf->h, gpTexSize);
-                }
-                sourceWidth = gpTexSize.x;
-                sourceHeight = gpTexSize.y;
-                
-                shState->bindTex();
-                
-                if (unpack_subimage)
-                {
-                    gl.PixelStorei(GL_UNPACK_ROW_LENGTH, srcSurf->w);
-                    gl.PixelStorei(GL_UNPACK_SKIP_PIXELS, sourceRect.x);
-                    gl.PixelStorei(GL_UNPACK_SKIP_ROWS, sourceRect.y);
-                    sourceRect.x = 0;
-                    sourceRect.y = 0;
-                    
-                    TEX::uploadSubImage(0, 0, sourceRect.w, sourceRect.h, srcSurf->pixels, GL_RGBA);
-                    GLMeta::subRectImageEnd();
-                }
-                else
-                {
-                    TEX::uploadSubImage(0, 0, srcSurf->w, srcSurf->h, srcSurf->pixels, GL_RGBA);
-                }
-            }
-            else
-            {
-                sourceWidth = source.width();
-                sourceHeight = source.height();
-            }
-            bltSubRect = FloatRect((float) sourceRect.x / sourceWidth,
-                                   (float) sourceRect.y / sourceHeight,
-                                   ((float) sourceWidth / sourceRect.w) * ((float) abs(destRect.w) / gpTex.width),
-                                   ((float) sourceHeight / sourceRect.h) * ((float) abs(destRect.h) / gpTex.height));
-            
-            BltShader &shader = shState->shaders().blt;
-            shader.bind();
-            if (srcSurf)
-            {
-                shader.setTexSize(gpTexSize);
-            }
-            else
-            {
-                source.p->bindTexture(shader, false);
-            }
-            shader.setSource();
-            shader.setDestination(gpTex.tex);
-            shader.setSubRect(bltSubRect);
-            shader.setOpacity(normOpacity);
-            
-            Quad &quad = shState->gpQuad();
-            quad.setTexPosRect(sourceRect, destRect);
-            quad.setColor(Vec4(1, 1, 1, normOpacity));
-            
-            p->bindFBO();
-            p->pushSetViewport(shader);
+            sourceRect.y += sourceRect.h;
+            sourceRect.h = -sourceRect.h;
+            destRect.y += destRect.h;
+            destRect.h = -destRect.h;
+        }
+        
+        if (sourceRect.w == 0 || sourceRect.h == 0)
+            return;
+        
+        /* Blit from each tile under the source rect onto its
+         * share of the destination. Shared edges are computed
+         * the same way on both sides, so parts don't gap.
+         * Filtering would clamp at each tile's edge and leave
+         * seams, so tiles are always sampled nearest */
+        for (int i = 0; i < source.megaTileCount(); ++i)
+        {
+            IntRect tile = source.megaTileRect(i);
+            IntRect part = tile.intersected(sourceRect);
             
-            if (smooth)
-                TEX::setSmooth(true);
+            if (part.w == 0 || part.h == 0)
+                continue;
             
-            p->blitQuad(quad);
+            int dx1 = destRect.x + (int64_t) (part.x - sourceRect.x) * destRect.w / sourceRect.w;
+            int dy1 = destRect.y + (int64_t) (part.y - sourceRect.y) * destRect.h / sourceRect.h;
+            int dx2 = destRect.x + (int64_t) (part.x + part.w - sourceRect.x) * destRect.w / sourceRect.w;
+            int dy2 = destRect.y + (int64_t) (part.y + part.h - sourceRect.y) * destRect.h / sourceRect.h;
             
-            p->popViewport();
+            if (dx1 == dx2 || dy1 == dy2)
+                continue;
             
-            if (smooth)
-                TEX::setSmooth(false);
+            p->blitTexture(IntRect(dx1, dy1, dx2 - dx1, dy2 - dy1),
+                           source.p->megaTile(i),
+                           IntRect(part.x - tile.x, part.y - tile.y, part.w, part.h),
+                           opacity, false);
         }
     }
-    
-    if (blitTemp)
-        SDL_FreeSurface(blitTemp);
+    else
+    {
+        p->blitTexture(destRect, source.getGLTypes(), sourceRect, opacity, smooth);
+    }
     
     p->addTaintedArea(destRect);
     p->onModified();
@@ -1297,7 +1692,6 @@ void Bitmap::fillRect(const IntRect &rect, const Vec4 &color)
 {
     guardDisposed();
     
-    GUARD_MEGA;
     GUARD_ANIMATED;
     
     if (hasHires()) {
@@ -1310,7 +1704,15 @@ void Bitmap::fillRect(const IntRect &rect, const Vec4 &color)
         p->selfHires->fillRect(IntRect(destX, destY, destWidth, destHeight), color);
     }
 
-    p->fillRect(rect, color);
+    if (p->megaSurface)
+    {
+        megaFillRect(p->megaSurface, rect, colorToPixel(p->format, color));
+        p->dirtyMegaTiles(rect);
+    }
+    else
+    {
+        p->fillRect(rect, color);
+    }
     
     if (color.w == 0)
     /* Clear op */
@@ -1336,7 +1738,6 @@ void Bitmap::gradientFillRect(const IntRect &rect,
 {
     guardDisposed();
     
-    GUARD_MEGA;
     GUARD_ANIMATED;
     
     if (hasHires()) {
@@ -1349,6 +1750,16 @@ void Bitmap::gradientFillRect(const IntRect &rect,
         p->selfHires->gradientFillRect(IntRect(destX, destY, destWidth, destHeight), color1, color2, vertical);
     }
 
+    if (p->megaSurface)
+    {
+        megaGradientFillRect(p->megaSurface, rect, color1, color2, vertical);
+        p->dirtyMegaTiles(rect);
+        
+        p->addTaintedArea(rect);
+        p->onModified();
+        return;
+    }
+
     SimpleColorShader &shader = shState->shaders().simpleColor;
     shader.bind();
     shader.setTranslation(Vec2i());
@@ -1393,7 +1804,6 @@ void Bitmap::clearRect(const IntRect &rect)
 {
     guardDisposed();
     
-    GUARD_MEGA;
     GUARD_ANIMATED;
     
     if (hasHires()) {
@@ -1406,7 +1816,15 @@ void Bitmap::clearRect(const IntRect &rect)
         p->selfHires->clearRect(IntRect(destX, destY, destWidth, destHeight));
     }
 
-    p->fillRect(rect, Vec4());
+    if (p->megaSurface)
+    {
+        megaFillRect(p->megaSurface, rect, 0);
+        p->dirtyMegaTiles(rect);
+    }
+    else
+    {
+        p->fillRect(rect, Vec4());
+    }
     
     p->onModified();
 }
@@ -1437,7 +1855,7 @@ void Bitmap::blur()
     glState.blend.pushSet(false);
     glState.viewport.pushSet(IntRect(0, 0, width(), height()));
     
-    TEX::bind(p->gl.tex);
+    TEX::bind(p->getGLTypes().tex);
     FBO::bind(auxTex.fbo);
     
     pass1.bind();
@@ -1568,13 +1986,25 @@ void Bitmap::clear()
 {
     guardDisposed();
     
-    GUARD_MEGA;
     GUARD_ANIMATED;
     
     if (hasHires()) {
         p->selfHires->clear();
     }
 
+    if (p->megaSurface)
+    {
+        megaFillRect(p->megaSurface, rect(), 0);
+        p->dirtyMegaTiles(rect());
+        
+        p->clearTaintedArea();
+        p->onModified();
+        return;
+    }
+
+    /* No point in uploading pixels that are about to be cleared */
+    p->pendingPixels = IntRect();
+    
     p->bindFBO();
     
     glState.clearColor.pushSet(Vec4());
@@ -1585,7 +2015,17 @@ void Bitmap::clear()
     
     p->clearTaintedArea();
     
-    p->onModified();
+    /* Keep the cached surface around so that drawing loops doing
+     * clear + setPixel every frame don't need a texture readback */
+    if (p->surface)
+    {
+        memset(p->surface->pixels, 0, p->surface->pitch * p->surface->h);
+        p->onModified(false);
+    }
+    else
+    {
+        p->onModified();
+    }
 }
 
 static uint32_t &getPixelAt(SDL_Surface *surf, SDL_PixelFormat *form, int x, int y)
@@ -1649,18 +2089,7 @@ Color Bitmap::getPixel(int x, int y) const
     if (x < 0 || y < 0 || x >= width() || y >= height())
         return Vec4();
 
-    if (!p->surface)
-    {
-        p->allocSurface();
-        
-        FBO::bind(p->gl.fbo);
-        
-        glState.viewport.pushSet(IntRect(0, 0, width(), height()));
-        
-        gl.ReadPixels(0, 0, width(), height(), GL_RGBA, GL_UNSIGNED_BYTE, p->surface->pixels);
-        
-        glState.viewport.pop();
-    }
+    p->ensureSurface();
     
     uint32_t pixel = getPixelAt(p->surface, p->format, x, y);
     
@@ -1695,6 +2124,9 @@ void Bitmap::setPixel(int x, int y, const Color &color)
         }
     }
 
+    if (x < 0 || y < 0 || x >= width() || y >= height())
+        return;
+    
     uint8_t pixel[] =
     {
         (uint8_t) clamp<double>(color.red,   0, 255),
@@ -1703,18 +2135,173 @@ void Bitmap::setPixel(int x, int y, const Color &color)
         (uint8_t) clamp<double>(color.alpha, 0, 255)
     };
     
-    TEX::bind(p->gl.tex);
-    TEX::uploadSubImage(x, y, 1, 1, &pixel, GL_RGBA);
+    if (p->surface)
+    {
+        /* Write into the cached surface only; the texture is updated
+         * with a single upload covering all pixels set in the meantime
+         * once it's next drawn from or to */
+        uint32_t &surfPixel = getPixelAt(p->surface, p->format, x, y);
+        surfPixel = SDL_MapRGBA(p->format, pixel[0], pixel[1], pixel[2], pixel[3]);
+        
+        p->addPendingPixels(IntRect(x, y, 1, 1));
+    }
+    else
+    {
+        /* Reading the whole texture back just to
+         * write one pixel would cost far more */
+        TEX::bind(p->gl.tex);
+        TEX::uploadSubImage(x, y, 1, 1, pixel, GL_RGBA);
+    }
     
     p->addTaintedArea(IntRect(x, y, 1, 1));
     
-    /* Setting just a single pixel is no reason to throw away the
-     * whole cached surface; we can just apply the same change */
+    p->onModified(false);
+}
+
+/* Throws unless 'size' is exactly the RGBA byte size of 'rect' */
+static void checkPixelBufferSize(const IntRect &rect, int size)
+{
+    const uint64_t need = (uint64_t) rect.w * (uint64_t) rect.h * 4;
+    
+    if (need > INT_MAX)
+        throw Exception(Exception::MKXPError, "Pixel rectangle too large (%ix%i)", rect.w, rect.h);
+    
+    if ((uint64_t) size != need)
+        throw Exception(Exception::MKXPError, "Pixel buffer has wrong size (given %i bytes, need %i)",
+                        size, (int) need);
+}
+
+/* Clips 'rect' to the bitmap bounds; 'offset' receives the
+ * position of the clipped area relative to the original rect */
+static bool clipToBitmap(IntRect &rect, Vec2i &offset, int width, int height)
+{
+    offset = Vec2i(std::max(-rect.x, 0), std::max(-rect.y, 0));
+    
+    rect.x += offset.x;
+    rect.y += offset.y;
+    rect.w = std::min(rect.w - offset.x, width - rect.x);
+    rect.h = std::min(rect.h - offset.y, height - rect.y);
+    
+    return rect.w > 0 && rect.h > 0;
+}
+
+void Bitmap::getPixels(const IntRect &rect, void *output, int output_size)
+{
+    guardDisposed();
+    
+    GUARD_MEGA;
+    GUARD_ANIMATED;
+    
+    if (rect.w <= 0 || rect.h <= 0)
+        return;
+    
+    checkPixelBufferSize(rect, output_size);
+    
+    if (hasHires()) {
+        Debug() << "GAME BUG: Game is calling getPixels on low-res Bitmap; you may want to patch the game to improve graphics quality.";
+    }
+    
+    /* Pixels outside of the bitmap read as transparent black */
+    IntRect clipped = rect;
+    Vec2i offset;
+    
+    if (!clipToBitmap(clipped, offset, width(), height()))
+    {
+        memset(output, 0, output_size);
+        return;
+    }
+    
+    if (clipped != rect)
+        memset(output, 0, output_size);
+    
+    p->ensureSurface();
+    
+    const int outPitch = rect.w*4;
+    uint8_t *out = (uint8_t*) output + offset.y*outPitch + offset.x*4;
+    
+    for (int y = 0; y < clipped.h; ++y)
+        memcpy(out + y*outPitch, &getPixelAt(p->surface, p->format, clipped.x, clipped.y + y), clipped.w*4);
+}
+
+void Bitmap::setPixels(const IntRect &rect, const void *data, int size)
+{
+    guardDisposed();
+    
+    GUARD_MEGA;
+    GUARD_ANIMATED;
+    
+    if (rect.w <= 0 || rect.h <= 0)
+        return;
     
+    checkPixelBufferSize(rect, size);
+    
+    if (hasHires()) {
+        Debug() << "GAME BUG: Game is calling setPixels on low-res Bitmap; you may want to patch the game to improve graphics quality.";
+        
+        /* Like setPixel, blow every pixel up to the block
+         * it covers in the hires bitmap */
+        int xScale = p->selfHires->width() / width();
+        int yScale = p->selfHires->height() / height();
+        
+        if (xScale >= 1 && yScale >= 1) {
+            IntRect hiresRect(rect.x * p->selfHires->width() / width(),
+                              rect.y * p->selfHires->height() / height(),
+                              rect.w * xScale, rect.h * yScale);
+            
+            std::vector<uint8_t> scaled((size_t) hiresRect.w * hiresRect.h * 4);
+            const uint8_t *in = (const uint8_t*) data;
+            
+            for (int y = 0; y < hiresRect.h; ++y) {
+                const uint8_t *srcRow = in + (size_t) (y / yScale) * rect.w * 4;
+                uint8_t *dstRow = &scaled[(size_t) y * hiresRect.w * 4];
+                
+                for (int x = 0; x < hiresRect.w; ++x)
+                    memcpy(dstRow + x*4, srcRow + (x / xScale)*4, 4);
+            }
+            
+            p->selfHires->setPixels(hiresRect, dataPtr(scaled), scaled.size());
+        }
+    }
+    
+    IntRect clipped = rect;
+    Vec2i offset;
+    
+    if (!clipToBitmap(clipped, offset, width(), height()))
+        return;
+    
+    const int srcPitch = rect.w*4;
+    const uint8_t *src = (const uint8_t*) data + offset.y*srcPitch + offset.x*4;
+    
+    /* One upload for the whole area */
+    TEX::bind(p->getGLTypes().tex);
+    
+    if (clipped.w == rect.w)
+    {
+        TEX::uploadSubImage(clipped.x, clipped.y, clipped.w, clipped.h, src, GL_RGBA);
+    }
+    else if (gl.unpack_subimage)
+    {
+        gl.PixelStorei(GL_UNPACK_ROW_LENGTH, rect.w);
+        TEX::uploadSubImage(clipped.x, clipped.y, clipped.w, clipped.h, src, GL_RGBA);
+        GLMeta::subRectImageEnd();
+    }
+    else
+    {
+        std::vector<uint8_t> packed(clipped.w*clipped.h*4);
+        
+        for (int y = 0; y < clipped.h; ++y)
+            memcpy(&packed[y*clipped.w*4], src + y*srcPitch, clipped.w*4);
+        
+        TEX::uploadSubImage(clipped.x, clipped.y, clipped.w, clipped.h, dataPtr(packed), GL_RGBA);
+    }
+    
+    p->addTaintedArea(clipped);
+    
+    /* Keep the cached surface in sync instead of discarding it */
     if (p->surface)
     {
-        uint32_t &surfPixel = getPixelAt(p->surface, p->format, x, y);
-        surfPixel = SDL_MapRGBA(p->format, pixel[0], pixel[1], pixel[2], pixel[3]);
+        for (int y = 0; y < clipped.h; ++y)
+            memcpy(&getPixelAt(p->surface, p->format, clipped.x, clipped.y + y), src + y*srcPitch, clipped.w*4);
     }
     
     p->onModified(false);
@@ -1772,57 +2359,41 @@ void Bitmap::saveToFile(const char *filename)
     if (hasHires()) {
         Debug() << "GAME BUG: Game is calling saveToFile on low-res Bitmap; you may want to patch the game to improve graphics quality.";
     }
-
-    SDL_Surface *surf;
+    
+    std::string fn_normalized = shState->fileSystem().normalize(filename, 1, 1);
+    ImageWriter::Format format = ImageWriter::formatForPath(filename);
+    int pngLevel = shState->imageWriter().pngCompression();
     
     if (p->surface || p->megaSurface) {
-        surf = (p->surface) ? p->surface : p->megaSurface;
-    }
-    else {
-        surf = SDL_CreateRGBSurface(0, width(), height(),p->format->BitsPerPixel, p->format->Rmask,p->format->Gmask,p->format->Bmask,p->format->Amask);
-        
-        if (!surf)
-            throw Exception(Exception::SDLError, "Failed to prepare bitmap for saving: %s", SDL_GetError());
-        
-        getRaw(surf->pixels, surf->w * surf->h * 4);
+        SDL_Surface *surf = (p->surface) ? p->surface : p->megaSurface;
+        ImageWriter::writeImage(surf->pixels, surf->w, surf->h, fn_normalized.c_str(), format, pngLevel);
+        return;
     }
     
-    // Try and determine the intended image format from the filename extension
-    const char *period = strrchr(filename, '.');
-    int filetype = 0;
-    if (period) {
-        period++;
-        std::string ext;
-        for (int i = 0; i < (int)strlen(period); i++) {
-            ext += tolower(period[i]);
-        }
-        
-        if (!ext.compare("png")) {
-            filetype = 1;
-        }
-        else if (!ext.compare("jpg") || !ext.compare("jpeg")) {
-            filetype = 2;
-        }
+    std::vector<uint8_t> pixels(width() * height() * 4);
+    getRaw(&pixels[0], pixels.size());
+    
+    ImageWriter::writeImage(&pixels[0], width(), height(), fn_normalized.c_str(), format, pngLevel);
+}
+
+void Bitmap::saveToFileAsync(const char *filename)
+{
+    guardDisposed();
+    
+    if (hasHires()) {
+        Debug() << "GAME BUG: Game is calling saveToFile on low-res Bitmap; you may want to patch the game to improve graphics quality.";
     }
     
     std::string fn_normalized = shState->fileSystem().normalize(filename, 1, 1);
-    int rc;
-    switch (filetype) {
-        case 2:
-            rc = IMG_SaveJPG(surf, fn_normalized.c_str(), 90);
-            break;
-        case 1:
-            rc = IMG_SavePNG(surf, fn_normalized.c_str());
-            break;
-        case 0: default:
-            rc = SDL_SaveBMP(surf, fn_normalized.c_str());
-            break;
-    }
+    ImageWriter &writer = shState->imageWriter();
     
-    if (!p->surface && !p->megaSurface)
-        SDL_FreeSurface(surf);
+    if (p->surface || p->megaSurface) {
+        SDL_Surface *surf = (p->surface) ? p->surface : p->megaSurface;
+        writer.queue(surf->pixels, surf->w, surf->h, fn_normalized.c_str());
+        return;
+    }
     
-    if (rc) throw Exception(Exception::SDLError, "%s", SDL_GetError());
+    writer.capture(getGLTypes().fbo, width(), height(), fn_normalized.c_str());
 }
 
 void Bitmap::hueChange(int hue)
@@ -2215,6 +2786,11 @@ TEXFBO &Bitmap::getGLTypes() const
     return p->getGLTypes();
 }
 
+const std::string &Bitmap::contentKey() const
+{
+    return p->contentKey;
+}
+
 SDL_Surface *Bitmap::surface() const
 {
     if (hasHires()) {
@@ -2238,6 +2814,26 @@ SDL_Surface *Bitmap::megaSurface() const
     return p->megaSurface;
 }
 
+int Bitmap::megaTileCount() const
+{
+    guardDisposed();
+    
+    return p->megaTiles.tiles.size();
+}
+
+IntRect Bitmap::megaTileRect(int index) const
+{
+    return p->megaTileRect(index);
+}
+
+void Bitmap::bindMegaTile(int index, ShaderBase &shader)
+{
+    TEXFBO &tile = p->megaTile(index);
+    
+    TEX::bind(tile.tex);
+    shader.setTexSize(Vec2i(tile.width, tile.height));
+}
+
 void Bitmap::ensureNonMega() const
 {
     if (isDisposed())
@@ -2304,7 +2900,7 @@ bool Bitmap::isPlaying() const
     if (p->animation.loop)
         return true;
     
-    return p->animation.currentFrameIRaw() < p->animation.frames.size();
+    return p->animation.currentFrameIRaw() < (unsigned int)p->animation.frameCount();
 }
 
 void Bitmap::gotoAndStop(int frame)
@@ -2319,6 +2915,7 @@ void Bitmap::gotoAndStop(int frame)
 
     p->animation.stop();
     p->animation.seek(frame);
+    p->onModified(false);
 }
 void Bitmap::gotoAndPlay(int frame)
 {
@@ -2333,6 +2930,7 @@ void Bitmap::gotoAndPlay(int frame)
     p->animation.stop();
     p->animation.seek(frame);
     p->animation.play();
+    p->onModified(false);
 }
 
 int Bitmap::numFrames() const
@@ -2344,7 +2942,7 @@ int Bitmap::numFrames() const
     }
 
     if (!p->animation.enabled) return 1;
-    return (int)p->animation.frames.size();
+    return p->animation.frameCount();
 }
 
 int Bitmap::currentFrameI() const
@@ -2377,6 +2975,8 @@ int Bitmap::addFrame(Bitmap &source, int position)
         throw Exception(Exception::MKXPError, "Animations with varying dimensions are not supported (%ix%i vs %ix%i)",
                         source.width(), source.height(), width(), height());
     
+    p->animation.unstream();
+    
     TEXFBO newframe = shState->texPool().request(source.width(), source.height());
     
     // Convert the bitmap into an animated bitmap if it isn't already one
@@ -2385,16 +2985,16 @@ int Bitmap::addFrame(Bitmap &source, int position)
         p->animation.height = p->gl.height;
         p->animation.enabled = true;
         p->animation.lastFrame = 0;
-        p->animation.playTime = 0;
-        p->animation.startTime = 0;
         
         if (p->animation.fps <= 0)
             p->animation.fps = shState->graphics().getFrameRate();
         
+        p->flushPixels();
         p->animation.frames.push_back(p->gl);
         
         if (p->surface)
             SDL_FreeSurface(p->surface);
+        p->surface = 0;
         p->gl = TEXFBO();
     }
     
@@ -2422,6 +3022,9 @@ int Bitmap::addFrame(Bitmap &source, int position)
         ret = position;
     }
     
+    p->animation.updateDuration();
+    p->onModified(false);
+    
     return ret;
 }
 
@@ -2433,16 +3036,21 @@ void Bitmap::removeFrame(int position) {
     if (hasHires()) {
         Debug() << "BUG: High-res Bitmap removeFrame not implemented";
     }
+    
+    p->animation.unstream();
 
     int pos = (position < 0) ? (int)p->animation.frames.size() - 1 : clamp(position, 0, (int)(p->animation.frames.size() - 1));
     shState->texPool().release(p->animation.frames[pos]);
     p->animation.frames.erase(p->animation.frames.begin() + pos);
+    p->animation.updateDuration();
+    p->onModified(false);
     
     // Change the animated bitmap back to a normal one if there's only one frame left
     if (p->animation.frames.size() == 1) {
         
         p->animation.enabled = false;
         p->animation.playing = false;
+        shState->animationClock().cancel(p->animation.timer);
         p->animation.width = 0;
         p->animation.height = 0;
         p->animation.lastFrame = 0;
@@ -2466,13 +3074,15 @@ void Bitmap::nextFrame()
     }
 
     stop();
-    if ((uint32_t)p->animation.lastFrame >= p->animation.frames.size() - 1)  {
+    if (p->animation.lastFrame >= p->animation.frameCount() - 1)  {
         if (!p->animation.loop) return;
         p->animation.lastFrame = 0;
+        p->onModified(false);
         return;
     }
     
     p->animation.lastFrame++;
+    p->onModified(false);
 }
 
 void Bitmap::previousFrame()
@@ -2491,11 +3101,13 @@ void Bitmap::previousFrame()
             p->animation.lastFrame = 0;
             return;
         }
-        p->animation.lastFrame = (int)p->animation.frames.size() - 1;
+        p->animation.lastFrame = p->animation.frameCount() - 1;
+        p->onModified(false);
         return;
     }
     
     p->animation.lastFrame--;
+    p->onModified(false);
 }
 
 void Bitmap::setAnimationFPS(float FPS)
@@ -2520,6 +3132,8 @@ std::vector<TEXFBO> &Bitmap::getFrames() const
         Debug() << "BUG: High-res Bitmap getFrames not implemented";
     }
 
+    p->animation.unstream();
+
     return p->animation.frames;
 }
 
@@ -2547,6 +3161,10 @@ void Bitmap::setLooping(bool loop)
     }
 
     p->animation.loop = loop;
+    p->animation.updateDuration();
+    
+    /* Also decides what a finished animation shows */
+    p->onModified(false);
 }
 
 bool Bitmap::getLooping() const
@@ -2599,16 +3217,26 @@ void Bitmap::releaseResources()
         delete p->selfHires;
     }
 
+    if (p->surface)
+        SDL_FreeSurface(p->surface);
+    
     if (p->megaSurface)
+    {
+        p->releaseMegaTiles();
         SDL_FreeSurface(p->megaSurface);
+    }
     else if (p->animation.enabled) {
         p->animation.enabled = false;
         p->animation.playing = false;
+        delete p->animation.stream;
         for (TEXFBO &tex : p->animation.frames)
             shState->texPool().release(tex);
     }
     else
         shState->texPool().release(p->gl);
     
+    /* Whatever still showed this bitmap now draws nothing */
+    SceneRevision::bump();
+    
     delete p;
 }
@@ -28,6 +28,8 @@
 
 #include "sigslot/signal.hpp"
 
+#include <string>
+
 class Font;
 class ShaderBase;
 struct TEXFBO;
@@ -94,10 +96,17 @@ public:
 
 	Color getPixel(int x, int y) const;
 	void setPixel(int x, int y, const Color &color);
+
+	/* Packed RGBA access to a whole rectangle at once;
+	 * buffers must hold exactly rect.w*rect.h*4 bytes */
+	void getPixels(const IntRect &rect, void *output, int output_size);
+	void setPixels(const IntRect &rect, const void *data, int size);
     
     bool getRaw(void *output, int output_size);
     void replaceRaw(void *pixel_data, int size);
     void saveToFile(const char *filename);
+    /* Returns right away; see ImageWriter */
+    void saveToFileAsync(const char *filename);
 
 	void hueChange(int hue);
 
@@ -128,6 +137,18 @@ public:
     SDL_Surface *surface() const;
 	SDL_Surface *megaSurface() const;
 	void ensureNonMega() const;
+
+	/* Mega bitmaps are drawn from a grid of tile textures
+	 * (none for regular bitmaps). 'megaTileRect' is a tile's
+	 * area in bitmap coordinates; binding a tile uploads it
+	 * first if it isn't resident or out of date */
+	int megaTileCount() const;
+	IntRect megaTileRect(int index) const;
+	void bindMegaTile(int index, ShaderBase &shader);
+
+	/* The file this bitmap was loaded from, for as long as
+	 * its contents are unmodified; empty otherwise */
+	const std::string &contentKey() const;
     void ensureNonAnimated() const;
     void ensureAnimated() const;
     
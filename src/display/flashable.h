@@ -24,6 +24,7 @@
 
 #include "etc.h"
 #include "etc-internal.h"
+#include "scene.h"
 
 class Flashable
 {
@@ -41,6 +42,8 @@ public:
 		if (duration < 1)
 			return;
 
+		onFlashChange();
+
 		flashing = true;
 		this->duration = duration;
 		counter = 0;
@@ -60,6 +63,8 @@ public:
 		if (!flashing)
 			return;
 
+		onFlashChange();
+
 		if (++counter > duration)
 		{
 			/* Flash finished. Cleanup */
@@ -78,6 +83,9 @@ public:
 	}
 
 protected:
+	/* Called whenever the flash visibly changes */
+	virtual void onFlashChange() { SceneRevision::bump(); }
+
 	Vec4 flashColor;
 	bool flashing;
 	bool emptyFlashFlag;
@@ -0,0 +1,489 @@
+/*
+** frameprofiler.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "frameprofiler.h"
+
+#include "gl-fun.h"
+#include "exception.h"
+
+#include <SDL_timer.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include <utility>
+#include <vector>
+
+/* Frames whose timer queries are still in flight. Beyond
+ * this we stall on the oldest one instead of piling up more */
+#define MAX_PENDING_FRAMES 4
+
+typedef FrameProfiler::Phase Phase;
+
+static const char *phaseNames[] =
+{
+	"script",
+	"graphics",
+	"sprite",
+	"plane",
+	"window",
+	"tilemap",
+	"viewport",
+	"other",
+	"viewport_effects",
+	"scaling",
+	"limiter_sleep",
+	"swap"
+};
+
+static_assert(sizeof(phaseNames) / sizeof(phaseNames[0]) == FrameProfiler::PhaseCount,
+              "phaseNames out of sync with FrameProfiler::Phase");
+
+struct Segment
+{
+	Phase phase;
+	uint64_t start;
+	uint64_t end;
+};
+
+struct PendingFrame
+{
+	unsigned int frame;
+	uint64_t start;
+	uint64_t cpu[FrameProfiler::PhaseCount];
+
+	/* Timer queries in submission order, each one covering
+	 * the span until the next one was started */
+	std::vector<std::pair<GLuint, Phase> > queries;
+
+	/* Only recorded while a trace file is open */
+	std::vector<Segment> segments;
+
+	PendingFrame()
+	    : frame(0),
+	      start(0)
+	{
+		memset(cpu, 0, sizeof(cpu));
+	}
+};
+
+struct FrameProfilerPrivate
+{
+	std::vector<Phase> stack;
+
+	uint64_t freq;
+	uint64_t origin;
+	uint64_t segStart;
+
+	unsigned int frameCounter;
+
+	PendingFrame current;
+	std::deque<PendingFrame> pending;
+
+	std::vector<GLuint> queryPool;
+	std::vector<GLuint> allQueries;
+	bool queryActive;
+
+	bool haveLast;
+	FrameProfiler::FrameTimes last;
+
+	FILE *csv;
+	FILE *trace;
+	bool traceEmpty;
+
+	FrameProfilerPrivate()
+	    : freq(SDL_GetPerformanceFrequency()),
+	      origin(SDL_GetPerformanceCounter()),
+	      segStart(0),
+	      frameCounter(0),
+	      queryActive(false),
+	      haveLast(false),
+	      csv(0),
+	      trace(0),
+	      traceEmpty(true)
+	{}
+
+	~FrameProfilerPrivate()
+	{
+		closeCsv();
+		closeTrace();
+
+		if (!allQueries.empty())
+			gl.DeleteQueries(allQueries.size(), &allQueries[0]);
+	}
+
+	Phase currentPhase() const
+	{
+		return stack.empty() ? FrameProfiler::PhaseScript : stack.back();
+	}
+
+	double toMs(uint64_t ticks) const
+	{
+		return (double) ticks * 1000.0 / freq;
+	}
+
+	double toUs(uint64_t stamp) const
+	{
+		return (double) (stamp - origin) * 1000000.0 / freq;
+	}
+
+	GLuint acquireQuery()
+	{
+		if (!queryPool.empty())
+		{
+			GLuint id = queryPool.back();
+			queryPool.pop_back();
+
+			return id;
+		}
+
+		GLuint id;
+		gl.GenQueries(1, &id);
+		allQueries.push_back(id);
+
+		return id;
+	}
+
+	void endQuery()
+	{
+		if (!queryActive)
+			return;
+
+		gl.EndQuery(GL_TIME_ELAPSED);
+		queryActive = false;
+	}
+
+	void beginQuery(Phase phase)
+	{
+		if (!gl.timer_query)
+			return;
+
+		GLuint id = acquireQuery();
+		gl.BeginQuery(GL_TIME_ELAPSED, id);
+		queryActive = true;
+
+		current.queries.push_back(std::make_pair(id, phase));
+	}
+
+	/* Charges the time since the last transition to the
+	 * phase that was current, and starts timing 'next' */
+	void transition(Phase next)
+	{
+		const uint64_t now = SDL_GetPerformanceCounter();
+		const Phase prev = currentPhase();
+
+		current.cpu[prev] += now - segStart;
+
+		if (trace && now > segStart)
+		{
+			Segment seg = { prev, segStart, now };
+			current.segments.push_back(seg);
+		}
+
+		segStart = now;
+
+		if (next != prev || !queryActive)
+		{
+			endQuery();
+			beginQuery(next);
+		}
+	}
+
+	void startFrame()
+	{
+		current = PendingFrame();
+		current.frame = frameCounter;
+		current.start = segStart = SDL_GetPerformanceCounter();
+
+		beginQuery(FrameProfiler::PhaseScript);
+	}
+
+	/* Hands every frame whose queries have completed over to
+	 * the outputs, or all of them if 'flush' is set */
+	void resolve(bool flush)
+	{
+		bool disjoint = false;
+
+		while (!pending.empty())
+		{
+			PendingFrame &f = pending.front();
+
+			if (!flush && !f.queries.empty() && pending.size() <= MAX_PENDING_FRAMES)
+			{
+				GLint avail = 0;
+				gl.GetQueryObjectiv(f.queries.back().first, GL_QUERY_RESULT_AVAILABLE, &avail);
+
+				if (!avail)
+					break;
+			}
+
+			/* The disjoint flag resets on read, so only check it
+			 * once per batch of frames resolved together */
+			if (gl.timer_query && gl.glsles && !disjoint)
+			{
+				GLint value = 0;
+				gl.GetIntegerv(GL_GPU_DISJOINT_EXT, &value);
+				disjoint = value != 0;
+			}
+
+			FrameProfiler::FrameTimes &t = last;
+
+			t.frame = f.frame;
+			t.gpuValid = gl.timer_query && !disjoint;
+
+			for (int i = 0; i < FrameProfiler::PhaseCount; ++i)
+			{
+				t.cpu[i] = toMs(f.cpu[i]);
+				t.gpu[i] = 0;
+			}
+
+			for (size_t i = 0; i < f.queries.size(); ++i)
+			{
+				uint64_t ns = 0;
+				gl.GetQueryObjectui64v(f.queries[i].first, GL_QUERY_RESULT, &ns);
+				t.gpu[f.queries[i].second] += ns / 1000000.0;
+
+				queryPool.push_back(f.queries[i].first);
+			}
+
+			haveLast = true;
+
+			writeCsv(t);
+			writeTrace(f, t);
+
+			pending.pop_front();
+		}
+	}
+
+	void writeCsv(const FrameProfiler::FrameTimes &t)
+	{
+		if (!csv)
+			return;
+
+		fprintf(csv, "%u", t.frame);
+
+		for (int i = 0; i < FrameProfiler::PhaseCount; ++i)
+			fprintf(csv, ",%.4f", t.cpu[i]);
+
+		for (int i = 0; i < FrameProfiler::PhaseCount; ++i)
+		{
+			if (t.gpuValid)
+				fprintf(csv, ",%.4f", t.gpu[i]);
+			else
+				fputs(",", csv);
+		}
+
+		fputs("\n", csv);
+	}
+
+	void writeTraceEvent(const char *fmt, ...)
+	{
+		va_list ap;
+
+		fputs(traceEmpty ? "[\n" : ",\n", trace);
+		traceEmpty = false;
+
+		va_start(ap, fmt);
+		vfprintf(trace, fmt, ap);
+		va_end(ap);
+	}
+
+	void writeTrace(const PendingFrame &f, const FrameProfiler::FrameTimes &t)
+	{
+		if (!trace || f.segments.empty())
+			return;
+
+		const uint64_t end = f.segments.back().end;
+
+		writeTraceEvent("{\"name\":\"frame %u\",\"cat\":\"frame\",\"ph\":\"X\","
+		                "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+		                t.frame, toUs(f.start), toUs(end) - toUs(f.start));
+
+		for (size_t i = 0; i < f.segments.size(); ++i)
+		{
+			const Segment &seg = f.segments[i];
+
+			writeTraceEvent("{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\","
+			                "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+			                phaseNames[seg.phase], toUs(seg.start),
+			                toUs(seg.end) - toUs(seg.start));
+		}
+
+		if (!t.gpuValid)
+			return;
+
+		/* GPU work has no meaningful start time on the CPU
+		 * timeline, so show it as a per-frame counter track */
+		writeTraceEvent("{\"name\":\"gpu_ms\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{",
+		                toUs(f.start));
+
+		for (int i = 0; i < FrameProfiler::PhaseCount; ++i)
+			fprintf(trace, "%s\"%s\":%.4f", i ? "," : "", phaseNames[i], t.gpu[i]);
+
+		fputs("}}", trace);
+	}
+
+	void closeCsv()
+	{
+		if (!csv)
+			return;
+
+		fclose(csv);
+		csv = 0;
+	}
+
+	void closeTrace()
+	{
+		if (!trace)
+			return;
+
+		fputs(traceEmpty ? "[]\n" : "\n]\n", trace);
+		fclose(trace);
+		trace = 0;
+	}
+};
+
+FrameProfiler::FrameProfiler()
+    : enabled(false),
+      p(new FrameProfilerPrivate)
+{}
+
+FrameProfiler::~FrameProfiler()
+{
+	delete p;
+}
+
+const char *FrameProfiler::phaseName(Phase phase)
+{
+	return phaseNames[phase];
+}
+
+void FrameProfiler::setEnabled(bool value)
+{
+	if (enabled == value)
+		return;
+
+	enabled = value;
+
+	if (enabled)
+	{
+		p->stack.clear();
+		p->startFrame();
+
+		return;
+	}
+
+	/* The partial frame is dropped, but everything
+	 * that was already completed still gets written */
+	p->endQuery();
+
+	for (size_t i = 0; i < p->current.queries.size(); ++i)
+		p->queryPool.push_back(p->current.queries[i].first);
+
+	p->current = PendingFrame();
+	p->resolve(true);
+
+	if (p->csv)
+		fflush(p->csv);
+	if (p->trace)
+		fflush(p->trace);
+}
+
+void FrameProfiler::setCsvPath(const char *path)
+{
+	p->closeCsv();
+
+	if (!*path)
+		return;
+
+	p->csv = fopen(path, "w");
+
+	if (!p->csv)
+		throw Exception(Exception::MKXPError, "Failed to open profile output '%s'", path);
+
+	fputs("frame", p->csv);
+
+	for (int i = 0; i < PhaseCount; ++i)
+		fprintf(p->csv, ",%s_cpu_ms", phaseNames[i]);
+
+	for (int i = 0; i < PhaseCount; ++i)
+		fprintf(p->csv, ",%s_gpu_ms", phaseNames[i]);
+
+	fputs("\n", p->csv);
+}
+
+void FrameProfiler::setTracePath(const char *path)
+{
+	p->closeTrace();
+
+	if (!*path)
+		return;
+
+	p->trace = fopen(path, "w");
+
+	if (!p->trace)
+		throw Exception(Exception::MKXPError, "Failed to open profile output '%s'", path);
+
+	p->traceEmpty = true;
+}
+
+void FrameProfiler::pushInternal(Phase phase)
+{
+	p->transition(phase);
+	p->stack.push_back(phase);
+}
+
+void FrameProfiler::popInternal()
+{
+	if (p->stack.empty())
+		return;
+
+	const Phase next = p->stack.size() > 1
+	        ? p->stack[p->stack.size()-2] : PhaseScript;
+
+	p->transition(next);
+	p->stack.pop_back();
+}
+
+void FrameProfiler::endFrame()
+{
+	if (!enabled)
+		return;
+
+	p->transition(PhaseScript);
+	p->stack.clear();
+	p->endQuery();
+
+	p->pending.push_back(p->current);
+	++p->frameCounter;
+
+	p->startFrame();
+	p->resolve(false);
+}
+
+bool FrameProfiler::lastFrame(FrameTimes &out) const
+{
+	if (!p->haveLast)
+		return false;
+
+	out = p->last;
+
+	return true;
+}
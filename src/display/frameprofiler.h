@@ -0,0 +1,129 @@
+/*
+** frameprofiler.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+struct FrameProfilerPrivate;
+
+/* Splits each frame into phases and measures how much CPU
+ * and GPU time every phase took. Phases nest; time is always
+ * charged to the innermost one, so the per-phase numbers of a
+ * frame add up to its total length. Anything that runs outside
+ * of Graphics.update counts as script time.
+ *
+ * GPU times come from GL timer queries and are read back a few
+ * frames late, so a frame only becomes visible through lastFrame()
+ * (and the output files) once its queries have resolved. */
+class FrameProfiler
+{
+public:
+	enum Phase
+	{
+		PhaseScript,
+		PhaseGraphics,
+		PhaseSprite,
+		PhasePlane,
+		PhaseWindow,
+		PhaseTilemap,
+		PhaseViewport,
+		PhaseOtherElement,
+		PhaseViewportEffects,
+		PhaseScaling,
+		PhaseLimiterSleep,
+		PhaseSwap,
+
+		PhaseCount
+	};
+
+	struct FrameTimes
+	{
+		unsigned int frame;
+
+		/* In milliseconds */
+		double cpu[PhaseCount];
+		double gpu[PhaseCount];
+
+		/* False if timer queries are unavailable, or the
+		 * driver reported the GPU results as unreliable */
+		bool gpuValid;
+	};
+
+	FrameProfiler();
+	~FrameProfiler();
+
+	static const char *phaseName(Phase phase);
+
+	bool isEnabled() const { return enabled; }
+	void setEnabled(bool value);
+
+	/* Empty path closes the respective file */
+	void setCsvPath(const char *path);
+	void setTracePath(const char *path);
+
+	void push(Phase phase)
+	{
+		if (enabled)
+			pushInternal(phase);
+	}
+
+	void pop()
+	{
+		if (enabled)
+			popInternal();
+	}
+
+	/* Closes the current frame and starts the next one.
+	 * Phases left open (eg. by a Ruby exception unwinding
+	 * through Graphics.update) are closed as well */
+	void endFrame();
+
+	/* Returns false if no frame has been completed yet */
+	bool lastFrame(FrameTimes &out) const;
+
+private:
+	void pushInternal(Phase phase);
+	void popInternal();
+
+	bool enabled;
+	FrameProfilerPrivate *p;
+};
+
+/* Charges the enclosing block to 'phase' */
+struct ProfileScope
+{
+	ProfileScope(FrameProfiler &profiler, FrameProfiler::Phase phase)
+	    : profiler(profiler),
+	      active(profiler.isEnabled())
+	{
+		if (active)
+			profiler.push(phase);
+	}
+
+	~ProfileScope()
+	{
+		if (active)
+			profiler.pop();
+	}
+
+	FrameProfiler &profiler;
+	const bool active;
+};
+
+#endif // FRAMEPROFILER_H
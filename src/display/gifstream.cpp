@@ -0,0 +1,412 @@
+/*
+** gifstream.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gifstream.h"
+
+#include "sharedstate.h"
+#include "texpool.h"
+#include "exception.h"
+#include "debugwriter.h"
+#include "sdl-util.h"
+#include "util.h"
+
+extern "C" {
+#include "libnsgif/libnsgif.h"
+}
+
+#include <SDL_thread.h>
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+
+/* Decoded frames the worker may queue up ahead of playback */
+#define GIF_DECODE_AHEAD 4
+
+struct DecodedFrame
+{
+	int index;
+	std::vector<uint8_t> pixels;
+};
+
+struct GifStreamPrivate
+{
+	gif_animation *gif;
+	unsigned char *data;
+
+	int width, height;
+	int count;
+
+	/* Only touched on the thread owning the GL context.
+	 * 'slotFrame' holds the frame each texture currently
+	 * contains (-1 if none); 'nextSlot' is reused next */
+	std::vector<TEXFBO> slots;
+	std::vector<int> slotFrame;
+	size_t nextSlot;
+	size_t lastSlot;
+
+	SDL_Thread *thread;
+	SDL_mutex *mutex;
+	SDL_cond *cond;
+
+	/* Everything below is guarded by 'mutex' */
+
+	/* Decoded frames waiting for upload, in decode order */
+	std::deque<DecodedFrame> ready;
+
+	/* Frame the worker decodes next, the one last handed to
+	 * libnsgif (whose image the next decode builds on), and
+	 * the one being decoded right now (-1 if none) */
+	int nextDecode;
+	int position;
+	int decoding;
+
+	/* While >= 0, decoded frames are dropped until this one */
+	int skipTo;
+
+	/* Set by seeks that need the frames before 'position';
+	 * bumping 'generation' invalidates a decode in flight */
+	bool restart;
+	unsigned int generation;
+
+	std::string error;
+	bool quit;
+
+	GifStreamPrivate(gif_animation *gif, unsigned char *data)
+	    : gif(gif),
+	      data(data),
+	      width(gif->width),
+	      height(gif->height),
+	      count(gif->frame_count_partial),
+	      nextSlot(0),
+	      lastSlot(0),
+	      thread(0),
+	      mutex(SDL_CreateMutex()),
+	      cond(SDL_CreateCond()),
+	      nextDecode(1 % count),
+	      position(0),
+	      decoding(-1),
+	      skipTo(-1),
+	      restart(false),
+	      generation(0),
+	      quit(false)
+	{}
+
+	~GifStreamPrivate()
+	{
+		stopWorker();
+
+		for (size_t i = 0; i < slots.size(); ++i)
+			shState->texPool().release(slots[i]);
+
+		gif_finalise(gif);
+		delete gif;
+		delete[] data;
+
+		SDL_DestroyCond(cond);
+		SDL_DestroyMutex(mutex);
+	}
+
+	void startWorker()
+	{
+		/* A worker that failed stays put, so it isn't retried */
+		if (thread)
+			return;
+
+		quit = false;
+		thread = createSDLThread<GifStreamPrivate, &GifStreamPrivate::run>(this, "gifstream");
+	}
+
+	void stopWorker()
+	{
+		if (!thread)
+			return;
+
+		SDL_LockMutex(mutex);
+		quit = true;
+		SDL_CondBroadcast(cond);
+		SDL_UnlockMutex(mutex);
+
+		SDL_WaitThread(thread, 0);
+		thread = 0;
+	}
+
+	void run()
+	{
+		SDL_LockMutex(mutex);
+
+		while (true)
+		{
+			while (!quit && skipTo < 0 && ready.size() >= GIF_DECODE_AHEAD)
+				SDL_CondWait(cond, mutex);
+
+			if (quit)
+				break;
+
+			if (restart)
+			{
+				nextDecode = 0;
+				restart = false;
+			}
+
+			const int index = nextDecode;
+			const unsigned int gen = generation;
+
+			nextDecode = (index + 1) % count;
+			position = index;
+			decoding = index;
+
+			SDL_UnlockMutex(mutex);
+
+			const gif_result status = gif_decode_frame(gif, index);
+
+			DecodedFrame frame;
+			frame.index = index;
+
+			if (status == GIF_OK || status == GIF_WORKING)
+			{
+				const uint8_t *src = (const uint8_t*) gif->frame_image;
+				frame.pixels.assign(src, src + (size_t) width * height * 4);
+			}
+
+			SDL_LockMutex(mutex);
+
+			decoding = -1;
+
+			if (status != GIF_OK && status != GIF_WORKING)
+			{
+				error = "Failed to decode GIF frame " + std::to_string(index + 1) +
+				        " (Status " + std::to_string(status) + ")";
+				Debug() << error;
+
+				SDL_CondBroadcast(cond);
+				break;
+			}
+
+			if (gen != generation)
+				continue;
+
+			if (skipTo >= 0)
+			{
+				if (index != skipTo)
+					continue;
+
+				skipTo = -1;
+			}
+
+			ready.push_back(DecodedFrame());
+			ready.back().index = index;
+			ready.back().pixels.swap(frame.pixels);
+
+			SDL_CondBroadcast(cond);
+		}
+
+		SDL_UnlockMutex(mutex);
+	}
+
+	bool isQueued(int index) const
+	{
+		for (size_t i = 0; i < ready.size(); ++i)
+			if (ready[i].index == index)
+				return true;
+
+		return false;
+	}
+
+	/* Points the worker at 'index' if it won't get
+	 * there on its own. Expects 'mutex' to be held */
+	void seek(int index)
+	{
+		const bool inFlight = skipTo < 0 ? decoding == index
+		                                 : skipTo == index;
+
+		if (isQueued(index) || inFlight)
+			return;
+
+		ready.clear();
+		skipTo = index;
+
+		if (index <= position)
+		{
+			restart = true;
+			++generation;
+		}
+
+		SDL_CondBroadcast(cond);
+	}
+
+	TEXFBO &upload(int index, const void *pixels)
+	{
+		size_t slot = nextSlot;
+
+		for (size_t i = 0; i < slotFrame.size(); ++i)
+			if (slotFrame[i] < 0)
+			{
+				slot = i;
+				break;
+			}
+
+		if (slot == nextSlot)
+			nextSlot = (nextSlot + 1) % slots.size();
+
+		TEX::bind(slots[slot].tex);
+		TEX::uploadSubImage(0, 0, width, height, pixels, GL_RGBA);
+		slotFrame[slot] = index;
+		lastSlot = slot;
+
+		return slots[slot];
+	}
+
+	/* Most recently uploaded texture, shown when
+	 * the worker failed and can't deliver anymore */
+	TEXFBO &lastUploaded()
+	{
+		return slots[lastSlot];
+	}
+};
+
+GifStream::GifStream(gif_animation *gif, unsigned char *data,
+                     int residentFrames)
+    : p(new GifStreamPrivate(gif, data))
+{
+	const int slotCount = clamp(residentFrames, 2, p->count);
+
+	try
+	{
+		for (int i = 0; i < slotCount; ++i)
+			p->slots.push_back(shState->texPool().request(p->width, p->height));
+	}
+	catch (const Exception &)
+	{
+		delete p;
+		throw;
+	}
+
+	p->slotFrame.assign(slotCount, -1);
+
+	/* Frame 0 has been decoded while loading */
+	p->upload(0, gif->frame_image);
+
+	p->startWorker();
+}
+
+GifStream::~GifStream()
+{
+	delete p;
+}
+
+int GifStream::frameCount() const
+{
+	return p->count;
+}
+
+TEXFBO &GifStream::frame(int index)
+{
+	index = clamp(index, 0, p->count - 1);
+
+	for (size_t i = 0; i < p->slots.size(); ++i)
+		if (p->slotFrame[i] == index)
+			return p->slots[i];
+
+	p->startWorker();
+
+	SDL_LockMutex(p->mutex);
+
+	p->seek(index);
+
+	while (true)
+	{
+		/* Frames before 'index' were skipped by playback */
+		while (!p->ready.empty() && p->ready.front().index != index)
+			p->ready.pop_front();
+
+		if (!p->ready.empty() || !p->error.empty())
+			break;
+
+		SDL_CondBroadcast(p->cond);
+		SDL_CondWait(p->cond, p->mutex);
+	}
+
+	if (p->ready.empty())
+	{
+		SDL_UnlockMutex(p->mutex);
+
+		return p->lastUploaded();
+	}
+
+	DecodedFrame frame;
+	frame.index = index;
+	frame.pixels.swap(p->ready.front().pixels);
+	p->ready.pop_front();
+
+	SDL_CondBroadcast(p->cond);
+	SDL_UnlockMutex(p->mutex);
+
+	return p->upload(index, &frame.pixels[0]);
+}
+
+void GifStream::decodeAll(std::vector<TEXFBO> &out)
+{
+	p->stopWorker();
+
+	/* libnsgif's image is about to be rewound; anything
+	 * queued or in flight refers to the old position */
+	p->ready.clear();
+	p->skipTo = -1;
+	p->restart = true;
+	++p->generation;
+
+	const size_t first = out.size();
+
+	for (int i = 0; i < p->count; ++i)
+	{
+		const gif_result status = gif_decode_frame(p->gif, i);
+
+		if (status != GIF_OK && status != GIF_WORKING)
+		{
+			for (size_t j = first; j < out.size(); ++j)
+				shState->texPool().release(out[j]);
+			out.resize(first);
+
+			throw Exception(Exception::MKXPError, "Failed to decode GIF frame %i out of %i (Status %i)",
+			                i + 1, p->count, status);
+		}
+
+		TEXFBO tex;
+
+		try
+		{
+			tex = shState->texPool().request(p->width, p->height);
+		}
+		catch (const Exception &)
+		{
+			for (size_t j = first; j < out.size(); ++j)
+				shState->texPool().release(out[j]);
+			out.resize(first);
+
+			throw;
+		}
+
+		TEX::bind(tex.tex);
+		TEX::uploadImage(p->width, p->height, p->gif->frame_image, GL_RGBA);
+		out.push_back(tex);
+	}
+
+	p->position = p->count - 1;
+}
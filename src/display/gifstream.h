@@ -0,0 +1,63 @@
+/*
+** gifstream.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GIFSTREAM_H
+#define GIFSTREAM_H
+
+#include "gl-util.h"
+
+#include <vector>
+
+struct gif_animation;
+struct GifStreamPrivate;
+
+/* Plays back a GIF without keeping all of its frames on the GPU.
+ * A worker thread decodes the frames (in order, as GIF frames build
+ * on the previous ones) a few ahead of the one being shown, and they
+ * are uploaded on demand into a fixed ring of textures. However long
+ * the animation, only 'residentFrames' textures exist at a time.
+ *
+ * Jumping backwards restarts decoding from the first frame; frames
+ * that can't be kept up with are decoded, but never uploaded. */
+class GifStream
+{
+public:
+	/* Takes ownership of 'gif' and its 'data'. 'gif' must be
+	 * initialised, with frame 0 decoded. Needs the GL context */
+	GifStream(gif_animation *gif, unsigned char *data,
+	          int residentFrames);
+	/* Needs the GL context */
+	~GifStream();
+
+	int frameCount() const;
+
+	/* Texture holding frame 'index', valid until the next
+	 * call. Blocks if the frame isn't decoded yet */
+	TEXFBO &frame(int index);
+
+	/* Decodes every frame into its own pooled texture and
+	 * appends them to 'out', for operations that need all
+	 * of them at once. Throws an Exception on failure */
+	void decodeAll(std::vector<TEXFBO> &out);
+
+private:
+	GifStreamPrivate *p;
+};
+
+#endif // GIFSTREAM_H
@@ -177,6 +177,61 @@ void initGLFunctions()
         GL_VAO_FUN;
     }
     
+    /* Timer query entrypoints (GL 3.3 core) */
+    const bool gl33 = !gles && (glMajor > 3 || (glMajor == 3 && ver[1] == '.' && ver[2] >= '3'));
+    
+    if (gl33 || (!gles && HAVE_EXT(ARB_timer_query)))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+        GL_TIMER_QUERY_FUN;
+        gl.timer_query = true;
+    }
+    else if (gles && HAVE_EXT(EXT_disjoint_timer_query))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX "EXT"
+        GL_TIMER_QUERY_FUN;
+        gl.timer_query = true;
+    }
+    
+    /* Buffer mapping and sync entrypoints (GL 3.0/3.2 core, GLES 3.0) */
+    const bool gl32 = !gles && (glMajor > 3 || (glMajor == 3 && ver[1] == '.' && ver[2] >= '2'));
+    
+    if (glMajor >= 3 || HAVE_EXT(ARB_map_buffer_range))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+        GL_MAP_BUFFER_FUN;
+        gl.map_buffer_range = true;
+    }
+    
+    if (gl32 || (gles && glMajor >= 3) || HAVE_EXT(ARB_sync))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+        GL_SYNC_FUN;
+        gl.sync = true;
+    }
+    
+    /* Persistent buffer mapping entrypoints (GL 4.4 core) */
+    const bool gl44 = !gles && (glMajor > 4 || (glMajor == 4 && ver[1] == '.' && ver[2] >= '4'));
+    
+    if (gl44 || (!gles && HAVE_EXT(ARB_buffer_storage)))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+        GL_BUFFER_STORAGE_FUN;
+        gl.buffer_storage = true;
+    }
+    else if (gles && HAVE_EXT(EXT_buffer_storage))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX "EXT"
+        GL_BUFFER_STORAGE_FUN;
+        gl.buffer_storage = true;
+    }
+    
     /* Debug callback entrypoints */
     if (HAVE_EXT(KHR_debug))
     {
@@ -33,6 +33,7 @@
 typedef GLenum (APIENTRYP _PFNGLGETERRORPROC) (void);
 typedef void (APIENTRYP _PFNGLCLEARCOLORPROC) (GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha);
 typedef void (APIENTRYP _PFNGLCLEARPROC) (GLbitfield mask);
+typedef void (APIENTRYP _PFNGLFINISHPROC) (void);
 typedef const GLubyte * (APIENTRYP _PFNGLGETSTRINGPROC) (GLenum name);
 typedef void (APIENTRYP _PFNGLGETINTEGERVPROC) (GLenum pname, GLint *params);
 typedef void (APIENTRYP _PFNGLPIXELSTOREIPROC) (GLenum pname, GLint param);
@@ -113,6 +114,29 @@ typedef void (APIENTRYP _PFNGLGENVERTEXARRAYSPROC) (GLsizei n, GLuint* arrays);
 typedef void (APIENTRYP _PFNGLDELETEVERTEXARRAYSPROC) (GLsizei n, const GLuint* arrays);
 typedef void (APIENTRYP _PFNGLBINDVERTEXARRAYPROC) (GLuint array);
 
+/* Timer query */
+typedef void (APIENTRYP _PFNGLGENQUERIESPROC) (GLsizei n, GLuint *ids);
+typedef void (APIENTRYP _PFNGLDELETEQUERIESPROC) (GLsizei n, const GLuint *ids);
+typedef void (APIENTRYP _PFNGLBEGINQUERYPROC) (GLenum target, GLuint id);
+typedef void (APIENTRYP _PFNGLENDQUERYPROC) (GLenum target);
+typedef void (APIENTRYP _PFNGLGETQUERYOBJECTIVPROC) (GLuint id, GLenum pname, GLint *params);
+typedef void (APIENTRYP _PFNGLGETQUERYOBJECTUI64VPROC) (GLuint id, GLenum pname, uint64_t *params);
+
+/* Buffer mapping */
+typedef void* (APIENTRYP _PFNGLMAPBUFFERRANGEPROC) (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLboolean (APIENTRYP _PFNGLUNMAPBUFFERPROC) (GLenum target);
+
+/* Buffer storage */
+typedef void (APIENTRYP _PFNGLBUFFERSTORAGEPROC) (GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+/* Sync object */
+#ifdef GLES2_HEADER
+typedef struct __GLsync *GLsync;
+#endif
+typedef GLsync (APIENTRYP _PFNGLFENCESYNCPROC) (GLenum condition, GLbitfield flags);
+typedef GLenum (APIENTRYP _PFNGLCLIENTWAITSYNCPROC) (GLsync sync, GLbitfield flags, uint64_t timeout);
+typedef void (APIENTRYP _PFNGLDELETESYNCPROC) (GLsync sync);
+
 /* GLES only */
 typedef void (APIENTRYP _PFNGLRELEASESHADERCOMPILERPROC) (void);
 
@@ -125,11 +149,71 @@ typedef void (APIENTRYP _PFNGLRELEASESHADERCOMPILERPROC) (void);
 #define GL_UNPACK_SKIP_ROWS 0x0CF3
 #endif
 
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_MAP_READ_BIT
+#define GL_MAP_READ_BIT 0x0001
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#endif
+#ifndef GL_MAP_INVALIDATE_RANGE_BIT
+#define GL_MAP_INVALIDATE_RANGE_BIT 0x0004
+#endif
+#ifndef GL_MAP_UNSYNCHRONIZED_BIT
+#define GL_MAP_UNSYNCHRONIZED_BIT 0x0020
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED 0x911A
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+#define GL_TIMEOUT_EXPIRED 0x911B
+#endif
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+#ifndef GL_WAIT_FAILED
+#define GL_WAIT_FAILED 0x911D
+#endif
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
 #define GL_20_FUN \
 	/* Etc */ \
 	GL_FUN(GetError, _PFNGLGETERRORPROC) \
 	GL_FUN(ClearColor, _PFNGLCLEARCOLORPROC) \
 	GL_FUN(Clear, _PFNGLCLEARPROC) \
+	GL_FUN(Finish, _PFNGLFINISHPROC) \
 	GL_FUN(GetString, _PFNGLGETSTRINGPROC) \
 	GL_FUN(GetIntegerv, _PFNGLGETINTEGERVPROC) \
 	GL_FUN(PixelStorei, _PFNGLPIXELSTOREIPROC) \
@@ -206,6 +290,30 @@ typedef void (APIENTRYP _PFNGLRELEASESHADERCOMPILERPROC) (void);
 	GL_FUN(DeleteVertexArrays, _PFNGLDELETEVERTEXARRAYSPROC) \
 	GL_FUN(BindVertexArray, _PFNGLBINDVERTEXARRAYPROC)
 
+#define GL_TIMER_QUERY_FUN \
+	/* Timer query */ \
+	GL_FUN(GenQueries, _PFNGLGENQUERIESPROC) \
+	GL_FUN(DeleteQueries, _PFNGLDELETEQUERIESPROC) \
+	GL_FUN(BeginQuery, _PFNGLBEGINQUERYPROC) \
+	GL_FUN(EndQuery, _PFNGLENDQUERYPROC) \
+	GL_FUN(GetQueryObjectiv, _PFNGLGETQUERYOBJECTIVPROC) \
+	GL_FUN(GetQueryObjectui64v, _PFNGLGETQUERYOBJECTUI64VPROC)
+
+#define GL_MAP_BUFFER_FUN \
+	/* Buffer mapping */ \
+	GL_FUN(MapBufferRange, _PFNGLMAPBUFFERRANGEPROC) \
+	GL_FUN(UnmapBuffer, _PFNGLUNMAPBUFFERPROC)
+
+#define GL_BUFFER_STORAGE_FUN \
+	/* Immutable buffer storage */ \
+	GL_FUN(BufferStorage, _PFNGLBUFFERSTORAGEPROC)
+
+#define GL_SYNC_FUN \
+	/* Sync object */ \
+	GL_FUN(FenceSync, _PFNGLFENCESYNCPROC) \
+	GL_FUN(ClientWaitSync, _PFNGLCLIENTWAITSYNCPROC) \
+	GL_FUN(DeleteSync, _PFNGLDELETESYNCPROC)
+
 #define GL_DEBUG_KHR_FUN \
 	GL_FUN(DebugMessageCallback, _PFNGLDEBUGMESSAGECALLBACKPROC)
 
@@ -222,12 +330,20 @@ struct GLFunctions
 	GL_FBO_FUN
 	GL_FBO_BLIT_FUN
 	GL_VAO_FUN
+	GL_TIMER_QUERY_FUN
+	GL_MAP_BUFFER_FUN
+	GL_BUFFER_STORAGE_FUN
+	GL_SYNC_FUN
 	GL_DEBUG_KHR_FUN
 	GL_GREMEMDY_FUN
 
 	bool glsles;
 	bool unpack_subimage;
 	bool npot_repeat;
+	bool timer_query;
+	bool map_buffer_range;
+	bool buffer_storage;
+	bool sync;
 
 #undef GL_FUN
 };
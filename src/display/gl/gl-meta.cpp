@@ -74,7 +74,7 @@ void subRectImageEnd()
 
 #define HAVE_NATIVE_VAO gl.GenVertexArrays
 
-static void vaoBindRes(VAO &vao)
+static void vaoBindRes(VAO &vao, GLintptr offset = 0)
 {
 	VBO::bind(vao.vbo);
 	IBO::bind(vao.ibo);
@@ -84,7 +84,8 @@ static void vaoBindRes(VAO &vao)
 		const VertexAttribute &va = vao.attr[i];
 
 		gl.EnableVertexAttribArray(va.index);
-		gl.VertexAttribPointer(va.index, va.size, va.type, GL_FALSE, vao.vertSize, va.offset);
+		gl.VertexAttribPointer(va.index, va.size, va.type, GL_FALSE, vao.vertSize,
+		                       (const char*) va.offset + offset);
 	}
 }
 
@@ -122,6 +123,28 @@ void vaoBind(VAO &vao)
 		vaoBindRes(vao);
 }
 
+void vaoBindAt(VAO &vao, GLintptr offset)
+{
+	if (HAVE_NATIVE_VAO)
+	{
+		gl.BindVertexArray(vao.nativeVAO);
+
+		VBO::bind(vao.vbo);
+
+		for (size_t i = 0; i < vao.attrCount; ++i)
+		{
+			const VertexAttribute &va = vao.attr[i];
+
+			gl.VertexAttribPointer(va.index, va.size, va.type, GL_FALSE, vao.vertSize,
+			                       (const char*) va.offset + offset);
+		}
+	}
+	else
+	{
+		vaoBindRes(vao, offset);
+	}
+}
+
 void vaoUnbind(VAO &vao)
 {
 	if (HAVE_NATIVE_VAO)
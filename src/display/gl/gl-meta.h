@@ -62,6 +62,8 @@ inline void vaoFillInVertexData(VAO &vao)
 void vaoInit(VAO &vao, bool keepBound = false);
 void vaoFini(VAO &vao);
 void vaoBind(VAO &vao);
+/* Binds 'vao' with its vertex data starting 'offset' bytes into its VBO */
+void vaoBindAt(VAO &vao, GLintptr offset);
 void vaoUnbind(VAO &vao);
 
 /* EXT_framebuffer_blit */
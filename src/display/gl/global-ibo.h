@@ -50,7 +50,9 @@ struct GlobalIBO
 
 	void ensureSize(size_t quadCount)
 	{
-		assert(quadCount*6 < INDEX_T_MAX);
+		/* What has to fit the index type is the highest
+		 * vertex index, not the number of indices */
+		assert(quadCount*4 < INDEX_T_MAX);
 
 		if (buffer.size() >= quadCount*6)
 			return;
@@ -28,6 +28,7 @@
 #include "sharedstate.h"
 #include "global-ibo.h"
 #include "shader.h"
+#include "streambuffer.h"
 
 #include <vector>
 #include <stdint.h>
@@ -37,6 +38,17 @@ struct QuadArray
 {
 	std::vector<VertexType> vertices;
 
+	/* Arrays drawn in the same frame they were committed in are
+	 * streamed through the shared StreamBuffer, so contents that
+	 * change every frame never need a buffer of their own. Once
+	 * an array is drawn in a later frame it counts as static and
+	 * is uploaded to its own buffer, which it's drawn from until
+	 * the next commit. Arrays too large to stream always are */
+	bool streamable;
+	bool uploaded;
+	unsigned int commitFrame;
+	bool haveVBO;
+
 	VBO::ID vbo;
 	GLMeta::VAO vao;
 
@@ -44,20 +56,19 @@ struct QuadArray
 	GLsizeiptr vboSize;
 
 	QuadArray()
-	    : quadCount(0),
+	    : streamable(false),
+	      uploaded(false),
+	      commitFrame(0),
+	      haveVBO(false),
+	      quadCount(0),
 	      vboSize(-1)
-	{
-		vbo = VBO::gen();
-
-		GLMeta::vaoFillInVertexData<VertexType>(vao);
-		vao.vbo = vbo;
-		vao.ibo = shState->globalIBO().ibo;
-
-		GLMeta::vaoInit(vao);
-	}
+	{}
 
 	~QuadArray()
 	{
+		if (!haveVBO)
+			return;
+
 		GLMeta::vaoFini(vao);
 		VBO::del(vbo);
 	}
@@ -78,30 +89,47 @@ struct QuadArray
 	 * and previous to the first 'draw()' call. */
 	void commit()
 	{
-		VBO::bind(vbo);
-
-		GLsizeiptr size = vertices.size() * sizeof(VertexType);
+		StreamBuffer &stream = shState->streamBuffer();
 
-		if (size > vboSize)
-		{
-			/* New data exceeds already allocated size.
-			 * Reallocate VBO. */
-			VBO::uploadData(size, dataPtr(vertices), GL_DYNAMIC_DRAW);
-			vboSize = size;
+		shState->ensureQuadIBO(quadCount);
 
-			shState->ensureQuadIBO(quadCount);
-		}
-		else
-		{
-			/* New data fits in allocated size */
-			VBO::uploadSubData(0, size, dataPtr(vertices));
-		}
+		GLsizeiptr size = vertices.size() * sizeof(VertexType);
+		streamable = size <= stream.maxWriteSize();
+		commitFrame = stream.frame();
+		uploaded = false;
 
-		VBO::unbind();
+		if (!streamable)
+			upload();
 	}
 
 	void draw(size_t offset, size_t count)
 	{
+		if (count == 0)
+			return;
+
+		if (!uploaded)
+		{
+			StreamBuffer &stream = shState->streamBuffer();
+
+			if (streamable && commitFrame == stream.frame())
+			{
+				GLMeta::VAO &streamVAO = stream.vaoFor<VertexType>();
+
+				if (stream.writeAndBind(streamVAO, dataPtr(vertices) + offset * 4,
+				                        count * 4 * sizeof(VertexType)))
+				{
+					gl.DrawElements(GL_TRIANGLES, count * 6, _GL_INDEX_TYPE, 0);
+					GLMeta::vaoUnbind(streamVAO);
+
+					return;
+				}
+			}
+
+			/* Unchanged since an earlier frame (or streaming
+			 * failed), so keep our own copy until it changes */
+			upload();
+		}
+
 		GLMeta::vaoBind(vao);
 
 		const char *_offset = (const char*) 0 + offset * 6 * sizeof(index_t);
@@ -119,6 +147,45 @@ struct QuadArray
 	{
 		return quadCount;
 	}
+
+private:
+	void initVBO()
+	{
+		vbo = VBO::gen();
+
+		GLMeta::vaoFillInVertexData<VertexType>(vao);
+		vao.vbo = vbo;
+		vao.ibo = shState->globalIBO().ibo;
+
+		GLMeta::vaoInit(vao);
+		haveVBO = true;
+	}
+
+	void upload()
+	{
+		if (!haveVBO)
+			initVBO();
+
+		VBO::bind(vbo);
+
+		GLsizeiptr size = vertices.size() * sizeof(VertexType);
+
+		if (size > vboSize)
+		{
+			/* New data exceeds already allocated size.
+			 * Reallocate VBO. */
+			VBO::uploadData(size, dataPtr(vertices), GL_DYNAMIC_DRAW);
+			vboSize = size;
+		}
+		else
+		{
+			/* New data fits in allocated size */
+			VBO::uploadSubData(0, size, dataPtr(vertices));
+		}
+
+		VBO::unbind();
+		uploaded = true;
+	}
 };
 
 typedef QuadArray<Vertex> ColorQuadArray;
@@ -22,6 +22,8 @@
 #include "scene.h"
 #include "sharedstate.h"
 
+unsigned int SceneRevision::value = 0;
+
 Scene::Scene()
 {}
 
@@ -40,6 +42,8 @@ void Scene::insert(SceneElement &element)
 {
 	IntruListLink<SceneElement> *iter;
 
+	notifyChange();
+
 	for (iter = elements.begin(); iter != elements.end(); iter = iter->next)
 	{
 		SceneElement *e = iter->data;
@@ -58,6 +62,8 @@ void Scene::insertAfter(SceneElement &element, SceneElement &after)
 {
 	IntruListLink<SceneElement> *iter;
 
+	notifyChange();
+
 	for (iter = &after.link; iter != elements.end(); iter = iter->next)
 	{
 		SceneElement *e = iter->data;
@@ -82,6 +88,8 @@ void Scene::notifyGeometryChange()
 {
 	IntruListLink<SceneElement> *iter;
 
+	notifyChange();
+
 	for (iter = elements.begin(); iter != elements.end(); iter = iter->next)
 	{
 		iter->data->onGeometryChange(geometry);
@@ -92,13 +100,34 @@ void Scene::composite()
 {
 	IntruListLink<SceneElement> *iter;
 
+	FrameProfiler &profiler = shState->profiler();
+	const bool profile = profiler.isEnabled();
+
+	/* Consecutive elements of the same kind share one
+	 * profiler phase to keep the overhead per element low */
+	FrameProfiler::Phase phase = FrameProfiler::PhaseCount;
+
 	for (iter = elements.begin(); iter != elements.end(); iter = iter->next)
 	{
 		SceneElement *e = iter->data;
 
-		if (e->visible)
-			e->draw();
+		if (!e->visible)
+			continue;
+
+		if (profile && e->profilePhase() != phase)
+		{
+			if (phase != FrameProfiler::PhaseCount)
+				profiler.pop();
+
+			phase = e->profilePhase();
+			profiler.push(phase);
+		}
+
+		e->draw();
 	}
+
+	if (phase != FrameProfiler::PhaseCount)
+		profiler.pop();
 }
 
 
@@ -158,7 +187,11 @@ void SceneElement::setVisible(bool value)
 {
 	aboutToAccess();
 
+	if (visible == value)
+		return;
+
 	visible = value;
+	notifyChange();
 }
 
 bool SceneElement::operator<(const SceneElement &o) const
@@ -196,7 +229,18 @@ void SceneElement::setSpriteY(int value)
 }
 
 void SceneElement::unlink()
+{
+	if (!scene)
+		return;
+
+	scene->elements.remove(link);
+	scene->notifyChange();
+}
+
+void SceneElement::notifyChange()
 {
 	if (scene)
-		scene->elements.remove(link);
+		scene->notifyChange();
+	else
+		SceneRevision::bump();
 }
@@ -26,6 +26,32 @@
 #include "intrulist.h"
 #include "etc.h"
 #include "etc-internal.h"
+#include "frameprofiler.h"
+
+/* Counts changes to anything that can end up on screen: scene
+ * elements and their properties, bitmap contents, colors, tones,
+ * rects and tilemap data. While it stays the same between two
+ * frames, Graphics can present the last composited frame again
+ * instead of recompositing it */
+struct SceneRevision
+{
+	static unsigned int value;
+
+	static void bump() { ++value; }
+};
+
+/* Like DEF_ATTR_SIMPLE for SceneElements,
+ * but the setter reports changes */
+#define DEF_SCENE_ATTR_SIMPLE(klass, name, type, location) \
+	DEF_ATTR_RD_SIMPLE(klass, name, type, location) \
+	void klass :: set##name(type value) \
+	{ \
+		guardDisposed(); \
+		if (location == value) \
+			return; \
+		location = value; \
+		notifyChange(); \
+	}
 
 class SceneElement;
 class Viewport;
@@ -61,7 +87,17 @@ public:
 
 	const Geometry &getGeometry() const { return geometry; }
 
+	/* Bumps the SceneRevision on behalf of
+	 * something this scene draws */
+	void notifyChange()
+	{
+		SceneRevision::bump();
+		onContentChange();
+	}
+
 protected:
+	virtual void onContentChange() {}
+
 	void insert(SceneElement &element);
 	void insertAfter(SceneElement &element, SceneElement &after);
 	void reinsert(SceneElement &element);
@@ -91,6 +127,9 @@ public:
 
 	virtual void aboutToAccess() const = 0;
 
+	/* Reports that the way this element draws changed */
+	void notifyChange();
+
 protected:
 	/* A bit about OpenGL state:
 	 *
@@ -112,6 +151,13 @@ protected:
 	 */
 	virtual void draw() = 0;
 
+	/* Which FrameProfiler phase this element's draw() is
+	 * charged to while compositing */
+	virtual FrameProfiler::Phase profilePhase() const
+	{
+		return FrameProfiler::PhaseOtherElement;
+	}
+
 	// FIXME: This should be a signal
 	virtual void onGeometryChange(const Scene::Geometry &) {}
 
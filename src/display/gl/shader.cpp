@@ -38,7 +38,8 @@
 #include "transSimple.frag.xxd"
 #include "bitmapBlit.frag.xxd"
 #include "plane.frag.xxd"
-#include "gray.frag.xxd"
+#include "planeTiled.frag.xxd"
+#include "viewport.frag.xxd"
 #include "flatColor.frag.xxd"
 #include "simple.frag.xxd"
 #include "simpleColor.frag.xxd"
@@ -661,25 +662,70 @@ void PlaneShader::setOpacity(float value)
 }
 
 
-GrayShader::GrayShader()
+TiledPlaneShader::TiledPlaneShader()
 {
-	INIT_SHADER(simple, gray, GrayShader);
+	INIT_SHADER(simple, planeTiled, TiledPlaneShader);
 
 	ShaderBase::init();
 
-	GET_U(gray);
+	GET_U(tone);
+	GET_U(color);
+	GET_U(opacity);
+	GET_U(tileRect);
+}
+
+void TiledPlaneShader::setTone(const Vec4 &tone)
+{
+	setVec4Uniform(u_tone, tone);
 }
 
-bool GrayShader::framebufferScalingAllowed()
+void TiledPlaneShader::setColor(const Vec4 &color)
+{
+	setVec4Uniform(u_color, color);
+}
+
+void TiledPlaneShader::setOpacity(float value)
+{
+	gl.Uniform1f(u_opacity, value);
+}
+
+void TiledPlaneShader::setTileRect(const Vec4 &value)
+{
+	setVec4Uniform(u_tileRect, value);
+}
+
+
+ViewportShader::ViewportShader()
+{
+	INIT_SHADER(simple, viewport, ViewportShader);
+
+	ShaderBase::init();
+
+	GET_U(tone);
+	GET_U(color);
+	GET_U(flash);
+}
+
+bool ViewportShader::framebufferScalingAllowed()
 {
 	// This shader is used with input textures that have already had a
 	// framebuffer scale applied. So we don't want to double-apply it.
 	return false;
 }
 
-void GrayShader::setGray(float value)
+void ViewportShader::setTone(const Vec4 &tone)
 {
-	gl.Uniform1f(u_gray, value);
+	setVec4Uniform(u_tone, tone);
+}
+
+void ViewportShader::setColor(const Vec4 &color)
+{
+	setVec4Uniform(u_color, color);
+}
+
+void ViewportShader::setFlash(const Vec4 &flash)
+{
+	setVec4Uniform(u_flash, flash);
 }
 
 
@@ -220,18 +220,37 @@ private:
 	GLint u_tone, u_color, u_flash, u_opacity;
 };
 
-class GrayShader : public ShaderBase
+/* Plane drawn as a single quad; texture coordinates
+ * are wrapped into 'tileRect' (normalized) per fragment */
+class TiledPlaneShader : public ShaderBase
 {
 public:
-	GrayShader();
+	TiledPlaneShader();
 
-	void setGray(float value);
+	void setTone(const Vec4 &value);
+	void setColor(const Vec4 &value);
+	void setOpacity(float value);
+	void setTileRect(const Vec4 &value);
+
+private:
+	GLint u_tone, u_color, u_opacity, u_tileRect;
+};
+
+/* Viewport tone (incl. gray), color and flash in one pass */
+class ViewportShader : public ShaderBase
+{
+public:
+	ViewportShader();
+
+	void setTone(const Vec4 &value);
+	void setColor(const Vec4 &value);
+	void setFlash(const Vec4 &value);
 
 protected:
 	virtual bool framebufferScalingAllowed();
 
 private:
-	GLint u_gray;
+	GLint u_tone, u_color, u_flash;
 };
 
 class TilemapShader : public ShaderBase
@@ -419,7 +438,8 @@ struct ShaderSet
 	AlphaSpriteShader alphaSprite;
 	SpriteShader sprite;
 	PlaneShader plane;
-	GrayShader gray;
+	TiledPlaneShader planeTiled;
+	ViewportShader viewport;
 	TilemapShader tilemap;
 	FlashMapShader flashMap;
 	TransShader trans;
@@ -0,0 +1,329 @@
+/*
+** streambuffer.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "streambuffer.h"
+
+#include "global-ibo.h"
+#include "debugwriter.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+#define STREAM_BUFFER_SIZE (4 * 1024 * 1024)
+
+/* Writes start on this boundary, which keeps
+ * every vertex attribute suitably aligned */
+#define STREAM_ALIGN 64
+
+/* How long to wait on a fence before checking again (ns) */
+#define FENCE_TIMEOUT 100000000
+
+struct StreamFence
+{
+	GLsync sync;
+
+	/* Ring position up to which the GPU is done
+	 * with the data once this fence signals */
+	uint64_t end;
+};
+
+struct StreamBufferPrivate
+{
+	enum Mode
+	{
+		Persistent,
+		Orphan
+	};
+
+	Mode mode;
+
+	VBO::ID vbo;
+	uint8_t *mapped;
+
+	/* Positions counting every byte ever handed out (including
+	 * the tails skipped on wrap-around), so the offset into the
+	 * buffer is always 'position % STREAM_BUFFER_SIZE'.
+	 * Everything below 'retired' is free to be overwritten */
+	uint64_t head;
+	uint64_t retired;
+
+	/* Persistent mode only; oldest first */
+	std::deque<StreamFence> fences;
+
+	std::vector<GLMeta::VAO> vaos;
+
+	/* Number of endFrame() calls so far */
+	unsigned int frame;
+
+	StreamBufferPrivate()
+	    : mode(Orphan),
+	      mapped(0),
+	      head(0),
+	      retired(0),
+	      frame(0)
+	{
+		if (!(gl.buffer_storage && gl.map_buffer_range && gl.sync) || !initPersistent())
+			initOrphan();
+
+		VBO::unbind();
+	}
+
+	~StreamBufferPrivate()
+	{
+		for (size_t i = 0; i < fences.size(); ++i)
+			gl.DeleteSync(fences[i].sync);
+
+		for (size_t i = 0; i < vaos.size(); ++i)
+			GLMeta::vaoFini(vaos[i]);
+
+		if (mapped)
+		{
+			VBO::bind(vbo);
+			gl.UnmapBuffer(GL_ARRAY_BUFFER);
+			VBO::unbind();
+		}
+
+		VBO::del(vbo);
+	}
+
+	bool initPersistent()
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		vbo = VBO::gen();
+		VBO::bind(vbo);
+
+		gl.BufferStorage(GL_ARRAY_BUFFER, STREAM_BUFFER_SIZE, 0, flags);
+		mapped = (uint8_t*) gl.MapBufferRange(GL_ARRAY_BUFFER, 0, STREAM_BUFFER_SIZE, flags);
+
+		if (mapped)
+		{
+			mode = Persistent;
+			return true;
+		}
+
+		/* The storage is immutable, so the fallback needs a fresh buffer */
+		VBO::del(vbo);
+
+		return false;
+	}
+
+	void initOrphan()
+	{
+		vbo = VBO::gen();
+		VBO::bind(vbo);
+		VBO::allocEmpty(STREAM_BUFFER_SIZE, GL_STREAM_DRAW);
+
+		mode = Orphan;
+	}
+
+	/* With a fence failing there's no telling anymore when the
+	 * GPU is done with the persistent mapping, so the ring starts
+	 * over on a buffer that is orphaned instead */
+	void fallBackToOrphan()
+	{
+		Debug() << "Stream buffer fence failed, falling back to orphaning";
+
+		for (size_t i = 0; i < fences.size(); ++i)
+			gl.DeleteSync(fences[i].sync);
+
+		fences.clear();
+
+		VBO::bind(vbo);
+		gl.UnmapBuffer(GL_ARRAY_BUFFER);
+		mapped = 0;
+		VBO::del(vbo);
+
+		initOrphan();
+		head = retired = 0;
+
+		for (size_t i = 0; i < vaos.size(); ++i)
+			vaos[i].vbo = vbo;
+	}
+
+	/* Waits until the ring is free up to 'end'. Returns false if
+	 * a fence failed, in which case it has fallen back to orphaning */
+	bool waitFor(uint64_t end)
+	{
+		while (end > retired + STREAM_BUFFER_SIZE)
+		{
+			/* A single frame went around the whole ring.
+			 * Everything written so far has had its draw
+			 * call issued, so fence that and wait on it */
+			if (fences.empty())
+				placeFence();
+
+			StreamFence fence = fences.front();
+			fences.pop_front();
+
+			GLenum state;
+
+			do
+				state = gl.ClientWaitSync(fence.sync, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+			while (state == GL_TIMEOUT_EXPIRED);
+
+			gl.DeleteSync(fence.sync);
+
+			if (state == GL_WAIT_FAILED)
+			{
+				fallBackToOrphan();
+				return false;
+			}
+
+			retired = fence.end;
+		}
+
+		return true;
+	}
+
+	void placeFence()
+	{
+		StreamFence fence = { gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), head };
+		fences.push_back(fence);
+	}
+
+	/* Drops fences that already signaled, without blocking */
+	void retireFences()
+	{
+		while (!fences.empty())
+		{
+			GLenum state = gl.ClientWaitSync(fences.front().sync, 0, 0);
+
+			if (state == GL_WAIT_FAILED)
+			{
+				fallBackToOrphan();
+				return;
+			}
+
+			if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+				break;
+
+			gl.DeleteSync(fences.front().sync);
+			retired = fences.front().end;
+			fences.pop_front();
+		}
+	}
+
+	/* Returns the buffer offset 'size' bytes may be written at.
+	 * In orphan mode, expects 'vbo' to be bound */
+	GLintptr reserve(GLsizeiptr size)
+	{
+		size = (size + STREAM_ALIGN - 1) & ~(GLsizeiptr) (STREAM_ALIGN - 1);
+
+		GLintptr offset = head % STREAM_BUFFER_SIZE;
+
+		/* Writes never straddle the end of the buffer */
+		if (offset + size > STREAM_BUFFER_SIZE)
+		{
+			head += STREAM_BUFFER_SIZE - offset;
+			offset = 0;
+
+			if (mode == Orphan)
+				VBO::allocEmpty(STREAM_BUFFER_SIZE, GL_STREAM_DRAW);
+		}
+
+		/* After falling back, the fresh buffer starts at 0 */
+		if (mode == Persistent && !waitFor(head + size))
+			offset = 0;
+
+		head += size;
+
+		return offset;
+	}
+};
+
+StreamBuffer::StreamBuffer()
+    : p(new StreamBufferPrivate)
+{}
+
+StreamBuffer::~StreamBuffer()
+{
+	delete p;
+}
+
+GLsizeiptr StreamBuffer::maxWriteSize() const
+{
+	/* Leave room for the frames still in flight */
+	return STREAM_BUFFER_SIZE / 4;
+}
+
+bool StreamBuffer::writeAndBind(GLMeta::VAO &vao, const void *data, GLsizeiptr size)
+{
+	if (size > maxWriteSize())
+		return false;
+
+	if (p->mode == StreamBufferPrivate::Orphan)
+		VBO::bind(p->vbo);
+
+	const GLintptr offset = p->reserve(size);
+
+	/* In orphan mode, nothing in flight reads from the range
+	 * being written, so a plain sub data upload won't stall
+	 * (and is cheaper than mapping for every draw) */
+	if (p->mode == StreamBufferPrivate::Persistent)
+		memcpy(p->mapped + offset, data, size);
+	else
+		VBO::uploadSubData(offset, size, data);
+
+	GLMeta::vaoBindAt(vao, offset);
+
+	return true;
+}
+
+GLMeta::VAO &StreamBuffer::vaoFor(const VertexAttribute *attr, size_t attrCount,
+                                  GLsizei vertSize)
+{
+	for (size_t i = 0; i < p->vaos.size(); ++i)
+		if (p->vaos[i].attr == attr)
+			return p->vaos[i];
+
+	GLMeta::VAO vao;
+	vao.attr      = attr;
+	vao.attrCount = attrCount;
+	vao.vertSize  = vertSize;
+	vao.vbo       = p->vbo;
+	vao.ibo       = shState->globalIBO().ibo;
+
+	GLMeta::vaoInit(vao);
+	p->vaos.push_back(vao);
+
+	return p->vaos.back();
+}
+
+unsigned int StreamBuffer::frame() const
+{
+	return p->frame;
+}
+
+void StreamBuffer::endFrame()
+{
+	++p->frame;
+
+	if (p->mode != StreamBufferPrivate::Persistent)
+		return;
+
+	p->retireFences();
+
+	const uint64_t fenced = p->fences.empty() ? p->retired : p->fences.back().end;
+
+	if (p->head != fenced)
+		p->placeFence();
+}
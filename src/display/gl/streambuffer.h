@@ -0,0 +1,77 @@
+/*
+** streambuffer.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include "gl-util.h"
+#include "gl-meta.h"
+
+struct StreamBufferPrivate;
+
+/* One large vertex buffer that per-draw vertex data is streamed
+ * into, instead of every quad array keeping (and re-uploading)
+ * a buffer of its own. Data is appended ring-wise; a written
+ * range is only valid for the draw call directly following it.
+ *
+ * With ARB_buffer_storage the buffer stays mapped for its whole
+ * lifetime, and fences placed at the end of each frame tell when
+ * the GPU is done with a range so it can be overwritten (should
+ * a fence ever fail, the buffer switches to orphaning). Without
+ * it, ranges are written with glBufferSubData and the buffer
+ * storage is orphaned whenever the ring wraps around. */
+class StreamBuffer
+{
+public:
+	StreamBuffer();
+	~StreamBuffer();
+
+	/* Largest amount of data a single write may hold */
+	GLsizeiptr maxWriteSize() const;
+
+	/* Copies 'size' bytes into the ring and binds 'vao' (which
+	 * must have come from vaoFor()) to them. Returns false if
+	 * the data doesn't fit, in which case the caller has
+	 * to provide it some other way */
+	bool writeAndBind(GLMeta::VAO &vao, const void *data, GLsizeiptr size);
+
+	/* VAO sourcing 'VertexType' from the ring, created on first use */
+	template<class VertexType>
+	GLMeta::VAO &vaoFor()
+	{
+		return vaoFor(VertexTraits<VertexType>::attr,
+		              VertexTraits<VertexType>::attrCount,
+		              sizeof(VertexType));
+	}
+
+	/* Number of frames submitted so far */
+	unsigned int frame() const;
+
+	/* Marks everything streamed so far as belonging to
+	 * the frame just submitted */
+	void endFrame();
+
+private:
+	GLMeta::VAO &vaoFor(const VertexAttribute *attr, size_t attrCount,
+	                    GLsizei vertSize);
+
+	StreamBufferPrivate *p;
+};
+
+#endif // STREAMBUFFER_H
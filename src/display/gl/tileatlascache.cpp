@@ -0,0 +1,216 @@
+/*
+** tileatlascache.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tileatlascache.h"
+
+#include "bitmap.h"
+
+#include <list>
+
+static uint32_t byteCount(const TEXFBO &obj)
+{
+	return obj.width * obj.height * 4;
+}
+
+struct AtlasEntry
+{
+	std::string key;
+	TEXFBO tex;
+	TEXFBO hires;
+
+	uint32_t bytes() const
+	{
+		return byteCount(tex) + byteCount(hires);
+	}
+
+	void fini()
+	{
+		TEXFBO::fini(tex);
+
+		if (hires.tex != TEX::ID(0))
+			TEXFBO::fini(hires);
+	}
+};
+
+struct TileAtlasCachePrivate
+{
+	/* Most recently stored first */
+	std::list<AtlasEntry> entries;
+
+	const uint32_t maxMemSize;
+	uint32_t memSize;
+
+	bool disabled;
+
+	TileAtlasCachePrivate(uint32_t maxMemSize)
+	    : maxMemSize(maxMemSize),
+	      memSize(0),
+	      disabled(false)
+	{}
+
+	void evictUntil(uint32_t freeBytes)
+	{
+		while (!entries.empty() && memSize + freeBytes > maxMemSize)
+		{
+			AtlasEntry &last = entries.back();
+
+			memSize -= last.bytes();
+			last.fini();
+			entries.pop_back();
+		}
+	}
+};
+
+TileAtlasCache::TileAtlasCache(uint32_t maxMemSize)
+{
+	p = new TileAtlasCachePrivate(maxMemSize);
+}
+
+TileAtlasCache::~TileAtlasCache()
+{
+	disable();
+
+	delete p;
+}
+
+std::string TileAtlasCache::makeKey(const char *kind, Bitmap *const *bitmaps, size_t count)
+{
+	std::string key = kind;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		key += '\n';
+
+		Bitmap *bm = bitmaps[i];
+
+		if (nullOrDisposed(bm))
+			continue;
+
+		const std::string &part = bm->contentKey();
+
+		if (part.empty())
+			return std::string();
+
+		key += part;
+
+		if (!bm->hasHires())
+			continue;
+
+		const std::string &hiresPart = bm->getHires()->contentKey();
+
+		if (hiresPart.empty())
+			return std::string();
+
+		key += '|';
+		key += hiresPart;
+	}
+
+	return key;
+}
+
+bool TileAtlasCache::take(const std::string &key, int width, int height,
+                          TEXFBO &out, TEXFBO *outHires)
+{
+	if (key.empty())
+		return false;
+
+	std::list<AtlasEntry>::iterator iter;
+
+	for (iter = p->entries.begin(); iter != p->entries.end(); ++iter)
+	{
+		if (iter->key != key)
+			continue;
+
+		if (iter->tex.width != width || iter->tex.height != height)
+			return false;
+
+		/* Only hand out a hires atlas if one was asked for */
+		if ((outHires != 0) != (iter->hires.tex != TEX::ID(0)))
+			return false;
+
+		out = iter->tex;
+
+		if (outHires)
+			*outHires = iter->hires;
+
+		p->memSize -= iter->bytes();
+		p->entries.erase(iter);
+
+		return true;
+	}
+
+	return false;
+}
+
+void TileAtlasCache::store(const std::string &key, TEXFBO &tex, TEXFBO *hires)
+{
+	AtlasEntry entry;
+	entry.key = key;
+	entry.tex = tex;
+
+	if (hires)
+		entry.hires = *hires;
+
+	entry.tex.selfHires = 0;
+
+	if (tex.tex == TEX::ID(0))
+		return;
+
+	const uint32_t bytes = entry.bytes();
+
+	if (key.empty() || p->disabled || bytes > p->maxMemSize)
+	{
+		entry.fini();
+		return;
+	}
+
+	/* Two tilemaps built from the same bitmaps leave
+	 * two identical atlases behind; keep the newer one */
+	std::list<AtlasEntry>::iterator iter;
+
+	for (iter = p->entries.begin(); iter != p->entries.end(); ++iter)
+	{
+		if (iter->key != key)
+			continue;
+
+		p->memSize -= iter->bytes();
+		iter->fini();
+		p->entries.erase(iter);
+
+		break;
+	}
+
+	p->evictUntil(bytes);
+
+	p->entries.push_front(entry);
+	p->memSize += bytes;
+}
+
+void TileAtlasCache::disable()
+{
+	p->disabled = true;
+
+	std::list<AtlasEntry>::iterator iter;
+
+	for (iter = p->entries.begin(); iter != p->entries.end(); ++iter)
+		iter->fini();
+
+	p->entries.clear();
+	p->memSize = 0;
+}
@@ -0,0 +1,66 @@
+/*
+** tileatlascache.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TILEATLASCACHE_H
+#define TILEATLASCACHE_H
+
+#include "gl-util.h"
+
+#include <stdint.h>
+#include <string>
+
+class Bitmap;
+struct TileAtlasCachePrivate;
+
+/* Keeps the atlases of disposed tilemaps around, so a later
+ * tilemap built from the same tileset and autotiles (eg. after
+ * transferring back to a previously visited map) can skip
+ * assembling its atlas. Atlases are keyed by the identity of
+ * their source bitmaps (see makeKey()), and the least recently
+ * stored ones are deleted once the memory budget is exceeded.
+ *
+ * An atlas is owned by either the cache or one tilemap at a
+ * time; taking it out removes it from the cache. */
+class TileAtlasCache
+{
+public:
+	TileAtlasCache(uint32_t maxMemSize);
+	~TileAtlasCache();
+
+	/* Builds a key for an atlas assembled from 'bitmaps' (null
+	 * entries allowed). Returns an empty key if any of them
+	 * doesn't hold the unmodified contents of an image file */
+	static std::string makeKey(const char *kind, Bitmap *const *bitmaps, size_t count);
+
+	/* On a hit, moves the atlas (and its hires variant, if
+	 * 'outHires' is given) out of the cache and returns true */
+	bool take(const std::string &key, int width, int height,
+	          TEXFBO &out, TEXFBO *outHires = 0);
+
+	/* Takes ownership of 'tex' (and 'hires'); they're deleted
+	 * if they can't be cached */
+	void store(const std::string &key, TEXFBO &tex, TEXFBO *hires = 0);
+
+	void disable();
+
+private:
+	TileAtlasCachePrivate *p;
+};
+
+#endif // TILEATLASCACHE_H
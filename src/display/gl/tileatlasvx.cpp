@@ -687,4 +687,25 @@ void readTiles(Reader &reader, const Table &data,
 	readLayer(reader, data, flags, ox, oy, w, h, 2);
 }
 
+void readCell(Reader &reader, const Table &data,
+              const Table *flags, int x, int y, Layer layer)
+{
+	if (layer == LayerShadow)
+	{
+		if (rgssVer >= 3)
+			onShadowTile(reader, tableGetWrapped(data, x, y, 3) & 0xF, x, y);
+
+		return;
+	}
+
+	static const int layerZ[] = { 0, 1, -1, 2 };
+
+	int16_t tileID = tableGetWrapped(data, x, y, layerZ[layer]);
+
+	if (tileID <= 0)
+		return;
+
+	onTile(reader, tileID, x, y, flags);
+}
+
 }
@@ -60,6 +60,26 @@ void build(TEXFBO &tf, Bitmap *bitmaps[BM_COUNT]);
 
 void readTiles(Reader &reader, const Table &data,
                const Table *flags, int ox, int oy, int w, int h);
+
+/* Map layers in the order readTiles() emits them */
+enum Layer
+{
+	Layer0,
+	Layer1,
+	LayerShadow,
+	Layer2,
+
+	LayerCount
+};
+
+/* Upper bound of quads a single cell can produce in one layer
+ * (the A2 table pattern: four corners plus two leg quads) */
+#define ATLASVX_CELL_QUADS 6
+
+/* Reads one layer of the map cell at (x, y). Unlike readTiles(),
+ * the quads are positioned at the absolute map coordinates */
+void readCell(Reader &reader, const Table &data,
+              const Table *flags, int x, int y, Layer layer);
 }
 
 #endif // TILEATLASVX_H
@@ -22,6 +22,7 @@
 #include "graphics.h"
 
 #include "alstream.h"
+#include "animationclock.h"
 #include "audio.h"
 #include "binding.h"
 #include "bitmap.h"
@@ -32,6 +33,8 @@
 #include "etc-internal.h"
 #include "eventthread.h"
 #include "filesystem.h"
+#include "frameprofiler.h"
+#include "imagewriter.h"
 #include "gl-fun.h"
 #include "gl-util.h"
 #include "glstate.h"
@@ -40,6 +43,7 @@
 #include "scene.h"
 #include "shader.h"
 #include "sharedstate.h"
+#include "streambuffer.h"
 #include "texpool.h"
 #include "theoraplay/theoraplay.h"
 #include "util.h"
@@ -65,6 +69,7 @@
 #include <time.h>
 #include <cmath>
 #include <climits>
+#include <thread>
 
 
 #define DEF_SCREEN_W (rgssVer == 1 ? 640 : 544)
@@ -500,12 +505,16 @@ public:
         
         brightEffect = false;
         brightnessQuad.setColor(Vec4());
+        
+        composed = false;
+        composedRevision = 0;
     }
     
     void composite() {
         const int w = geometry.rect.w;
         const int h = geometry.rect.h;
         
+        shState->animationClock().tick(shState->runTime());
         shState->prepareDraw();
         
         pp.startRender();
@@ -524,122 +533,78 @@ public:
             
             brightnessQuad.draw();
         }
+        
+        /* Anything bumped while preparing is part of this frame */
+        composed = true;
+        composedRevision = SceneRevision::value;
+    }
+    
+    /* Whether the PP frontbuffer still shows what
+     * compositing the scene right now would produce */
+    bool isCurrent() const {
+        if (!composed || composedRevision != SceneRevision::value)
+            return false;
+        
+        /* Playing animations advance without any bump */
+        return !shState->animationClock().hasRunningTimers();
     }
     
     void requestViewportRender(const Vec4 &c, const Vec4 &f, const Vec4 &t) {
-        const IntRect &viewpRect = glState.scissorBox.get();
-        const IntRect &screenRect = geometry.rect;
+        ProfileScope profile(shState->profiler(), FrameProfiler::PhaseViewportEffects);
         
-        const bool toneRGBEffect = t.xyzNotNull();
-        const bool toneGrayEffect = t.w != 0;
-        const bool colorEffect = c.w > 0;
-        const bool flashEffect = f.w > 0;
+        if (!t.xyzNotNull() && t.w == 0 && c.w <= 0 && f.w <= 0)
+            return;
         
-        if (toneGrayEffect) {
-            pp.swapRender();
-            
-            if (!viewpRect.encloses(screenRect)) {
-                /* Scissor test _does_ affect FBO blit operations,
-                 * and since we're inside the draw cycle, it will
-                 * be turned on, so turn it off temporarily */
-                glState.scissorTest.pushSet(false);
-                
-                int scaleIsSpecial = GLMeta::blitScaleIsSpecial(pp.frontBuffer(), false, geometry.rect, pp.backBuffer(), geometry.rect);
-
-                GLMeta::blitBegin(pp.frontBuffer(), false, scaleIsSpecial);
-                GLMeta::blitSource(pp.backBuffer(), scaleIsSpecial);
-                GLMeta::blitRectangle(geometry.rect, Vec2i());
-                GLMeta::blitEnd();
-                
-                glState.scissorTest.pop();
-            }
-            
-            GrayShader &shader = shState->shaders().gray;
-            shader.bind();
-            shader.setGray(t.w);
-            shader.applyViewportProj();
-            shader.setTexSize(screenRect.size());
-            
-            TEX::bind(pp.backBuffer().tex);
-            
-            glState.blend.pushSet(false);
-            screenQuad.draw();
-            glState.blend.pop();
-        }
+        /* Effects only ever apply inside the viewport */
+        const IntRect rect = glState.scissorBox.get().intersected(geometry.rect);
         
-        if (!toneRGBEffect && !colorEffect && !flashEffect)
+        if (rect.w <= 0 || rect.h <= 0)
             return;
         
-        FlatColorShader &shader = shState->shaders().flatColor;
-        shader.bind();
-        shader.applyViewportProj();
+        /* Copy the viewport area over to the back buffer, then
+         * draw it back with gray, tone, color and flash applied
+         * in a single pass. Both only cover the scissor rect */
+        TEXFBO &front = pp.frontBuffer();
+        TEXFBO &back = pp.backBuffer();
         
-        if (toneRGBEffect) {
-            /* First split up additive / substractive components */
-            Vec4 add, sub;
-            
-            if (t.x > 0)
-                add.x = t.x;
-            if (t.y > 0)
-                add.y = t.y;
-            if (t.z > 0)
-                add.z = t.z;
-            
-            if (t.x < 0)
-                sub.x = -t.x;
-            if (t.y < 0)
-                sub.y = -t.y;
-            if (t.z < 0)
-                sub.z = -t.z;
-            
-            /* Then apply them using hardware blending */
-            gl.BlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE);
-            
-            if (add.xyzNotNull()) {
-                gl.BlendEquation(GL_FUNC_ADD);
-                shader.setColor(add);
-                
-                screenQuad.draw();
-            }
-            
-            if (sub.xyzNotNull()) {
-                gl.BlendEquation(GL_FUNC_REVERSE_SUBTRACT);
-                shader.setColor(sub);
-                
-                screenQuad.draw();
-            }
-        }
+        int scaleIsSpecial = GLMeta::blitScaleIsSpecial(back, false, rect, front, rect);
         
-        if (colorEffect || flashEffect) {
-            gl.BlendEquation(GL_FUNC_ADD);
-            gl.BlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO,
-                                 GL_ONE);
-        }
+        GLMeta::blitBegin(back, false, scaleIsSpecial);
+        GLMeta::blitSource(front, scaleIsSpecial);
+        GLMeta::blitRectangle(rect, rect.pos());
+        GLMeta::blitEnd();
         
-        if (colorEffect) {
-            shader.setColor(c);
-            screenQuad.draw();
-        }
+        FBO::bind(front.fbo);
         
-        if (flashEffect) {
-            shader.setColor(f);
-            screenQuad.draw();
-        }
+        ViewportShader &shader = shState->shaders().viewport;
+        shader.bind();
+        shader.setTone(t);
+        shader.setColor(c.w > 0 ? c : Vec4());
+        shader.setFlash(f.w > 0 ? f : Vec4());
+        shader.applyViewportProj();
+        shader.setTexSize(geometry.rect.size());
+        
+        TEX::bind(back.tex);
         
-        glState.blendMode.refresh();
+        Quad &quad = shState->gpQuad();
+        quad.setTexPosRect(FloatRect(rect), FloatRect(rect));
+        
+        glState.blend.pushSet(false);
+        quad.draw();
+        glState.blend.pop();
     }
     
     void setBrightness(float norm) {
         brightnessQuad.setColor(Vec4(0, 0, 0, 1.0f - norm));
         
         brightEffect = norm < 1.0f;
+        SceneRevision::bump();
     }
     
     void updateReso(int width, int height) {
         geometry.rect.w = width;
         geometry.rect.h = height;
         
-        screenQuad.setTexPosRect(geometry.rect, geometry.rect);
         brightnessQuad.setTexPosRect(geometry.rect, geometry.rect);
         
         notifyGeometryChange();
@@ -654,15 +619,38 @@ public:
     
 private:
     PingPong pp;
-    Quad screenQuad;
     
     Quad brightnessQuad;
     bool brightEffect;
+    
+    /* SceneRevision the frontbuffer was last composited at */
+    bool composed;
+    unsigned int composedRevision;
 };
 
 /* Nanoseconds per second */
 #define NS_PER_S 1000000000
 
+/* Most a sleep is trusted to oversleep; anything coarser
+ * than this isn't worth burning the CPU for */
+#define LIMITER_MAX_SLACK_US 4000
+
+/* Below this much remaining time the spin stops yielding */
+#define LIMITER_YIELD_US 100
+
+/* Number of frame intervals kept for FrameTimeStats */
+#define FRAME_STATS_WINDOW 120
+
+/* Initial guess for how late the OS wakes us up from a sleep,
+ * refined by FPSLimiter::calibrate() while running */
+#if defined(HAVE_NANOSLEEP) && defined(MKXPZ_NANOSLEEP)
+#define LIMITER_INITIAL_SLACK_US 200
+#elif defined(_WIN32)
+#define LIMITER_INITIAL_SLACK_US 2000
+#else
+#define LIMITER_INITIAL_SLACK_US 1000
+#endif
+
 struct FPSLimiter {
     uint64_t lastTickCount;
     
@@ -680,6 +668,18 @@ struct FPSLimiter {
     
     bool disabled;
     
+    /* Sleep until just before the deadline and spin
+     * off the remainder */
+    bool spinWait;
+    
+    /* Present as soon as the minimum frame interval has
+     * passed, without catching up on the ideal timestep */
+    bool vrr;
+    
+    /* How much earlier than the deadline we wake up
+     * from the coarse sleep, in ticks */
+    int64_t sleepSlack;
+    
     /* Data for frame timing adjustment */
     struct {
         /* Last tick count */
@@ -691,29 +691,50 @@ struct FPSLimiter {
         bool resetFlag;
     } adj;
     
+    /* Ring buffer of recent frame intervals (ticks) */
+    struct {
+        int64_t intervals[FRAME_STATS_WINDOW];
+        int count;
+        int next;
+    } stats;
+    
     FPSLimiter(uint16_t desiredFPS)
     : lastTickCount(SDL_GetPerformanceCounter()),
     tickFreq(SDL_GetPerformanceFrequency()), tickFreqMS(tickFreq / 1000),
-    tickFreqNS((double)tickFreq / NS_PER_S), disabled(false) {
+    tickFreqNS((double)tickFreq / NS_PER_S), disabled(false),
+    spinWait(true), vrr(false) {
         setDesiredFPS(desiredFPS);
         
+        sleepSlack = LIMITER_INITIAL_SLACK_US * tickFreq / 1000000;
+        
         adj.last = SDL_GetPerformanceCounter();
         adj.idealDiff = 0;
         adj.resetFlag = false;
+        
+        stats.count = 0;
+        stats.next = 0;
     }
     
     void setDesiredFPS(uint16_t value) { tpf = tickFreq / value; }
     
     void delay() {
-        if (disabled)
+        if (disabled) {
+            /* Vsync or an uncapped frame rate does the pacing,
+             * but keep the interval statistics going */
+            uint64_t now = SDL_GetPerformanceCounter();
+            recordInterval(now - adj.last);
+            adj.last = now;
+            
             return;
+        }
         
         int64_t tickDelta = SDL_GetPerformanceCounter() - lastTickCount;
         int64_t toDelay = tpf - tickDelta;
         
         /* Compensate for the last delta
          * to the ideal timestep */
-        toDelay -= adj.idealDiff;
+        if (!vrr)
+            toDelay -= adj.idealDiff;
         
         if (toDelay < 0)
             toDelay = 0;
@@ -724,11 +745,13 @@ struct FPSLimiter {
         int64_t diff = now - adj.last;
         adj.last = now;
         
+        recordInterval(diff);
+        
         /* Recalculate our temporal position
          * relative to the ideal timestep */
         adj.idealDiff = diff - tpf + adj.idealDiff;
         
-        if (adj.resetFlag) {
+        if (adj.resetFlag || vrr) {
             adj.idealDiff = 0;
             adj.resetFlag = false;
         }
@@ -741,14 +764,97 @@ struct FPSLimiter {
      * there's no choice but to skip frame(s)
      * to catch up */
     bool frameSkipRequired() const {
-        if (disabled)
+        if (disabled || vrr)
             return false;
         
         return adj.idealDiff > tpf;
     }
     
+    void getStats(FrameTimeStats &out) const {
+        const double toMS = 1000.0 / tickFreq;
+        
+        out.samples = stats.count;
+        out.mean = out.stddev = out.min = out.max = 0;
+        out.sleepSlack = sleepSlack * toMS;
+        
+        if (stats.count == 0)
+            return;
+        
+        int64_t min = stats.intervals[0], max = min;
+        double sum = 0;
+        
+        for (int i = 0; i < stats.count; ++i) {
+            min = std::min(min, stats.intervals[i]);
+            max = std::max(max, stats.intervals[i]);
+            sum += stats.intervals[i];
+        }
+        
+        const double mean = sum / stats.count;
+        double var = 0;
+        
+        for (int i = 0; i < stats.count; ++i) {
+            double d = stats.intervals[i] - mean;
+            var += d * d;
+        }
+        
+        out.mean = mean * toMS;
+        out.stddev = std::sqrt(var / stats.count) * toMS;
+        out.min = min * toMS;
+        out.max = max * toMS;
+    }
+    
 private:
+    void recordInterval(int64_t ticks) {
+        stats.intervals[stats.next] = ticks;
+        stats.next = (stats.next + 1) % FRAME_STATS_WINDOW;
+        
+        if (stats.count < FRAME_STATS_WINDOW)
+            ++stats.count;
+    }
+    
+    /* Track how late the coarse sleep wakes up. Rises quickly
+     * so a single late wakeup isn't repeated, and decays slowly
+     * so we don't go back to oversleeping right away */
+    void calibrate(int64_t overshoot) {
+        if (overshoot > sleepSlack)
+            sleepSlack += (overshoot - sleepSlack) / 2;
+        else
+            sleepSlack -= (sleepSlack - overshoot) / 32;
+        
+        const int64_t maxSlack = LIMITER_MAX_SLACK_US * tickFreq / 1000000;
+        sleepSlack = clamp<int64_t>(sleepSlack, 0, maxSlack);
+    }
+    
     void delayTicks(uint64_t ticks) {
+        if (!spinWait) {
+            sleepTicks(ticks);
+            return;
+        }
+        
+        const uint64_t target = SDL_GetPerformanceCounter() + ticks;
+        
+        if ((int64_t)ticks > sleepSlack) {
+            const uint64_t request = ticks - sleepSlack;
+            const uint64_t before = SDL_GetPerformanceCounter();
+            
+            sleepTicks(request);
+            calibrate((int64_t)(SDL_GetPerformanceCounter() - before) - (int64_t)request);
+        }
+        
+        const uint64_t yieldTicks = LIMITER_YIELD_US * tickFreq / 1000000;
+        
+        for (;;) {
+            const uint64_t now = SDL_GetPerformanceCounter();
+            
+            if (now >= target)
+                break;
+            
+            if (target - now > yieldTicks)
+                std::this_thread::yield();
+        }
+    }
+    
+    void sleepTicks(uint64_t ticks) {
 #if defined(HAVE_NANOSLEEP) && defined(MKXPZ_NANOSLEEP)
         struct timespec req;
         uint64_t nsec = ticks / tickFreqNS;
@@ -1012,8 +1118,25 @@ struct GraphicsPrivate {
     }
     
     void swapGLBuffer() {
-        fpsLimiter.delay();
-        SDL_GL_SwapWindow(threadData->window);
+        FrameProfiler &profiler = shState->profiler();
+        
+        {
+            ProfileScope profile(profiler, FrameProfiler::PhaseLimiterSleep);
+            fpsLimiter.delay();
+        }
+        
+        {
+            ProfileScope profile(profiler, FrameProfiler::PhaseSwap);
+            
+            /* Without a swap to throttle on, wait for the GPU
+             * so frame times stay meaningful */
+            if (threadData->config.headless.enabled)
+                gl.Finish();
+            else
+                SDL_GL_SwapWindow(threadData->window);
+        }
+        
+        shState->streamBuffer().endFrame();
         
         ++frameCount;
         
@@ -1061,9 +1184,25 @@ struct GraphicsPrivate {
             TEX::uploadSubImage(0, 0, 640, 480, shState->oneshot().obscuredMap().data(), GL_RED);
 #endif
             shState->oneshot().obscuredDirty = false;
+            SceneRevision::bump();
         }
         
-        screen.composite();
+        /* Static frames are just presented again */
+        if (!threadData->config.skipUnchangedFrames || !screen.isCurrent())
+            screen.composite();
+        
+        if (threadData->config.headless.enabled)
+        {
+            /* Nothing to present; the frame stays in the
+             * offscreen screen buffer */
+            dumpHeadlessFrame();
+            swapGLBuffer();
+            updateAvgFPS();
+            return;
+        }
+        
+        /* Buffer swap and limiter sleep nest their own phases */
+        ProfileScope profile(shState->profiler(), FrameProfiler::PhaseScaling);
         
         // maybe unspaghetti this later
         if (integerScaleStepApplicable() && !integerLastMileScaling)
@@ -1132,6 +1271,33 @@ struct GraphicsPrivate {
         updateAvgFPS();
     }
     
+    /* Writes every Nth composited frame to disk as PNG */
+    void dumpHeadlessFrame() {
+        const Config &conf = threadData->config;
+        
+        if (conf.headless.dumpInterval <= 0 || frameCount % conf.headless.dumpInterval != 0)
+            return;
+        
+        SDL_Surface *surf = SDL_CreateRGBSurfaceWithFormat(0, scRes.x, scRes.y, 32, SDL_PIXELFORMAT_ABGR8888);
+        
+        if (!surf) {
+            Debug() << "Failed to dump frame:" << SDL_GetError();
+            return;
+        }
+        
+        FBO::bind(screen.getPP().frontBuffer().fbo);
+        gl.ReadPixels(0, 0, scRes.x, scRes.y, GL_RGBA, GL_UNSIGNED_BYTE, surf->pixels);
+        
+        std::string dir = conf.headless.dumpPath.empty() ? "." : conf.headless.dumpPath;
+        char filename[32];
+        snprintf(filename, sizeof(filename), "/frame%08d.png", frameCount);
+        
+        if (IMG_SavePNG(surf, (dir + filename).c_str()))
+            Debug() << "Failed to dump frame:" << SDL_GetError();
+        
+        SDL_FreeSurface(surf);
+    }
+    
     void checkSyncLock() {
         if (!threadData->syncPoint.mainSyncLocked())
             return;
@@ -1192,6 +1358,13 @@ Graphics::Graphics(RGSSThreadData *data) {
     } else if (data->config.fixedFramerate < 0) {
         p->fpsLimiter.disabled = true;
     }
+    
+    p->fpsLimiter.spinWait = data->config.spinWaitLimiter;
+    p->fpsLimiter.vrr = data->config.vrrPacing;
+    
+    /* Run scripts as fast as they go */
+    if (data->config.headless.enabled)
+        p->fpsLimiter.disabled = true;
 }
 
 Graphics::~Graphics() { delete p; }
@@ -1204,7 +1377,28 @@ double Graphics::lastUpdate() {
     return p->last_update;
 }
 
+/* Charges everything inside Graphics.update to the graphics
+ * phase, and closes the profiled frame on the way out */
+struct ProfileUpdateScope
+{
+    FrameProfiler &profiler;
+    
+    ProfileUpdateScope(FrameProfiler &profiler)
+    : profiler(profiler)
+    {
+        profiler.push(FrameProfiler::PhaseGraphics);
+    }
+    
+    ~ProfileUpdateScope()
+    {
+        profiler.pop();
+        profiler.endFrame();
+    }
+};
+
 void Graphics::update(bool checkForShutdown) {
+    ProfileUpdateScope profile(shState->profiler());
+    
     p->threadData->rqWindowAdjust.wait();
     p->last_update = shState->runTime();
     
@@ -1222,6 +1416,8 @@ void Graphics::update(bool checkForShutdown) {
     
     p->checkSyncLock();
     
+    shState->imageWriter().update();
+    
     
 #ifdef MKXPZ_STEAM
     if (STEAMSHIM_alive())
@@ -1234,7 +1430,11 @@ void Graphics::update(bool checkForShutdown) {
     if (p->fpsLimiter.frameSkipRequired()) {
         if (p->useFrameSkip) {
             /* Skip frame */
-            p->fpsLimiter.delay();
+            {
+                ProfileScope sleep(shState->profiler(), FrameProfiler::PhaseLimiterSleep);
+                p->fpsLimiter.delay();
+            }
+            
             ++p->frameCount;
             p->threadData->ethread->notifyFrame();
             
@@ -1402,6 +1602,10 @@ double Graphics::averageFrameRate() {
     return p->averageFPS();
 }
 
+void Graphics::frameTimeStats(FrameTimeStats &out) {
+    p->fpsLimiter.getStats(out);
+}
+
 void Graphics::wait(int duration) {
     for (int i = 0; i < duration; ++i) {
         p->checkShutDownReset();
@@ -1607,6 +1811,18 @@ void Graphics::screenshot(const char *filename) {
     delete ss;
 }
 
+void Graphics::screenshotAsync(const char *filename) {
+    p->threadData->rqWindowAdjust.wait();
+    
+    /* Snap the same way screenshot() does, so both write images
+     * of the same size. The readback is queued before the Bitmap
+     * goes away, so disposing it right after is fine */
+    Bitmap *ss = snapToBitmap();
+    ss->saveToFileAsync(filename);
+    ss->dispose();
+    delete ss;
+}
+
 DEF_ATTR_RD_SIMPLE(Graphics, Brightness, int, p->brightness)
 
 void Graphics::setBrightness(int value) {
@@ -1634,6 +1850,7 @@ void Graphics::reset() {
     p->fpsLimiter.resetFrameAdjust();
     p->frozen = false;
     p->screen.getPP().clearBuffers();
+    SceneRevision::bump();
     
     setFrameRate(DEF_FRAMERATE);
     setBrightness(255);
@@ -1740,6 +1957,16 @@ void Graphics::setThreadsafe(bool value)
     p->multithreadedMode = value;
 }
 
+bool Graphics::getProfiling() const
+{
+    return shState->profiler().isEnabled();
+}
+
+void Graphics::setProfiling(bool value)
+{
+    shState->profiler().setEnabled(value);
+}
+
 double Graphics::getScale() const {
     p->checkResize();
     return (double)(p->winSize.y / p->backingScaleFactor) / p->scRes.y;
@@ -1807,8 +2034,18 @@ const TEX::ID &Graphics::obscuredTex() const
     return p->obscuredTex;
 }
 
-void Graphics::addDisposable(Disposable *d) { p->dispList.append(d->link); }
+/* Objects may be created on a Ruby thread that released the GVL
+ * (while holding the GL lock), concurrently with others that didn't */
+void Graphics::addDisposable(Disposable *d) {
+    SDL_LockMutex(p->glResourceLock);
+    p->dispList.append(d->link);
+    SDL_UnlockMutex(p->glResourceLock);
+}
 
-void Graphics::remDisposable(Disposable *d) { p->dispList.remove(d->link); }
+void Graphics::remDisposable(Disposable *d) {
+    SDL_LockMutex(p->glResourceLock);
+    p->dispList.remove(d->link);
+    SDL_UnlockMutex(p->glResourceLock);
+}
 
 #undef GRAPHICS_THREAD_LOCK
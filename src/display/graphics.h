@@ -34,6 +34,21 @@ struct AtomicFlag;
 struct THEORAPLAY_VideoFrame;
 struct Movie;
 
+/* Present-to-present intervals over the last
+ * couple of seconds, in milliseconds */
+struct FrameTimeStats
+{
+	int samples;
+	double mean;
+	double stddev;
+	double min;
+	double max;
+
+	/* How early the frame limiter currently wakes
+	 * up from sleep to spin-wait the remainder */
+	double sleepSlack;
+};
+
 class Graphics
 {
 public:
@@ -72,6 +87,7 @@ public:
 	bool updateMovieInput(Movie *movie);
 	void playMovie(const char *filename, int volume, bool skippable);
 	void screenshot(const char *filename);
+	void screenshotAsync(const char *filename);
 
 	void reset();
     void center();
@@ -87,7 +103,9 @@ public:
     DECL_ATTR( IntegerScaling, bool )
     DECL_ATTR( LastMileScaling, bool )
     DECL_ATTR( Threadsafe, bool )
+    DECL_ATTR( Profiling, bool )
     double averageFrameRate();
+    void frameTimeStats(FrameTimeStats &out);
 
 	/* <internal> */
 	Scene *getScreen() const;
@@ -0,0 +1,555 @@
+/*
+** imagewriter.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "imagewriter.h"
+
+#include "savewriter.h"
+#include "exception.h"
+#include "debugwriter.h"
+#include "sdl-util.h"
+#include "util.h"
+
+#include <SDL_image.h>
+#include <SDL_mutex.h>
+
+#include <png.h>
+
+#include <deque>
+#include <vector>
+#include <string.h>
+
+/* How long flush() waits on a single read back
+ * before checking again, in nanoseconds */
+#define READBACK_TIMEOUT 1000000000ull
+
+#define JPEG_QUALITY 90
+
+struct ImageJob
+{
+	std::vector<uint8_t> pixels;
+	int width, height;
+	std::string path;
+	ImageWriter::Format format;
+	int pngLevel;
+};
+
+struct Readback
+{
+	GLuint pbo;
+	GLsync fence;
+	int width, height;
+	std::string path;
+};
+
+static void pngWrite(png_structp png, png_bytep data, png_size_t length)
+{
+	std::string *out = static_cast<std::string*>(png_get_io_ptr(png));
+	out->append((const char*) data, length);
+}
+
+static void pngFlush(png_structp)
+{}
+
+static void encodePng(const void *pixels, int width, int height,
+                      int level, const char *path, std::string &out)
+{
+	std::vector<png_bytep> rows(height);
+
+	for (int y = 0; y < height; ++y)
+		rows[y] = (png_bytep) pixels + (size_t) y * width * 4;
+
+	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+	png_infop info = png ? png_create_info_struct(png) : 0;
+
+	if (!info)
+	{
+		png_destroy_write_struct(&png, 0);
+		throw Exception(Exception::MKXPError, "Failed to set up PNG encoder for '%s'", path);
+	}
+
+	if (setjmp(png_jmpbuf(png)))
+	{
+		png_destroy_write_struct(&png, &info);
+		throw Exception(Exception::MKXPError, "Failed to encode '%s' as PNG", path);
+	}
+
+	png_set_write_fn(png, &out, pngWrite, pngFlush);
+	png_set_compression_level(png, level);
+	png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGBA,
+	             PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+	             PNG_FILTER_TYPE_DEFAULT);
+
+	png_write_info(png, info);
+	png_write_image(png, &rows[0]);
+	png_write_end(png, 0);
+
+	png_destroy_write_struct(&png, &info);
+}
+
+/* Lets the SDL encoders write into memory, so their output
+ * can be saved through SaveWriter like the PNG encoder's */
+struct MemoryOut
+{
+	std::string *data;
+	size_t pos;
+};
+
+static inline MemoryOut *memOut(SDL_RWops *ops)
+{
+	return static_cast<MemoryOut*>(ops->hidden.unknown.data1);
+}
+
+static Sint64 memOutSize(SDL_RWops *ops)
+{
+	return memOut(ops)->data->size();
+}
+
+static Sint64 memOutSeek(SDL_RWops *ops, Sint64 offset, int whence)
+{
+	MemoryOut *out = memOut(ops);
+	Sint64 base = 0;
+
+	if (whence == RW_SEEK_CUR)
+		base = out->pos;
+	else if (whence == RW_SEEK_END)
+		base = out->data->size();
+
+	if (base + offset < 0)
+		return SDL_SetError("Seek before start of image data");
+
+	out->pos = base + offset;
+
+	return out->pos;
+}
+
+static size_t memOutRead(SDL_RWops *, void *, size_t, size_t)
+{
+	return 0;
+}
+
+static size_t memOutWrite(SDL_RWops *ops, const void *buffer, size_t size, size_t num)
+{
+	MemoryOut *out = memOut(ops);
+	const size_t bytes = size * num;
+
+	if (out->data->size() < out->pos + bytes)
+		out->data->resize(out->pos + bytes);
+
+	memcpy(&(*out->data)[out->pos], buffer, bytes);
+	out->pos += bytes;
+
+	return num;
+}
+
+static int memOutClose(SDL_RWops *)
+{
+	return 0;
+}
+
+static void initMemoryOut(SDL_RWops &ops, MemoryOut &out, std::string &data)
+{
+	out.data = &data;
+	out.pos = 0;
+
+	ops.size = memOutSize;
+	ops.seek = memOutSeek;
+	ops.read = memOutRead;
+	ops.write = memOutWrite;
+	ops.close = memOutClose;
+	ops.type = SDL_RWOPS_UNKNOWN;
+	ops.hidden.unknown.data1 = &out;
+}
+
+ImageWriter::Format ImageWriter::formatForPath(const char *path)
+{
+	const char *period = strrchr(path, '.');
+
+	if (!period)
+		return BMP;
+
+	std::string ext(period+1);
+
+	for (size_t i = 0; i < ext.size(); ++i)
+		ext[i] = tolower(ext[i]);
+
+	if (ext == "png")
+		return PNG;
+
+	if (ext == "jpg" || ext == "jpeg")
+		return JPEG;
+
+	return BMP;
+}
+
+void ImageWriter::writeImage(const void *pixels, int width, int height,
+                             const char *path, Format format, int pngLevel)
+{
+	std::string data;
+
+	if (format == PNG)
+	{
+		encodePng(pixels, width, height, pngLevel, path, data);
+	}
+	else
+	{
+		SDL_Surface *surf =
+		        SDL_CreateRGBSurfaceWithFormatFrom(const_cast<void*>(pixels), width, height,
+		                                           32, width*4, SDL_PIXELFORMAT_ABGR8888);
+
+		if (!surf)
+			throw Exception(Exception::SDLError, "Failed to prepare image for saving: %s", SDL_GetError());
+
+		SDL_RWops ops;
+		MemoryOut out;
+		initMemoryOut(ops, out, data);
+
+		int rc = (format == JPEG) ? IMG_SaveJPG_RW(surf, &ops, 0, JPEG_QUALITY)
+		                          : SDL_SaveBMP_RW(surf, &ops, 0);
+
+		SDL_FreeSurface(surf);
+
+		if (rc)
+			throw Exception(Exception::SDLError, "%s", SDL_GetError());
+	}
+
+	/* Every format goes through a temporary file, so an
+	 * interrupted save never leaves a truncated image */
+	SaveWriter::writeFile(path, data.data(), data.size());
+}
+
+struct ImageWriterPrivate
+{
+	int pngLevel;
+
+	/* Only touched on the thread owning the GL context */
+	std::deque<Readback> readbacks;
+
+	SDL_Thread *thread;
+	SDL_mutex *mutex;
+	SDL_cond *cond;
+
+	std::deque<ImageJob> queue;
+	std::string current;
+	bool busy;
+
+	std::string error;
+	bool quit;
+
+	ImageWriterPrivate()
+	    : pngLevel(6),
+	      thread(0),
+	      mutex(SDL_CreateMutex()),
+	      cond(SDL_CreateCond()),
+	      busy(false),
+	      quit(false)
+	{}
+
+	~ImageWriterPrivate()
+	{
+		SDL_DestroyCond(cond);
+		SDL_DestroyMutex(mutex);
+	}
+
+	void submit(ImageJob &job)
+	{
+		SDL_LockMutex(mutex);
+
+		queue.push_back(ImageJob());
+		ImageJob &back = queue.back();
+		back.pixels.swap(job.pixels);
+		back.width = job.width;
+		back.height = job.height;
+		back.path.swap(job.path);
+		back.format = job.format;
+		back.pngLevel = job.pngLevel;
+
+		SDL_CondBroadcast(cond);
+		SDL_UnlockMutex(mutex);
+
+		if (!thread)
+			thread = createSDLThread<ImageWriterPrivate, &ImageWriterPrivate::run>(this, "imagewriter");
+	}
+
+	/* Maps the finished read back and passes it on */
+	void finishReadback(Readback &rb)
+	{
+		const size_t size = (size_t) rb.width * rb.height * 4;
+
+		ImageJob job;
+		job.width = rb.width;
+		job.height = rb.height;
+		job.path.swap(rb.path);
+		job.format = ImageWriter::formatForPath(job.path.c_str());
+		job.pngLevel = pngLevel;
+
+		gl.BindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo);
+		void *data = gl.MapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+
+		if (data)
+		{
+			job.pixels.assign((const uint8_t*) data, (const uint8_t*) data + size);
+			gl.UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+
+		gl.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		gl.DeleteSync(rb.fence);
+		gl.DeleteBuffers(1, &rb.pbo);
+
+		if (!data)
+		{
+			SDL_LockMutex(mutex);
+			if (error.empty())
+				error = "Failed to read back image for '" + job.path + "'";
+			SDL_UnlockMutex(mutex);
+
+			return;
+		}
+
+		submit(job);
+	}
+
+	void run()
+	{
+		SDL_LockMutex(mutex);
+
+		while (true)
+		{
+			while (queue.empty() && !quit)
+				SDL_CondWait(cond, mutex);
+
+			if (queue.empty())
+				break;
+
+			ImageJob job;
+			job.pixels.swap(queue.front().pixels);
+			job.path.swap(queue.front().path);
+			job.width = queue.front().width;
+			job.height = queue.front().height;
+			job.format = queue.front().format;
+			job.pngLevel = queue.front().pngLevel;
+			queue.pop_front();
+
+			current = job.path;
+			busy = true;
+
+			SDL_UnlockMutex(mutex);
+
+			std::string failure;
+
+			try
+			{
+				ImageWriter::writeImage(&job.pixels[0], job.width, job.height,
+				                        job.path.c_str(), job.format, job.pngLevel);
+			}
+			catch (const Exception &e)
+			{
+				failure = e.msg.c_str();
+				Debug() << "Background image save failed:" << failure;
+			}
+
+			SDL_LockMutex(mutex);
+
+			if (!failure.empty() && error.empty())
+				error = failure;
+
+			busy = false;
+			SDL_CondBroadcast(cond);
+		}
+
+		SDL_UnlockMutex(mutex);
+	}
+};
+
+ImageWriter::ImageWriter()
+    : p(new ImageWriterPrivate)
+{}
+
+ImageWriter::~ImageWriter()
+{
+	flush();
+
+	if (p->thread)
+	{
+		SDL_LockMutex(p->mutex);
+		p->quit = true;
+		SDL_CondBroadcast(p->cond);
+		SDL_UnlockMutex(p->mutex);
+
+		SDL_WaitThread(p->thread, 0);
+	}
+
+	delete p;
+}
+
+void ImageWriter::setPngCompression(int level)
+{
+	p->pngLevel = clamp(level, 0, 9);
+}
+
+int ImageWriter::pngCompression() const
+{
+	return p->pngLevel;
+}
+
+void ImageWriter::capture(FBO::ID fbo, int width, int height, const char *path)
+{
+	if (!gl.map_buffer_range || !gl.sync)
+	{
+		std::vector<uint8_t> pixels((size_t) width * height * 4);
+
+		FBO::bind(fbo);
+		gl.ReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+
+		ImageJob job;
+		job.pixels.swap(pixels);
+		job.width = width;
+		job.height = height;
+		job.path = path;
+		job.format = formatForPath(path);
+		job.pngLevel = p->pngLevel;
+
+		p->submit(job);
+
+		return;
+	}
+
+	Readback rb;
+	rb.width = width;
+	rb.height = height;
+	rb.path = path;
+
+	gl.GenBuffers(1, &rb.pbo);
+	gl.BindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo);
+	gl.BufferData(GL_PIXEL_PACK_BUFFER, (size_t) width * height * 4, 0, GL_STREAM_READ);
+
+	FBO::bind(fbo);
+	gl.ReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+
+	gl.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	rb.fence = gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	p->readbacks.push_back(rb);
+}
+
+void ImageWriter::queue(const void *pixels, int width, int height, const char *path)
+{
+	ImageJob job;
+	job.pixels.assign((const uint8_t*) pixels,
+	                  (const uint8_t*) pixels + (size_t) width * height * 4);
+	job.width = width;
+	job.height = height;
+	job.path = path;
+	job.format = formatForPath(path);
+	job.pngLevel = p->pngLevel;
+
+	p->submit(job);
+}
+
+void ImageWriter::update()
+{
+	/* Read backs complete in submission order */
+	while (!p->readbacks.empty())
+	{
+		Readback &rb = p->readbacks.front();
+		GLenum state = gl.ClientWaitSync(rb.fence, 0, 0);
+
+		if (state == GL_TIMEOUT_EXPIRED)
+			break;
+
+		/* The fence can't tell us anymore; make sure
+		 * the copy has landed the expensive way */
+		if (state == GL_WAIT_FAILED)
+			gl.Finish();
+
+		p->finishReadback(rb);
+		p->readbacks.pop_front();
+	}
+}
+
+bool ImageWriter::isPending(const char *path)
+{
+	for (size_t i = 0; i < p->readbacks.size(); ++i)
+		if (!path || p->readbacks[i].path == path)
+			return true;
+
+	SDL_LockMutex(p->mutex);
+
+	bool pending;
+
+	if (!path)
+	{
+		pending = p->busy || !p->queue.empty();
+	}
+	else
+	{
+		pending = p->busy && p->current == path;
+
+		for (size_t i = 0; i < p->queue.size() && !pending; ++i)
+			pending = p->queue[i].path == path;
+	}
+
+	SDL_UnlockMutex(p->mutex);
+
+	return pending;
+}
+
+void ImageWriter::flush()
+{
+	while (!p->readbacks.empty())
+	{
+		Readback &rb = p->readbacks.front();
+		GLenum state;
+
+		do
+			state = gl.ClientWaitSync(rb.fence, GL_SYNC_FLUSH_COMMANDS_BIT, READBACK_TIMEOUT);
+		while (state == GL_TIMEOUT_EXPIRED);
+
+		if (state == GL_WAIT_FAILED)
+			gl.Finish();
+
+		p->finishReadback(rb);
+		p->readbacks.pop_front();
+	}
+
+	SDL_LockMutex(p->mutex);
+
+	while (p->busy || !p->queue.empty())
+		SDL_CondWait(p->cond, p->mutex);
+
+	SDL_UnlockMutex(p->mutex);
+}
+
+bool ImageWriter::takeError(std::string &error)
+{
+	SDL_LockMutex(p->mutex);
+
+	bool failed = !p->error.empty();
+
+	if (failed)
+	{
+		error.swap(p->error);
+		p->error.clear();
+	}
+
+	SDL_UnlockMutex(p->mutex);
+
+	return failed;
+}
@@ -0,0 +1,89 @@
+/*
+** imagewriter.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEWRITER_H
+#define IMAGEWRITER_H
+
+#include "gl-util.h"
+
+#include <string>
+
+struct ImageWriterPrivate;
+
+/* Saves RGBA images to disk without holding up the caller.
+ * Framebuffer contents are read back through a pixel buffer
+ * object and only mapped once the GPU signals that the copy
+ * is done (checked every frame from update()); encoding and
+ * writing then happen on a worker thread. Without PBO/sync
+ * support, the read back falls back to a plain ReadPixels. */
+class ImageWriter
+{
+public:
+	enum Format
+	{
+		BMP,
+		PNG,
+		JPEG
+	};
+
+	ImageWriter();
+	/* Finishes all pending saves first.
+	 * Expects the GL context to still be current */
+	~ImageWriter();
+
+	/* Guessed from the file extension; BMP if unknown */
+	static Format formatForPath(const char *path);
+
+	/* Encodes tightly packed RGBA 'pixels' to 'path' on
+	 * the calling thread. Throws an Exception on failure */
+	static void writeImage(const void *pixels, int width, int height,
+	                       const char *path, Format format, int pngLevel);
+
+	/* 0 (fastest) to 9 (smallest) */
+	void setPngCompression(int level);
+	int pngCompression() const;
+
+	/* Starts reading back the 'width' x 'height' contents
+	 * of 'fbo'. Needs the GL context */
+	void capture(FBO::ID fbo, int width, int height, const char *path);
+
+	/* Copies 'pixels' (tightly packed RGBA) for encoding */
+	void queue(const void *pixels, int width, int height, const char *path);
+
+	/* Hands finished read backs over to the worker.
+	 * Needs the GL context */
+	void update();
+
+	/* Whether saves to 'path' (or any path, if null)
+	 * are still in progress */
+	bool isPending(const char *path = 0);
+
+	/* Blocks until nothing is pending anymore.
+	 * Needs the GL context */
+	void flush();
+
+	/* Returns false if no save failed since the last call,
+	 * otherwise describes the first failure in 'error' */
+	bool takeError(std::string &error);
+
+private:
+	ImageWriterPrivate *p;
+};
+
+#endif // IMAGEWRITER_H
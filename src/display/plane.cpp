@@ -44,8 +44,11 @@ static float fwrap(float value, float range)
 
 struct PlanePrivate
 {
+	Plane *self;
+
 	Bitmap *bitmap;
 
+	sigslot::connection bitmapCon;
 	sigslot::connection bitmapDispCon;
 
 	NormValue opacity;
@@ -61,15 +64,28 @@ struct PlanePrivate
 
 	bool quadSourceDirty;
 
+	/* Regular bitmaps are drawn as one quad covering the scene;
+	 * TiledPlaneShader repeats the source rect across it */
+	Quad quad;
+
+	/* Mega bitmaps can't be sampled as a single texture, so
+	 * they are still tiled with one quad per repetition */
 	SimpleQuadArray qArray;
 
+	/* For mega bitmaps, the quads in 'qArray' are grouped by
+	 * bitmap tile; this holds the quad count of each group */
+	std::vector<size_t> megaTileQuads;
+
 	EtcTemps tmp;
 
 	sigslot::connection prepareCon;
 	sigslot::connection srcRectCon;
+	sigslot::connection colorCon;
+	sigslot::connection toneCon;
 
-	PlanePrivate()
-	    : bitmap(0),
+	PlanePrivate(Plane *self)
+	    : self(self),
+	      bitmap(0),
 	      opacity(255),
 	      blendType(BlendNormal),
 	      color(&tmp.color),
@@ -80,15 +96,16 @@ struct PlanePrivate
 	      quadSourceDirty(false)
 	{
 		updateSrcRectCon();
+		updateColorToneCon();
 		prepareCon = shState->prepareDraw.connect
 		        (&PlanePrivate::prepare, this);
-
-		qArray.resize(1);
 	}
 
 	~PlanePrivate()
 	{
 		srcRectCon.disconnect();
+		colorCon.disconnect();
+		toneCon.disconnect();
 		prepareCon.disconnect();
 		
 		bitmapDisposal();
@@ -97,12 +114,26 @@ struct PlanePrivate
 	void bitmapDisposal()
 	{
 		bitmap = 0;
+		bitmapCon.disconnect();
 		bitmapDispCon.disconnect();
 	}
 
+	/* Disposed while still shown */
+	void onBitmapDisposed()
+	{
+		bitmapDisposal();
+		notifyChange();
+	}
+
+	void notifyChange()
+	{
+		self->notifyChange();
+	}
+
 	void onSrcRectChange()
 	{
 		quadSourceDirty = true;
+		notifyChange();
 	}
 
 	void updateSrcRectCon()
@@ -111,21 +142,36 @@ struct PlanePrivate
 		srcRectCon = srcRect->valueChanged.connect(&PlanePrivate::onSrcRectChange, this);
 	}
 
+	void updateColorToneCon()
+	{
+		colorCon.disconnect();
+		colorCon = color->valueChanged.connect(&PlanePrivate::notifyChange, this);
+
+		toneCon.disconnect();
+		toneCon = tone->valueChanged.connect(&PlanePrivate::notifyChange, this);
+	}
+
 	void updateQuadSource()
 	{
 		if (nullOrDisposed(bitmap))
 			return;
 
-		if (gl.npot_repeat && srcRect->toIntRect() == bitmap->rect())
+		if (!bitmap->isMega())
 		{
-			FloatRect srcRect;
-			srcRect.x = (sceneGeo.orig.x + ox) / zoomX;
-			srcRect.y = (sceneGeo.orig.y + oy) / zoomY;
-			srcRect.w = sceneGeo.rect.w / zoomX;
-			srcRect.h = sceneGeo.rect.h / zoomY;
+			const IntRect src = srcRect->toIntRect();
+
+			if (src.w <= 0 || src.h <= 0)
+				return;
 
-			Quad::setTexRect(&qArray.vertices[0], srcRect);
-			qArray.commit();
+			/* Keep the offset inside one repetition so the
+			 * texture coordinates stay small (and precise) */
+			FloatRect tex;
+			tex.x = src.x + fwrap((sceneGeo.orig.x + ox) / zoomX, src.w);
+			tex.y = src.y + fwrap((sceneGeo.orig.y + oy) / zoomY, src.h);
+			tex.w = sceneGeo.rect.w / zoomX;
+			tex.h = sceneGeo.rect.h / zoomY;
+
+			quad.setTexPosRect(tex, FloatRect(sceneGeo.rect));
 
 			return;
 		}
@@ -146,18 +192,56 @@ struct PlanePrivate
 		size_t tilesX = ceil((vpw - sw + wox) / sw) + 1;
 		size_t tilesY = ceil((vph - sh + woy) / sh) + 1;
 
-		FloatRect tex = srcRect->toFloatRect();
+		updateMegaQuadSource(tilesX, tilesY, sw, sh, wox, woy);
+	}
+
+	void updateMegaQuadSource(size_t tilesX, size_t tilesY,
+	                          float sw, float sh, float wox, float woy)
+	{
+		IntRect src = srcRect->toIntRect();
+		int count = bitmap->megaTileCount();
+
+		megaTileQuads.assign(count, 0);
+
+		size_t parts = 0;
+
+		for (int i = 0; i < count; ++i)
+		{
+			IntRect part = bitmap->megaTileRect(i).intersected(src);
+
+			if (part.w > 0 && part.h > 0)
+				++parts;
+		}
+
+		qArray.resize(parts * tilesX * tilesY);
+		SVertex *vert = dataPtr(qArray.vertices);
+
+		for (int i = 0; i < count; ++i)
+		{
+			IntRect tile = bitmap->megaTileRect(i);
+			IntRect part = tile.intersected(src);
+
+			if (part.w == 0 || part.h == 0)
+				continue;
 
-		qArray.resize(tilesX * tilesY);
+			FloatRect tex(part.x - tile.x, part.y - tile.y, part.w, part.h);
 
-		for (size_t y = 0; y < tilesY; ++y)
-			for (size_t x = 0; x < tilesX; ++x)
-			{
-				SVertex *vert = &qArray.vertices[(y*tilesX + x) * 4];
-				FloatRect pos(x*sw - wox, y*sh - woy, sw, sh);
+			/* Offset of this part inside one repetition */
+			float px = (part.x - src.x) * zoomX;
+			float py = (part.y - src.y) * zoomY;
 
-				Quad::setTexPosRect(vert, tex, pos);
-			}
+			for (size_t y = 0; y < tilesY; ++y)
+				for (size_t x = 0; x < tilesX; ++x)
+				{
+					FloatRect pos(x*sw - wox + px, y*sh - woy + py,
+					              part.w * zoomX, part.h * zoomY);
+
+					Quad::setTexPosRect(vert, tex, pos);
+					vert += 4;
+				}
+
+			megaTileQuads[i] = tilesX * tilesY;
+		}
 
 		qArray.commit();
 	}
@@ -178,7 +262,7 @@ struct PlanePrivate
 Plane::Plane(Viewport *viewport)
     : ViewportElement(viewport)
 {
-	p = new PlanePrivate();
+	p = new PlanePrivate(this);
 
 	onGeometryChange(scene->getGeometry());
 }
@@ -190,10 +274,10 @@ DEF_ATTR_RD_SIMPLE(Plane, ZoomX,     float,   p->zoomX)
 DEF_ATTR_RD_SIMPLE(Plane, ZoomY,     float,   p->zoomY)
 DEF_ATTR_RD_SIMPLE(Plane, BlendType, int,     p->blendType)
 
-DEF_ATTR_SIMPLE(Plane, Opacity,   int,     p->opacity)
-DEF_ATTR_SIMPLE(Plane, Color,     Color&, *p->color)
-DEF_ATTR_SIMPLE(Plane, Tone,      Tone&,  *p->tone)
-DEF_ATTR_SIMPLE(Plane, SrcRect,   Rect&,  *p->srcRect)
+DEF_SCENE_ATTR_SIMPLE(Plane, Opacity,   int,     p->opacity)
+DEF_SCENE_ATTR_SIMPLE(Plane, Color,     Color&, *p->color)
+DEF_SCENE_ATTR_SIMPLE(Plane, Tone,      Tone&,  *p->tone)
+DEF_SCENE_ATTR_SIMPLE(Plane, SrcRect,   Rect&,  *p->srcRect)
 
 Plane::~Plane()
 {
@@ -204,8 +288,11 @@ void Plane::setBitmap(Bitmap *value)
 {
 	guardDisposed();
 
+	notifyChange();
+
 	p->bitmap = value;
 
+	p->bitmapCon.disconnect();
 	p->bitmapDispCon.disconnect();
 
 	if (nullOrDisposed(value))
@@ -214,9 +301,8 @@ void Plane::setBitmap(Bitmap *value)
 		return;
 	}
 
-	p->bitmapDispCon = value->wasDisposed.connect(&PlanePrivate::bitmapDisposal, p);
-
-	value->ensureNonMega();
+	p->bitmapCon = value->modified.connect(&PlanePrivate::notifyChange, p);
+	p->bitmapDispCon = value->wasDisposed.connect(&PlanePrivate::onBitmapDisposed, p);
 
 	*p->srcRect = value->rect();
 	p->onSrcRectChange();
@@ -229,6 +315,8 @@ void Plane::setOX(int value)
 	if (p->ox == value)
 	        return;
 
+	notifyChange();
+
 	p->ox = value;
 	p->quadSourceDirty = true;
 }
@@ -240,6 +328,8 @@ void Plane::setOY(int value)
 	if (p->oy == value)
 	        return;
 
+	notifyChange();
+
 	p->oy = value;
 	p->quadSourceDirty = true;
 }
@@ -251,6 +341,8 @@ void Plane::setZoomX(float value)
 	if (p->zoomX == value)
 	        return;
 
+	notifyChange();
+
 	p->zoomX = value;
 	p->quadSourceDirty = true;
 }
@@ -262,6 +354,8 @@ void Plane::setZoomY(float value)
 	if (p->zoomY == value)
 	        return;
 
+	notifyChange();
+
 	p->zoomY = value;
 	p->quadSourceDirty = true;
 }
@@ -270,6 +364,11 @@ void Plane::setBlendType(int value)
 {
 	guardDisposed();
 
+	if (p->blendType == value)
+		return;
+
+	notifyChange();
+
 	switch (value)
 	{
 	default :
@@ -292,6 +391,7 @@ void Plane::initDynAttribs()
 	p->srcRect = new Rect;
 
 	p->updateSrcRectCon();
+	p->updateColorToneCon();
 }
 
 void Plane::draw()
@@ -302,6 +402,35 @@ void Plane::draw()
 	if (!p->opacity)
 		return;
 
+	if (!p->bitmap->isMega())
+	{
+		const IntRect src = p->srcRect->toIntRect();
+
+		if (src.w <= 0 || src.h <= 0)
+			return;
+
+		const Vec2 texSize(p->bitmap->width(), p->bitmap->height());
+
+		TiledPlaneShader &shader = shState->shaders().planeTiled;
+
+		shader.bind();
+		shader.applyViewportProj();
+		shader.setTranslation(Vec2i());
+		shader.setTone(p->tone->norm);
+		shader.setColor(p->color->norm);
+		shader.setOpacity(p->opacity.norm);
+		shader.setTileRect(Vec4(src.x / texSize.x, src.y / texSize.y,
+		                        src.w / texSize.x, src.h / texSize.y));
+
+		glState.blendMode.pushSet(p->blendType);
+
+		p->bitmap->bindTex(shader);
+		p->quad.draw();
+
+		glState.blendMode.pop();
+		return;
+	}
+
 	ShaderBase *base;
 
 	if (p->color->hasEffect() || p->tone->hasEffect() || p->opacity != 255)
@@ -330,24 +459,24 @@ void Plane::draw()
 
 	glState.blendMode.pushSet(p->blendType);
 
-	p->bitmap->bindTex(*base);
+	size_t offset = 0;
 
-	if (gl.npot_repeat)
-		TEX::setRepeat(true);
+	for (size_t i = 0; i < p->megaTileQuads.size(); ++i)
+	{
+		if (p->megaTileQuads[i] == 0)
+			continue;
 
-	p->qArray.draw();
+		p->bitmap->bindMegaTile(i, *base);
+		p->qArray.draw(offset, p->megaTileQuads[i]);
 
-	if (gl.npot_repeat)
-		TEX::setRepeat(false);
+		offset += p->megaTileQuads[i];
+	}
 
 	glState.blendMode.pop();
 }
 
 void Plane::onGeometryChange(const Scene::Geometry &geo)
 {
-	if (gl.npot_repeat)
-		Quad::setPosRect(&p->qArray.vertices[0], FloatRect(geo.rect));
-
 	p->sceneGeo = geo;
 	p->quadSourceDirty = true;
 }
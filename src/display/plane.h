@@ -54,6 +54,7 @@ private:
 	PlanePrivate *p;
 
 	void draw();
+	FrameProfiler::Phase profilePhase() const { return FrameProfiler::PhasePlane; }
 	void onGeometryChange(const Scene::Geometry &);
 
 	void releaseResources();
@@ -47,8 +47,11 @@
 
 struct SpritePrivate
 {
+    Sprite *self;
+    
     Bitmap *bitmap;
     
+    sigslot::connection bitmapCon;
     sigslot::connection bitmapDispCon;
     
     Quad quad;
@@ -65,6 +68,7 @@ struct SpritePrivate
     BlendType blendType;
     
     Bitmap *pattern;
+    sigslot::connection patternCon;
     BlendType patternBlendType;
     bool patternTile;
     NormValue patternOpacity;
@@ -84,6 +88,8 @@ struct SpritePrivate
     
     Color *color;
     Tone *tone;
+    sigslot::connection colorCon;
+    sigslot::connection toneCon;
     
     struct
     {
@@ -103,8 +109,9 @@ struct SpritePrivate
     
     sigslot::connection prepareCon;
     
-    SpritePrivate()
-    : bitmap(0),
+    SpritePrivate(Sprite *self)
+    : self(self),
+    bitmap(0),
     srcRect(&tmp.rect),
     mirrored(false),
     bushDepth(0),
@@ -125,6 +132,7 @@ struct SpritePrivate
         sceneRect.x = sceneRect.y = 0;
         
         updateSrcRectCon();
+        updateColorToneCon();
         
         prepareCon = shState->prepareDraw.connect
         (&SpritePrivate::prepare, this);
@@ -142,6 +150,9 @@ struct SpritePrivate
     ~SpritePrivate()
     {
         srcRectCon.disconnect();
+        colorCon.disconnect();
+        toneCon.disconnect();
+        patternCon.disconnect();
         prepareCon.disconnect();
         
         bitmapDisposal();
@@ -150,8 +161,21 @@ struct SpritePrivate
     void bitmapDisposal()
     {
         bitmap = 0;
+        bitmapCon.disconnect();
         bitmapDispCon.disconnect();
     }
+    
+    /* Disposed while still shown */
+    void onBitmapDisposed()
+    {
+        bitmapDisposal();
+        notifyChange();
+    }
+    
+    void notifyChange()
+    {
+        self->notifyChange();
+    }
 
     void recomputeBushDepth()
     {
@@ -168,6 +192,8 @@ struct SpritePrivate
     
     void onSrcRectChange()
     {
+        notifyChange();
+        
         FloatRect rect = srcRect->toFloatRect();
         Vec2i bmSize;
         Vec2i bmSizeHires;
@@ -205,6 +231,50 @@ struct SpritePrivate
         wave.dirty = true;
     }
     
+    /* Mega bitmaps have no single texture, so the source rect
+     * is drawn piece by piece from the tiles under it. Waves
+     * aren't applied here. Tiles are always sampled nearest:
+     * filtering can't reach across into the neighbouring
+     * tile, so it would leave seams along the tile edges */
+    void drawMegaTiles(ShaderBase &shader, SpriteShader *spriteShader)
+    {
+        IntRect rect = srcRect->toIntRect();
+        rect.w = clamp<int>(rect.w, 0, bitmap->width()-rect.x);
+        rect.h = clamp<int>(rect.h, 0, bitmap->height()-rect.y);
+        
+        /* Bush depth as a bitmap row */
+        float bushRow = efBushDepth * bitmap->height();
+        
+        Quad &tileQuad = shState->gpQuad();
+        tileQuad.setColor(Vec4(1, 1, 1, 1));
+        
+        for (int i = 0; i < bitmap->megaTileCount(); ++i)
+        {
+            IntRect tile = bitmap->megaTileRect(i);
+            IntRect part = tile.intersected(rect);
+            
+            if (part.w == 0 || part.h == 0)
+                continue;
+            
+            FloatRect tex(part.x - tile.x, part.y - tile.y, part.w, part.h);
+            FloatRect pos(part.x - rect.x, part.y - rect.y, part.w, part.h);
+            
+            if (mirrored)
+            {
+                tex = tex.hFlipped();
+                pos.x = rect.w - (pos.x + pos.w);
+            }
+            
+            if (spriteShader)
+                spriteShader->setBushDepth((bushRow - tile.y) / tile.h);
+            
+            bitmap->bindMegaTile(i, shader);
+            
+            tileQuad.setTexPosRect(tex, pos);
+            tileQuad.draw();
+        }
+    }
+    
     void updateSrcRectCon()
     {
         /* Cut old connection */
@@ -214,6 +284,17 @@ struct SpritePrivate
         (&SpritePrivate::onSrcRectChange, this);
     }
     
+    void updateColorToneCon()
+    {
+        colorCon.disconnect();
+        colorCon = color->valueChanged.connect
+        (&SpritePrivate::notifyChange, this);
+        
+        toneCon.disconnect();
+        toneCon = tone->valueChanged.connect
+        (&SpritePrivate::notifyChange, this);
+    }
+    
     void updateVisibility()
     {
         isVisible = false;
@@ -350,7 +431,7 @@ struct SpritePrivate
 Sprite::Sprite(Viewport *viewport)
 : ViewportElement(viewport)
 {
-    p = new SpritePrivate;
+    p = new SpritePrivate(this);
     onGeometryChange(scene->getGeometry());
 }
 
@@ -379,19 +460,19 @@ DEF_ATTR_RD_SIMPLE(Sprite, WaveLength, int,     p->wave.length)
 DEF_ATTR_RD_SIMPLE(Sprite, WaveSpeed,  int,     p->wave.speed)
 DEF_ATTR_RD_SIMPLE(Sprite, WavePhase,  float,   p->wave.phase)
 
-DEF_ATTR_SIMPLE(Sprite, BushOpacity, int,     p->bushOpacity)
-DEF_ATTR_SIMPLE(Sprite, Opacity,     int,     p->opacity)
-DEF_ATTR_SIMPLE(Sprite, SrcRect,     Rect&,  *p->srcRect)
-DEF_ATTR_SIMPLE(Sprite, Color,       Color&, *p->color)
-DEF_ATTR_SIMPLE(Sprite, Tone,        Tone&,  *p->tone)
-DEF_ATTR_SIMPLE(Sprite, PatternTile, bool, p->patternTile)
-DEF_ATTR_SIMPLE(Sprite, PatternOpacity, int, p->patternOpacity)
-DEF_ATTR_SIMPLE(Sprite, PatternScrollX, int, p->patternScroll.x)
-DEF_ATTR_SIMPLE(Sprite, PatternScrollY, int, p->patternScroll.y)
-DEF_ATTR_SIMPLE(Sprite, PatternZoomX, float, p->patternZoom.x)
-DEF_ATTR_SIMPLE(Sprite, PatternZoomY, float, p->patternZoom.y)
-DEF_ATTR_SIMPLE(Sprite, Invert,      bool,    p->invert)
-DEF_ATTR_SIMPLE(Sprite, Obscured,    bool,    p->obscured)
+DEF_SCENE_ATTR_SIMPLE(Sprite, BushOpacity, int,     p->bushOpacity)
+DEF_SCENE_ATTR_SIMPLE(Sprite, Opacity,     int,     p->opacity)
+DEF_SCENE_ATTR_SIMPLE(Sprite, SrcRect,     Rect&,  *p->srcRect)
+DEF_SCENE_ATTR_SIMPLE(Sprite, Color,       Color&, *p->color)
+DEF_SCENE_ATTR_SIMPLE(Sprite, Tone,        Tone&,  *p->tone)
+DEF_SCENE_ATTR_SIMPLE(Sprite, PatternTile, bool, p->patternTile)
+DEF_SCENE_ATTR_SIMPLE(Sprite, PatternOpacity, int, p->patternOpacity)
+DEF_SCENE_ATTR_SIMPLE(Sprite, PatternScrollX, int, p->patternScroll.x)
+DEF_SCENE_ATTR_SIMPLE(Sprite, PatternScrollY, int, p->patternScroll.y)
+DEF_SCENE_ATTR_SIMPLE(Sprite, PatternZoomX, float, p->patternZoom.x)
+DEF_SCENE_ATTR_SIMPLE(Sprite, PatternZoomY, float, p->patternZoom.y)
+DEF_SCENE_ATTR_SIMPLE(Sprite, Invert,      bool,    p->invert)
+DEF_SCENE_ATTR_SIMPLE(Sprite, Obscured,    bool,    p->obscured)
 
 void Sprite::setBitmap(Bitmap *bitmap)
 {
@@ -400,8 +481,11 @@ void Sprite::setBitmap(Bitmap *bitmap)
     if (p->bitmap == bitmap)
         return;
     
+    notifyChange();
+    
     p->bitmap = bitmap;
     
+    p->bitmapCon.disconnect();
     p->bitmapDispCon.disconnect();
     
     if (nullOrDisposed(bitmap))
@@ -410,9 +494,8 @@ void Sprite::setBitmap(Bitmap *bitmap)
         return;
     }
     
-    p->bitmapDispCon = bitmap->wasDisposed.connect(&SpritePrivate::bitmapDisposal, p);
-    
-    bitmap->ensureNonMega();
+    p->bitmapCon = bitmap->modified.connect(&SpritePrivate::notifyChange, p);
+    p->bitmapDispCon = bitmap->wasDisposed.connect(&SpritePrivate::onBitmapDisposed, p);
     
     *p->srcRect = bitmap->rect();
     p->onSrcRectChange();
@@ -428,6 +511,8 @@ void Sprite::setX(int value)
     if (p->trans.getPosition().x == value)
         return;
     
+    notifyChange();
+    
     p->trans.setPosition(Vec2(value, getY()));
 }
 
@@ -438,6 +523,8 @@ void Sprite::setY(int value)
     if (p->trans.getPosition().y == value)
         return;
     
+    notifyChange();
+    
     p->trans.setPosition(Vec2(getX(), value));
     
     if (rgssVer >= 2)
@@ -454,6 +541,8 @@ void Sprite::setOX(int value)
     if (p->trans.getOrigin().x == value)
         return;
     
+    notifyChange();
+    
     p->trans.setOrigin(Vec2(value, getOY()));
 }
 
@@ -464,6 +553,8 @@ void Sprite::setOY(int value)
     if (p->trans.getOrigin().y == value)
         return;
     
+    notifyChange();
+    
     p->trans.setOrigin(Vec2(getOX(), value));
 }
 
@@ -474,6 +565,8 @@ void Sprite::setZoomX(float value)
     if (p->trans.getScale().x == value)
         return;
     
+    notifyChange();
+    
     p->trans.setScale(Vec2(value, getZoomY()));
 }
 
@@ -484,6 +577,8 @@ void Sprite::setZoomY(float value)
     if (p->trans.getScale().y == value)
         return;
     
+    notifyChange();
+    
     p->trans.setScale(Vec2(getZoomX(), value));
     p->recomputeBushDepth();
     
@@ -498,6 +593,8 @@ void Sprite::setAngle(float value)
     if (p->trans.getRotation() == value)
         return;
     
+    notifyChange();
+    
     p->trans.setRotation(value);
 }
 
@@ -508,6 +605,8 @@ void Sprite::setMirror(bool mirrored)
     if (p->mirrored == mirrored)
         return;
     
+    notifyChange();
+    
     p->mirrored = mirrored;
     p->onSrcRectChange();
 }
@@ -519,6 +618,8 @@ void Sprite::setBushDepth(int value)
     if (p->bushDepth == value)
         return;
     
+    notifyChange();
+    
     p->bushDepth = value;
     p->recomputeBushDepth();
 }
@@ -527,6 +628,11 @@ void Sprite::setBlendType(int type)
 {
     guardDisposed();
     
+    if (p->blendType == type)
+        return;
+    
+    notifyChange();
+    
     switch (type)
     {
         default :
@@ -549,16 +655,28 @@ void Sprite::setPattern(Bitmap *value)
     if (p->pattern == value)
         return;
     
+    notifyChange();
+    
     p->pattern = value;
     
-    if (!nullOrDisposed(value))
-        value->ensureNonMega();
+    p->patternCon.disconnect();
+    
+    if (nullOrDisposed(value))
+        return;
+    
+    value->ensureNonMega();
+    p->patternCon = value->modified.connect(&SpritePrivate::notifyChange, p);
 }
 
 void Sprite::setPatternBlendType(int type)
 {
     guardDisposed();
     
+    if (p->patternBlendType == type)
+        return;
+    
+    notifyChange();
+    
     switch (type)
     {
         default :
@@ -582,6 +700,7 @@ if (p->wave.name == value) \
 return; \
 p->wave.name = value; \
 p->wave.dirty = true; \
+notifyChange(); \
 }
 
 DEF_WAVE_SETTER(Amp,    amp,    int)
@@ -598,6 +717,7 @@ void Sprite::initDynAttribs()
     p->tone = new Tone;
     
     p->updateSrcRectCon();
+    p->updateColorToneCon();
 }
 
 /* Flashable */
@@ -607,8 +727,14 @@ void Sprite::update()
     
     Flashable::update();
     
+    const float phase = p->wave.phase;
+    
     p->wave.phase += p->wave.speed / 180;
     p->wave.dirty = true;
+    
+    /* The phase only shows while the sprite waves */
+    if (p->wave.amp != 0 && p->wave.phase != phase)
+        notifyChange();
 }
 
 /* SceneElement */
@@ -794,6 +920,17 @@ void Sprite::draw()
     
     glState.blendMode.pushSet(p->blendType);
     
+    if (p->bitmap->isMega())
+    {
+        SpriteShader *spriteShader = (renderEffect && !p->obscured) ?
+        &shState->shaders().sprite : 0;
+        
+        p->drawMegaTiles(*base, spriteShader);
+        
+        glState.blendMode.pop();
+        return;
+    }
+    
     p->bitmap->bindTex(*base, false);
 
     if (scalingMethod == xBRZ)
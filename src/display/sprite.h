@@ -83,7 +83,9 @@ private:
 	SpritePrivate *p;
 
 	void draw();
+	FrameProfiler::Phase profilePhase() const { return FrameProfiler::PhaseSprite; }
 	void onGeometryChange(const Scene::Geometry &);
+	void onFlashChange() { notifyChange(); }
 
 	void releaseResources();
 	const char *klassName() const { return "sprite"; }
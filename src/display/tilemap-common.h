@@ -31,6 +31,7 @@
 #include "shader.h"
 #include "vertex.h"
 #include "quad.h"
+#include "scene.h"
 #include "etc-internal.h"
 
 #include <stdint.h>
@@ -144,6 +145,7 @@ struct FlashMap
 		data = value;
 		dataCon.disconnect();
 		dirty = true;
+		SceneRevision::bump();
 
 		if (!data)
 			return;
@@ -159,13 +161,16 @@ struct FlashMap
 		dirty = true;
 	}
 
-	void prepare()
+	/* Returns whether the flashes changed */
+	bool prepare()
 	{
 		if (!dirty)
-			return;
+			return false;
 
 		rebuildBuffer();
 		dirty = false;
+
+		return true;
 	}
 
 	void draw(float alpha, const Vec2i &trans)
@@ -195,6 +200,7 @@ private:
 	void setDirty()
 	{
 		dirty = true;
+		SceneRevision::bump();
 	}
 
 	size_t quadCount() const
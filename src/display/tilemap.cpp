@@ -38,6 +38,7 @@
 #include "quad.h"
 #include "vertex.h"
 #include "tileatlas.h"
+#include "tileatlascache.h"
 #include "tilemap-common.h"
 
 #include "sigslot/signal.hpp"
@@ -45,6 +46,7 @@
 #include <string.h>
 #include <stdint.h>
 #include <algorithm>
+#include <string>
 #include <vector>
 
 #include <SDL_surface.h>
@@ -196,6 +198,7 @@ struct GroundLayer : public ViewportElement
 
 	void draw();
 	void drawInt();
+	FrameProfiler::Phase profilePhase() const { return FrameProfiler::PhaseTilemap; }
 
 	void onGeometryChange(const Scene::Geometry &geo);
 
@@ -223,6 +226,7 @@ struct ZLayer : public ViewportElement
 
 	void draw();
 	void drawInt();
+	FrameProfiler::Phase profilePhase() const { return FrameProfiler::PhaseTilemap; }
 
 	static int calculateZ(TilemapPrivate *p, int index);
 
@@ -252,6 +256,10 @@ struct TilemapPrivate
 	struct {
 		TEXFBO gl;
 
+		/* TileAtlasCache key of the bitmaps 'gl'
+		 * was built from (empty if not cacheable) */
+		std::string key;
+
 		Vec2i size;
 
 		/* Effective tileset height,
@@ -328,6 +336,8 @@ struct TilemapPrivate
 	sigslot::connection autotilesCon[autotileCount];
 	sigslot::connection mapDataCon;
 	sigslot::connection prioritiesCon;
+	sigslot::connection colorCon;
+	sigslot::connection toneCon;
 
 	/* Dispose watches */
 	sigslot::connection autotilesDispCon[autotileCount];
@@ -389,6 +399,7 @@ struct TilemapPrivate
 		prepareCon = shState->prepareDraw.connect
 		        (&TilemapPrivate::prepare, this);
 
+		updateColorToneCon();
 		updateFlashMapViewport();
 	}
 
@@ -399,7 +410,7 @@ struct TilemapPrivate
 		for (size_t i = 0; i < zlayersMax; ++i)
 			delete elem.zlayers[i];
 
-		shState->releaseAtlasTex(atlas.gl);
+		retireAtlas();
 
 		/* Destroy tile buffers */
 		GLMeta::vaoFini(tiles.vao);
@@ -415,10 +426,29 @@ struct TilemapPrivate
 		}
 		mapDataCon.disconnect();
 		prioritiesCon.disconnect();
+		colorCon.disconnect();
+		toneCon.disconnect();
 
 		prepareCon.disconnect();
 	}
 
+	/* All layers live in the same scene */
+	void notifyChange()
+	{
+		elem.ground->notifyChange();
+	}
+
+	void updateColorToneCon()
+	{
+		colorCon.disconnect();
+		colorCon = color->valueChanged.connect
+		        (&TilemapPrivate::notifyChange, this);
+
+		toneCon.disconnect();
+		toneCon = tone->valueChanged.connect
+		        (&TilemapPrivate::notifyChange, this);
+	}
+
 	void updateFlashMapViewport()
 	{
 		flashMap.setViewport(IntRect(viewpPos, Vec2i(viewpW, viewpH)));
@@ -488,11 +518,13 @@ struct TilemapPrivate
 	void invalidateAtlasSize()
 	{
 		atlasSizeDirty = true;
+		notifyChange();
 	}
 
 	void invalidateAtlasContents()
 	{
 		atlasDirty = true;
+		notifyChange();
 	}
 
 	void atlasContentsDisposal(int i)
@@ -507,11 +539,13 @@ struct TilemapPrivate
 	{
 		tileset = 0;
 		tilesetDispCon.disconnect();
+		notifyChange();
 	}
 
 	void invalidateBuffers()
 	{
 		buffersDirty = true;
+		notifyChange();
 	}
 
 	/* Checks for the minimum amount of data needed to display */
@@ -526,24 +560,53 @@ struct TilemapPrivate
 		return true;
 	}
 
-	/* Allocates correctly sized TexFBO for atlas */
+	/* Hands the atlas over to the atlas cache,
+	 * or back to the shared atlas texture */
+	void retireAtlas()
+	{
+		if (atlas.key.empty())
+			shState->releaseAtlasTex(atlas.gl);
+		else
+			shState->atlasCache().store(atlas.key, atlas.gl);
+
+		atlas.gl = TEXFBO();
+		atlas.key.clear();
+	}
+
+	/* Updates the atlas size; the texture itself is
+	 * acquired on the next build */
 	void allocateAtlas()
 	{
 		updateAtlasInfo();
 
-		/* Aquire atlas tex */
-		shState->releaseAtlasTex(atlas.gl);
-		shState->requestAtlasTex(atlas.size.x, atlas.size.y, atlas.gl);
-
 		atlasDirty = true;
 	}
 
-	/* Assembles atlas from tileset and autotile bitmaps */
+	/* Assembles atlas from tileset and autotile bitmaps,
+	 * unless the atlas cache already has it */
 	void buildAtlas()
 	{
         updateAutotileInfo();
         tileset->ensureNonAnimated();
 
+		Bitmap *sources[autotileCount+1];
+		sources[0] = tileset;
+		memcpy(&sources[1], autotiles, sizeof(autotiles));
+
+		const std::string key =
+			TileAtlasCache::makeKey("xp", sources, autotileCount+1);
+
+		retireAtlas();
+
+		if (shState->atlasCache().take(key, atlas.size.x, atlas.size.y, atlas.gl))
+		{
+			atlas.key = key;
+			return;
+		}
+
+		shState->requestAtlasTex(atlas.size.x, atlas.size.y, atlas.gl);
+		atlas.key = key;
+
 		TileAtlas::BlitVec blits = TileAtlas::calcBlits(atlas.efTilesetH, atlas.size);
 
 		/* Clear atlas */
@@ -1077,7 +1140,8 @@ struct TilemapPrivate
 			buffersDirty = false;
 		}
 
-		flashMap.prepare();
+		if (flashMap.prepare())
+			notifyChange();
 
 		if (zOrderDirty)
 		{
@@ -1273,11 +1337,15 @@ void Tilemap::update()
 	if (++p->flashAlphaIdx >= flashAlphaN)
 		p->flashAlphaIdx = 0;
 
+	if (p->flashMap.getData())
+		p->notifyChange();
+
 	/* Animate autotiles */
 	if (!p->tiles.animated)
 		return;
 
 	++p->tiles.aniIdx;
+	p->notifyChange();
 }
 
 Tilemap::Autotiles &Tilemap::getAutotiles()
@@ -1293,12 +1361,12 @@ DEF_ATTR_RD_SIMPLE(Tilemap, MapData, Table*, p->mapData)
 DEF_ATTR_RD_SIMPLE(Tilemap, FlashData, Table*, p->flashMap.getData())
 DEF_ATTR_RD_SIMPLE(Tilemap, Priorities, Table*, p->priorities)
 DEF_ATTR_RD_SIMPLE(Tilemap, Visible, bool, p->visible)
-DEF_ATTR_SIMPLE(Tilemap, Wrapping, bool, p->wrapping)
+DEF_ATTR_RD_SIMPLE(Tilemap, Wrapping, bool, p->wrapping)
 DEF_ATTR_RD_SIMPLE(Tilemap, OX, int, p->origin.x)
 DEF_ATTR_RD_SIMPLE(Tilemap, OY, int, p->origin.y)
 
 DEF_ATTR_RD_SIMPLE(Tilemap, BlendType, int, p->blendType)
-DEF_ATTR_SIMPLE(Tilemap, Opacity,   int,     p->opacity)
+DEF_ATTR_RD_SIMPLE(Tilemap, Opacity,   int,     p->opacity)
 DEF_ATTR_SIMPLE(Tilemap, Color,     Color&, *p->color)
 DEF_ATTR_SIMPLE(Tilemap, Tone,      Tone&,  *p->tone)
 
@@ -1309,6 +1377,8 @@ void Tilemap::setTileset(Bitmap *value)
 	if (p->tileset == value)
 		return;
 
+	p->notifyChange();
+
 	p->tileset = value;
 
 	p->tilesetDispCon.disconnect();
@@ -1338,6 +1408,8 @@ void Tilemap::setMapData(Table *value)
 	if (p->mapData == value)
 		return;
 
+	p->notifyChange();
+
 	p->mapData = value;
 
 	if (!value)
@@ -1363,6 +1435,8 @@ void Tilemap::setPriorities(Table *value)
 	if (p->priorities == value)
 		return;
 
+	p->notifyChange();
+
 	p->priorities = value;
 
 	if (!value)
@@ -1381,6 +1455,8 @@ void Tilemap::setVisible(bool value)
 	if (p->visible == value)
 		return;
 
+	p->notifyChange();
+
 	p->visible = value;
 
 	if (!p->tilemapReady)
@@ -1391,6 +1467,17 @@ void Tilemap::setVisible(bool value)
 		p->elem.zlayers[i]->setVisible(value);
 }
 
+void Tilemap::setWrapping(bool value)
+{
+	guardDisposed();
+
+	if (p->wrapping == value)
+		return;
+
+	p->wrapping = value;
+	p->notifyChange();
+}
+
 void Tilemap::setOX(int value)
 {
 	guardDisposed();
@@ -1398,6 +1485,8 @@ void Tilemap::setOX(int value)
 	if (p->origin.x == value)
 		return;
 
+	p->notifyChange();
+
 	p->origin.x = value;
 	p->mapViewportDirty = true;
 }
@@ -1409,15 +1498,30 @@ void Tilemap::setOY(int value)
 	if (p->origin.y == value)
 		return;
 
+	p->notifyChange();
+
 	p->origin.y = value;
 	p->zOrderDirty = true;
 	p->mapViewportDirty = true;
 }
 
+void Tilemap::setOpacity(int value)
+{
+	guardDisposed();
+
+	if (p->opacity == value)
+		return;
+
+	p->opacity = value;
+	p->notifyChange();
+}
+
 void Tilemap::setBlendType(int value)
 {
 	guardDisposed();
 
+	p->notifyChange();
+
 	switch (value)
 	{
 	default :
@@ -1437,6 +1541,8 @@ void Tilemap::initDynAttribs()
 {
 	p->color = new Color;
 	p->tone = new Tone;
+
+	p->updateColorToneCon();
 }
 
 void Tilemap::releaseResources()
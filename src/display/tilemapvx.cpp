@@ -24,6 +24,7 @@
 #include "util/debugwriter.h"
 
 #include "tileatlasvx.h"
+#include "tileatlascache.h"
 #include "etc-internal.h"
 #include "bitmap.h"
 #include "table.h"
@@ -36,7 +37,11 @@
 #include "quadarray.h"
 #include "shader.h"
 #include "tilemap-common.h"
+#include "global-ibo.h"
 
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
 #include <vector>
 #include "sigslot/signal.hpp"
 
@@ -53,6 +58,28 @@ static const uint8_t flashAlpha[] =
 
 static elementsN(flashAlpha);
 
+/* Quad slots every cell of the map viewport owns in the ring
+ * buffers, per layer; ground and above-player quads are kept
+ * in separate sections. Only single tiles (B ~ E, A5) can be
+ * drawn above the player, and shadows never are */
+static const size_t groundSlots[TileAtlasVX::LayerCount] =
+{
+	ATLASVX_CELL_QUADS, ATLASVX_CELL_QUADS, 1, ATLASVX_CELL_QUADS
+};
+
+static const size_t aboveSlots[TileAtlasVX::LayerCount] =
+{
+	1, 1, 0, 1
+};
+
+#define RING_SECTIONS (TileAtlasVX::LayerCount*2)
+
+struct QuadRange
+{
+	size_t first;
+	size_t count;
+};
+
 struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 {
 	Bitmap *bitmaps[BM_COUNT];
@@ -76,11 +103,38 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 
 	TEXFBO atlasHires;
 
+	/* TileAtlasCache key of the bitmaps the
+	 * atlas was built from (empty if not cacheable) */
+	std::string atlasKey;
+
 	size_t allocQuads;
 
 	size_t groundQuads;
 	size_t aboveQuads;
 
+	/* Ring mode: instead of packing the visible tiles tightly,
+	 * every cell owns a fixed run of slots (see groundSlots),
+	 * addressed by its map position modulo the map viewport size.
+	 * Scrolling by a few tiles then only has to read and upload
+	 * the rows/columns that came into view. Unused slots are left
+	 * zeroed and drawn as degenerate quads. Quads are positioned
+	 * in absolute map coordinates */
+	bool ringMode;
+	/* Map viewport the ring buffers currently hold */
+	IntRect ringMvp;
+	std::vector<SVertex> ringVert;
+	size_t sectionBase[RING_SECTIONS];
+	size_t sectionSlots[RING_SECTIONS];
+
+	/* Slots of the cell currently being read */
+	TileAtlasVX::Layer cellLayer;
+	SVertex *cellVert[RING_SECTIONS];
+	size_t cellFree[RING_SECTIONS];
+
+	/* What drawGround() / drawAbove() submit */
+	std::vector<QuadRange> groundRanges;
+	std::vector<QuadRange> aboveRanges;
+
 	uint16_t frameIdx;
 	Vec2 aniOffset;
 
@@ -113,6 +167,11 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 			p->drawFlashLayer();
 		}
 
+		FrameProfiler::Phase profilePhase() const
+		{
+			return FrameProfiler::PhaseTilemap;
+		}
+
 		ABOUT_TO_ACCESS_NOOP
 	};
 
@@ -125,6 +184,8 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	      allocQuads(0),
 	      groundQuads(0),
 	      aboveQuads(0),
+	      ringMode(false),
+	      cellLayer(TileAtlasVX::Layer0),
 	      frameIdx(0),
 	      flashAlphaIdx(0),
 	      atlasDirty(true),
@@ -134,14 +195,10 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	{
 		memset(bitmaps, 0, sizeof(bitmaps));
 
-		shState->requestAtlasTex(ATLASVX_W, ATLASVX_H, atlas);
-
-		if (shState->config().enableHires) {
-			double scalingFactor = shState->config().atlasScalingFactor;
-			int hiresWidth = (int)lround(scalingFactor * ATLASVX_W);
-			int hiresHeight = (int)lround(scalingFactor * ATLASVX_H);
-			shState->requestAtlasTex(hiresWidth, hiresHeight, atlasHires);
-			atlas.selfHires = &atlasHires;
+		for (int i = 0; i < TileAtlasVX::LayerCount; ++i)
+		{
+			sectionSlots[i] = groundSlots[i];
+			sectionSlots[TileAtlasVX::LayerCount+i] = aboveSlots[i];
 		}
 
 		vbo = VBO::gen();
@@ -162,10 +219,7 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		GLMeta::vaoFini(vao);
 		VBO::del(vbo);
 
-		shState->releaseAtlasTex(atlas);
-		if (shState->config().enableHires) {
-			shState->releaseAtlasTex(atlasHires);
-		}
+		retireAtlas();
 
 		prepareCon.disconnect();
 
@@ -182,6 +236,7 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	void invalidateAtlas()
 	{
 		atlasDirty = true;
+		notifyChange();
 	}
 
 	void atlasDisposal(int i)
@@ -195,10 +250,71 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	void invalidateBuffers()
 	{
 		buffersDirty = true;
+		notifyChange();
+	}
+
+	/* Hands the atlas over to the atlas cache,
+	 * or back to the shared atlas texture */
+	void retireAtlas()
+	{
+		const bool hires = shState->config().enableHires;
+
+		if (atlasKey.empty())
+		{
+			shState->releaseAtlasTex(atlas);
+			if (hires)
+				shState->releaseAtlasTex(atlasHires);
+		}
+		else
+		{
+			shState->atlasCache().store(atlasKey, atlas, hires ? &atlasHires : 0);
+		}
+
+		atlas = TEXFBO();
+		atlasHires = TEXFBO();
+		atlasKey.clear();
+	}
+
+	/* Puts an atlas in place, either one from the atlas cache
+	 * (returns true) or a new one to be built (returns false) */
+	bool acquireAtlas(const std::string &key)
+	{
+		const bool hires = shState->config().enableHires;
+		int hiresWidth = 0, hiresHeight = 0;
+
+		if (hires) {
+			double scalingFactor = shState->config().atlasScalingFactor;
+			hiresWidth = (int)lround(scalingFactor * ATLASVX_W);
+			hiresHeight = (int)lround(scalingFactor * ATLASVX_H);
+		}
+
+		atlasKey = key;
+
+		bool cached = shState->atlasCache().take(key, ATLASVX_W, ATLASVX_H,
+		                                          atlas, hires ? &atlasHires : 0);
+
+		if (!cached) {
+			shState->requestAtlasTex(ATLASVX_W, ATLASVX_H, atlas);
+			if (hires)
+				shState->requestAtlasTex(hiresWidth, hiresHeight, atlasHires);
+		}
+
+		if (hires)
+			atlas.selfHires = &atlasHires;
+
+		return cached;
 	}
 
 	void rebuildAtlas()
 	{
+		const std::string key =
+			TileAtlasCache::makeKey("vx", bitmaps, BM_COUNT);
+
+		retireAtlas();
+
+		if (acquireAtlas(key))
+			return;
+
 		TileAtlasVX::build(atlas, bitmaps);
 
 		if (shState->config().dumpAtlas)
@@ -238,9 +354,12 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 
 		if (newMvp != mapViewp)
 		{
+			/* A pure scroll is picked up by prepare() */
+			if (!ringMode || newMvp.size() != mapViewp.size())
+				buffersDirty = true;
+
 			mapViewp = newMvp;
 			flashMap.setViewport(newMvp);
-			buffersDirty = true;
 		}
 
 		dispPos = sceneGeo.rect.pos() - wrap(combOrigin, 32) - Vec2i(0, 32);
@@ -256,6 +375,28 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		if (!mapData)
 			return;
 
+		size_t cellQuads = 0;
+
+		for (size_t i = 0; i < RING_SECTIONS; ++i)
+			cellQuads += sectionSlots[i];
+
+		const size_t ringQuads = mapViewp.w * mapViewp.h * cellQuads;
+
+		/* Very large viewports can't address the fixed slots
+		 * with 16 bit indices (the limit is on the vertex
+		 * count); pack those tightly instead */
+		ringMode = ringQuads*4 < INDEX_T_MAX;
+
+		if (ringMode)
+			rebuildRing(ringQuads);
+		else
+			rebuildPacked();
+	}
+
+	void rebuildPacked()
+	{
+		ringVert.clear();
+
 		groundVert.clear();
 		aboveVert.clear();
 
@@ -280,6 +421,212 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		VBO::unbind();
 
 		shState->ensureQuadIBO(totalQuads);
+
+		groundRanges.clear();
+		aboveRanges.clear();
+
+		pushRange(groundRanges, 0, groundQuads);
+		pushRange(aboveRanges, groundQuads, aboveQuads);
+	}
+
+	/* First quad of the slots cell (px, py) owns in section 's';
+	 * rows are stored bottom to top (see TileAtlasVX::readTiles) */
+	size_t slotIndex(size_t s, int px, int py) const
+	{
+		const int w = mapViewp.w;
+		const int h = mapViewp.h;
+
+		return sectionBase[s] + ((h-1-py)*w + px) * sectionSlots[s];
+	}
+
+	void readCell(int x, int y)
+	{
+		const int px = wrap(x, mapViewp.w);
+		const int py = wrap(y, mapViewp.h);
+
+		for (size_t s = 0; s < RING_SECTIONS; ++s)
+		{
+			SVertex *vert = &ringVert[slotIndex(s, px, py)*4];
+
+			memset(vert, 0, sectionSlots[s]*4*sizeof(SVertex));
+			cellVert[s] = vert;
+			cellFree[s] = sectionSlots[s];
+		}
+
+		for (int l = 0; l < TileAtlasVX::LayerCount; ++l)
+		{
+			cellLayer = (TileAtlasVX::Layer) l;
+			TileAtlasVX::readCell(*this, *mapData, flags, x, y, cellLayer);
+		}
+	}
+
+	void uploadQuads(size_t first, size_t count)
+	{
+		if (count > 0)
+			VBO::uploadSubData(quadBytes(first), quadBytes(count), &ringVert[first*4]);
+	}
+
+	void uploadCell(int x, int y)
+	{
+		const int px = wrap(x, mapViewp.w);
+		const int py = wrap(y, mapViewp.h);
+
+		for (size_t s = 0; s < RING_SECTIONS; ++s)
+			uploadQuads(slotIndex(s, px, py), sectionSlots[s]);
+	}
+
+	void uploadRow(int y)
+	{
+		const int py = wrap(y, mapViewp.h);
+
+		for (size_t s = 0; s < RING_SECTIONS; ++s)
+			uploadQuads(slotIndex(s, 0, py), mapViewp.w * sectionSlots[s]);
+	}
+
+	void rebuildRing(size_t ringQuads)
+	{
+		size_t base = 0;
+
+		for (size_t s = 0; s < RING_SECTIONS; ++s)
+		{
+			sectionBase[s] = base;
+			base += mapViewp.w * mapViewp.h * sectionSlots[s];
+		}
+
+		groundVert.clear();
+		aboveVert.clear();
+		ringVert.resize(ringQuads*4);
+
+		for (int y = mapViewp.y; y < mapViewp.y+mapViewp.h; ++y)
+			for (int x = mapViewp.x; x < mapViewp.x+mapViewp.w; ++x)
+				readCell(x, y);
+
+		VBO::bind(vbo);
+
+		if (ringQuads > allocQuads)
+		{
+			VBO::allocEmpty(quadBytes(ringQuads), GL_DYNAMIC_DRAW);
+			allocQuads = ringQuads;
+		}
+
+		uploadQuads(0, ringQuads);
+
+		VBO::unbind();
+
+		shState->ensureQuadIBO(ringQuads);
+
+		ringMvp = mapViewp;
+		updateRingRanges();
+	}
+
+	/* Moves the ring over to the current map viewport, which
+	 * has the same size as the one it holds */
+	void scrollRing()
+	{
+		const int w = mapViewp.w;
+		const int h = mapViewp.h;
+		const Vec2i delta = mapViewp.pos() - ringMvp.pos();
+
+		if (abs(delta.x) >= w || abs(delta.y) >= h)
+		{
+			rebuildRing(ringVert.size() / 4);
+			return;
+		}
+
+		/* Rows that came into view */
+		int rowBegin = mapViewp.y;
+		int rowEnd = mapViewp.y;
+
+		if (delta.y > 0)
+			rowBegin = mapViewp.y + h - delta.y, rowEnd = mapViewp.y + h;
+		else if (delta.y < 0)
+			rowEnd = mapViewp.y - delta.y;
+
+		/* Columns that came into view */
+		int colBegin = mapViewp.x;
+		int colEnd = mapViewp.x;
+
+		if (delta.x > 0)
+			colBegin = mapViewp.x + w - delta.x, colEnd = mapViewp.x + w;
+		else if (delta.x < 0)
+			colEnd = mapViewp.x - delta.x;
+
+		VBO::bind(vbo);
+
+		for (int y = rowBegin; y < rowEnd; ++y)
+		{
+			for (int x = mapViewp.x; x < mapViewp.x+w; ++x)
+				readCell(x, y);
+
+			uploadRow(y);
+		}
+
+		for (int y = mapViewp.y; y < mapViewp.y+h; ++y)
+		{
+			if (y >= rowBegin && y < rowEnd)
+				continue;
+
+			for (int x = colBegin; x < colEnd; ++x)
+			{
+				readCell(x, y);
+				uploadCell(x, y);
+			}
+		}
+
+		VBO::unbind();
+
+		ringMvp = mapViewp;
+		updateRingRanges();
+	}
+
+	void pushRange(std::vector<QuadRange> &ranges, size_t first, size_t count)
+	{
+		if (count == 0)
+			return;
+
+		if (!ranges.empty() && ranges.back().first + ranges.back().count == first)
+		{
+			ranges.back().count += count;
+			return;
+		}
+
+		QuadRange range = { first, count };
+		ranges.push_back(range);
+	}
+
+	/* Each section has to be drawn from the bottom map row up,
+	 * which in the ring can start anywhere; split it there */
+	void updateRingRanges()
+	{
+		const int w = mapViewp.w;
+		const int h = mapViewp.h;
+		const size_t split = h-1 - wrap(mapViewp.y+h-1, h);
+
+		groundRanges.clear();
+		aboveRanges.clear();
+
+		for (size_t s = 0; s < RING_SECTIONS; ++s)
+		{
+			std::vector<QuadRange> &ranges =
+				s < TileAtlasVX::LayerCount ? groundRanges : aboveRanges;
+			const size_t rowQuads = w * sectionSlots[s];
+
+			pushRange(ranges, sectionBase[s] + split*rowQuads, (h-split)*rowQuads);
+			pushRange(ranges, sectionBase[s], split*rowQuads);
+		}
+	}
+
+	/* Where the buffer contents are translated to on screen */
+	Vec2i drawOffset() const
+	{
+		return ringMode ? dispPos - mapViewp.pos() * 32 : dispPos;
+	}
+
+	void drawRanges(const std::vector<QuadRange> &ranges)
+	{
+		for (size_t i = 0; i < ranges.size(); ++i)
+			gl.DrawElements(GL_TRIANGLES, ranges[i].count*6, _GL_INDEX_TYPE,
+			                (GLvoid*) (ranges[i].first*6*sizeof(index_t)));
 	}
 
 	void prepare()
@@ -304,8 +651,13 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 			rebuildBuffers();
 			buffersDirty = false;
 		}
+		else if (ringMode && ringMvp != mapViewp)
+		{
+			scrollRing();
+		}
 
-		flashMap.prepare();
+		if (flashMap.prepare())
+			notifyChange();
 	}
 
 	SVertex *allocVert(std::vector<SVertex> &vec, size_t count)
@@ -323,9 +675,14 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		drawFlashLayer();
 	}
 
+	FrameProfiler::Phase profilePhase() const
+	{
+		return FrameProfiler::PhaseTilemap;
+	}
+
 	void drawGround()
 	{
-		if (groundQuads == 0)
+		if (groundRanges.empty())
 			return;
 
 		ShaderBase *shader;
@@ -348,7 +705,7 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 
 		shader->setTexSize(Vec2i(atlas.width, atlas.height));
 		shader->applyViewportProj();
-		shader->setTranslation(dispPos);
+		shader->setTranslation(drawOffset());
 
 		if (atlas.selfHires != nullptr) {
 			TEX::bind(atlas.selfHires->tex);
@@ -358,21 +715,21 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		}
 		GLMeta::vaoBind(vao);
 
-		gl.DrawElements(GL_TRIANGLES, groundQuads*6, _GL_INDEX_TYPE, 0);
+		drawRanges(groundRanges);
 
 		GLMeta::vaoUnbind(vao);
 	}
 
 	void drawAbove()
 	{
-		if (aboveQuads == 0)
+		if (aboveRanges.empty())
 			return;
 
 		SimpleShader &shader = shState->shaders().simple;
 		shader.bind();
 		shader.setTexSize(Vec2i(atlas.width, atlas.height));
 		shader.applyViewportProj();
-		shader.setTranslation(dispPos);
+		shader.setTranslation(drawOffset());
 
 		if (atlas.selfHires != nullptr) {
 			TEX::bind(atlas.selfHires->tex);
@@ -382,8 +739,7 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		}
 		GLMeta::vaoBind(vao);
 
-		gl.DrawElements(GL_TRIANGLES, aboveQuads*6, _GL_INDEX_TYPE,
-		                (GLvoid*) (groundQuads*6*sizeof(index_t)));
+		drawRanges(aboveRanges);
 
 		GLMeta::vaoUnbind(vao);
 	}
@@ -410,6 +766,21 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	void onQuads(const FloatRect *t, const FloatRect *p,
 	             size_t n, bool overPlayer)
 	{
+		if (ringMode)
+		{
+			const size_t s = cellLayer + (overPlayer ? TileAtlasVX::LayerCount : 0);
+
+			n = std::min(n, cellFree[s]);
+
+			for (size_t i = 0; i < n; ++i)
+				Quad::setTexPosRect(&cellVert[s][i*4], t[i], p[i]);
+
+			cellVert[s] += n*4;
+			cellFree[s] -= n;
+
+			return;
+		}
+
 		SVertex *vert = allocVert(overPlayer ? aboveVert : groundVert, n*4);
 
 		for (size_t i = 0; i < n; ++i)
@@ -484,11 +855,20 @@ void TilemapVX::update()
 	uint8_t aniIdxA = aniIndicesA[p->frameIdx / 30];
 	uint8_t aniIdxC = aniIndicesC[p->frameIdx / 30];
 
-	p->aniOffset = Vec2(aniIdxA * 2 * 32, aniIdxC * 32);
+	const Vec2 aniOffset(aniIdxA * 2 * 32, aniIdxC * 32);
+
+	if (!(aniOffset == p->aniOffset))
+	{
+		p->aniOffset = aniOffset;
+		p->notifyChange();
+	}
 
 	/* Animate flash */
 	if (++p->flashAlphaIdx >= flashAlphaN)
 		p->flashAlphaIdx = 0;
+
+	if (p->flashMap.getData())
+		p->notifyChange();
 }
 
 TilemapVX::BitmapArray &TilemapVX::getBitmapArray()
@@ -533,6 +913,8 @@ void TilemapVX::setMapData(Table *value)
 	if (p->mapData == value)
 		return;
 
+	p->notifyChange();
+
 	p->mapData = value;
 	p->buffersDirty = true;
 
@@ -555,6 +937,8 @@ void TilemapVX::setFlags(Table *value)
 	if (p->flags == value)
 		return;
 
+	p->notifyChange();
+
 	p->flags = value;
 	p->buffersDirty = true;
 
@@ -578,6 +962,8 @@ void TilemapVX::setOX(int value)
 	if (p->origin.x == value)
 		return;
 
+	p->notifyChange();
+
 	p->origin.x = value;
 	p->mapViewportDirty = true;
 }
@@ -589,6 +975,8 @@ void TilemapVX::setOY(int value)
 	if (p->origin.y == value)
 		return;
 
+	p->notifyChange();
+
 	p->origin.y = value;
 	p->mapViewportDirty = true;
 }
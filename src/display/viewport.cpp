@@ -27,6 +27,9 @@
 #include "quad.h"
 #include "glstate.h"
 #include "graphics.h"
+#include "config.h"
+#include "shader.h"
+#include "texpool.h"
 
 #include <SDL_rect.h>
 
@@ -46,6 +49,14 @@ struct ViewportPrivate
 	IntRect screenRect;
 	int isOnScreen;
 
+	/* With 'cache' set, the elements are rendered into 'cacheTex'
+	 * and only re-rendered after one of them reported a change.
+	 * It has the size of the screen, so elements draw into it
+	 * exactly like they would onto the screen */
+	bool cache;
+	bool cacheDirty;
+	TEXFBO cacheTex;
+
 	EtcTemps tmp;
 
 	ViewportPrivate(int x, int y, int width, int height, Viewport *self)
@@ -53,7 +64,9 @@ struct ViewportPrivate
 	      rect(&tmp.rect),
 	      color(&tmp.color),
 	      tone(&tmp.tone),
-	      isOnScreen(false)
+	      isOnScreen(false),
+	      cache(false),
+	      cacheDirty(true)
 	{
 		rect->set(x, y, width, height);
 		updateRectCon();
@@ -62,6 +75,7 @@ struct ViewportPrivate
 	~ViewportPrivate()
 	{
 		rectCon.disconnect();
+		releaseCache();
 	}
 
 	void onRectChange()
@@ -97,6 +111,77 @@ struct ViewportPrivate
 
 		return (rectEffective && colorToneEffective && isOnScreen);
 	}
+
+	void releaseCache()
+	{
+		shState->texPool().release(cacheTex);
+		cacheTex = TEXFBO();
+		cacheDirty = true;
+	}
+
+	/* Makes sure 'cacheTex' matches the screen.
+	 * Returns false if the cache isn't in use */
+	bool prepareCache()
+	{
+		/* Hires rendering scales the screen buffers
+		 * behind the elements' backs; don't bother */
+		if (!cache || shState->config().enableHires)
+		{
+			if (cacheTex.tex != TEX::ID(0))
+				releaseCache();
+
+			return false;
+		}
+
+		if (cacheTex.width != screenRect.w || cacheTex.height != screenRect.h)
+		{
+			releaseCache();
+			cacheTex = shState->texPool().request(screenRect.w, screenRect.h);
+		}
+
+		return true;
+	}
+
+	void renderCache()
+	{
+		/* Animation frame advances arrive as bitmap changes */
+		if (!cacheDirty)
+			return;
+
+		const FBO::ID target = FBO::boundFramebufferID;
+
+		FBO::bind(cacheTex.fbo);
+
+		glState.clearColor.pushSet(Vec4());
+		FBO::clear();
+		glState.clearColor.pop();
+
+		self->Scene::composite();
+
+		FBO::bind(target);
+		cacheDirty = false;
+	}
+
+	void drawCache()
+	{
+		SimpleShader &shader = shState->shaders().simple;
+		shader.bind();
+		shader.applyViewportProj();
+		shader.setTranslation(Vec2i());
+		shader.setTexSize(Vec2i(cacheTex.width, cacheTex.height));
+
+		TEX::bind(cacheTex.tex);
+
+		const FloatRect area(rect->toIntRect());
+		Quad &quad = shState->gpQuad();
+		quad.setTexPosRect(area, area);
+
+		/* The elements were blended onto transparency, which
+		 * leaves the cache with premultiplied colors */
+		glState.blendMode.pushSet(BlendPremultiplied);
+		quad.draw();
+		glState.blendMode.pop();
+	}
 };
 
 Viewport::Viewport(int x, int y, int width, int height)
@@ -146,6 +231,7 @@ void Viewport::update()
 
 DEF_ATTR_RD_SIMPLE(Viewport, OX,   int,   geometry.orig.x)
 DEF_ATTR_RD_SIMPLE(Viewport, OY,   int,   geometry.orig.y)
+DEF_ATTR_RD_SIMPLE(Viewport, Cache, bool, p->cache)
 
 DEF_ATTR_SIMPLE(Viewport, Rect,  Rect&,  *p->rect)
 DEF_ATTR_SIMPLE(Viewport, Color, Color&, *p->color)
@@ -173,6 +259,19 @@ void Viewport::setOY(int value)
 	notifyGeometryChange();
 }
 
+void Viewport::setCache(bool value)
+{
+	guardDisposed();
+
+	if (p->cache == value)
+		return;
+
+	p->cache = value;
+
+	if (!value)
+		p->releaseCache();
+}
+
 void Viewport::initDynAttribs()
 {
 	p->rect = new Rect(*p->rect);
@@ -197,7 +296,15 @@ void Viewport::composite()
 	glState.scissorTest.pushSet(true);
 	glState.scissorBox.pushSet(p->rect->toIntRect());
 
-	Scene::composite();
+	if (p->prepareCache())
+	{
+		p->renderCache();
+		p->drawCache();
+	}
+	else
+	{
+		Scene::composite();
+	}
 
 	/* If any effects are visible, request parent Scene to
 	 * render them. */
@@ -221,6 +328,15 @@ void Viewport::onGeometryChange(const Geometry &geo)
 	p->recomputeOnScreen();
 }
 
+void Viewport::onContentChange()
+{
+	/* Elements may outlive a disposed viewport */
+	if (isDisposed())
+		return;
+
+	p->cacheDirty = true;
+}
+
 void Viewport::releaseResources()
 {
 	unlink();
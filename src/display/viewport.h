@@ -45,6 +45,10 @@ public:
 	DECL_ATTR( Color, Color& )
 	DECL_ATTR( Tone,  Tone&  )
 
+	/* Keep the contents in a texture that is only
+	 * re-rendered when an element in it changes */
+	DECL_ATTR( Cache, bool   )
+
 	void initDynAttribs();
 
 private:
@@ -53,7 +57,9 @@ private:
 
 	void composite();
 	void draw();
+	FrameProfiler::Phase profilePhase() const { return FrameProfiler::PhaseViewport; }
 	void onGeometryChange(const Geometry &);
+	void onContentChange();
 	bool isEffectiveViewport(Rect *&, Color *&, Tone *&) const;
 
 	void releaseResources();
@@ -32,6 +32,7 @@
 #include "quad.h"
 #include "quadarray.h"
 #include "texpool.h"
+#include "windowbasecache.h"
 #include "glstate.h"
 
 #include "sigslot/signal.hpp"
@@ -164,6 +165,10 @@ struct QuadChunk
  * BaseTex: If the window has an opacity <255, we have to prerender
  *   the base to a texture and draw that. Otherwise, we can draw the
  *   quad array directly to the screen.
+ *
+ * Both the base quad array and base texture only depend on the
+ *   windowskin, size, stretch mode and back opacity, and are shared
+ *   with every other window that agrees on those (see WindowBase).
  */
 
 struct WindowPrivate
@@ -172,6 +177,8 @@ struct WindowPrivate
 
 	Bitmap *contents;
 
+	sigslot::connection windowskinCon;
+	sigslot::connection contentsCon;
 	sigslot::connection windowskinDispCon;
 	sigslot::connection contentsDispCon;
 
@@ -192,18 +199,16 @@ struct WindowPrivate
 	NormValue backOpacity;
 	NormValue contentsOpacity;
 
+	/* Affected by: windowskin, size, stretch, back opacity */
 	bool baseVertDirty;
 	bool opacityDirty;
-	bool baseTexDirty;
 
-	ColorQuadArray baseQuadArray;
+	/* Null without windowskin */
+	WindowBase *base;
 
 	/* Used when opacity < 255 */
-	TEXFBO baseTex;
 	bool useBaseTex;
 
-	QuadChunk backgroundVert;
-
 	Quad baseTexQuad;
 
 	struct WindowControls : public ViewportElement
@@ -223,6 +228,11 @@ struct WindowPrivate
 			p->drawControls();
 		}
 
+		FrameProfiler::Phase profilePhase() const
+		{
+			return FrameProfiler::PhaseWindow;
+		}
+
 		void release()
 		{
 			unlink();
@@ -263,7 +273,8 @@ struct WindowPrivate
 	      contentsOpacity(255),
 	      baseVertDirty(true),
 	      opacityDirty(true),
-	      baseTexDirty(true),
+	      base(0),
+	      useBaseTex(false),
 	      controlsElement(this, viewport),
 	      cursorAniAlphaIdx(0),
 	      pauseAniAlphaIdx(0),
@@ -282,7 +293,7 @@ struct WindowPrivate
 
 	~WindowPrivate()
 	{
-		shState->texPool().release(baseTex);
+		shState->windowBaseCache().release(base);
 		cursorRectCon.disconnect();
 		prepareCon.disconnect();
 
@@ -293,18 +304,41 @@ struct WindowPrivate
 	void windowskinDisposal()
 	{
 		windowskin = 0;
+		windowskinCon.disconnect();
 		windowskinDispCon.disconnect();
+		baseVertDirty = true;
 	}
 
 	void contentsDisposal()
 	{
 		contents = 0;
+		contentsCon.disconnect();
 		contentsDispCon.disconnect();
 	}
 
+	/* Disposed while still shown */
+	void onWindowskinDisposed()
+	{
+		windowskinDisposal();
+		notifyChange();
+	}
+
+	void onContentsDisposed()
+	{
+		contentsDisposal();
+		notifyChange();
+	}
+
+	/* Base and controls share the scene */
+	void notifyChange()
+	{
+		controlsElement.notifyChange();
+	}
+
 	void markControlVertDirty()
 	{
 		controlsVertDirty = true;
+		notifyChange();
 	}
 
 	void refreshCursorRectCon()
@@ -314,7 +348,27 @@ struct WindowPrivate
 		        (&WindowPrivate::markControlVertDirty, this);
 	}
 
-	void buildBaseVert()
+	/* Swaps in the shared base matching the current state */
+	void acquireBase()
+	{
+		WindowBaseCache &cache = shState->windowBaseCache();
+
+		cache.release(base);
+		base = 0;
+
+		if (nullOrDisposed(windowskin))
+			return;
+
+		base = cache.acquire(windowskin, size, bgStretch, backOpacity);
+
+		if (!base->built)
+			buildBaseVert(*base);
+
+		FloatRect texRect = FloatRect(0, 0, size.x, size.y);
+		baseTexQuad.setTexPosRect(texRect, texRect);
+	}
+
+	void buildBaseVert(WindowBase &b)
 	{
 		int w = size.x;
 		int h = size.y;
@@ -338,12 +392,11 @@ struct WindowPrivate
 
 		/* Background */
 		if (bgStretch)
-			backgroundVert.count = 1;
+			b.bgCount = 1;
 		else
-			backgroundVert.count =
-			        TileQuads::twoDimCount(128, 128, bgRect.w, bgRect.h);
+			b.bgCount = TileQuads::twoDimCount(128, 128, bgRect.w, bgRect.h);
 
-		count += backgroundVert.count;
+		count += b.bgCount;
 
 		/* Borders (sides) */
 		count += TileQuads::oneDimCount(32, w-16) * 2;
@@ -353,11 +406,10 @@ struct WindowPrivate
 		count += 4;
 
 		/* Our vertex array */
-		baseQuadArray.resize(count);
-		Vertex *vert = baseQuadArray.vertices.data();
+		b.quads.resize(count);
+		Vertex *vert = b.quads.vertices.data();
 
 		int i = 0;
-		backgroundVert.vert = &vert[i];
 
 		/* Background */
 		if (bgStretch)
@@ -383,56 +435,30 @@ struct WindowPrivate
 		i += Quad::setTexPosRect(&vert[i*4], cornersSrc.bl, cornerRects.bl);
 		i += Quad::setTexPosRect(&vert[i*4], cornersSrc.br, cornerRects.br);
 
+		/* Background alpha is always applied unconditionally */
 		for (int j = 0; j < count*4; ++j)
-			vert[j].color = Vec4(1, 1, 1, 1);
-
-
-		FloatRect texRect = FloatRect(0, 0, size.x, size.y);
-		baseTexQuad.setTexPosRect(texRect, texRect);
-
-		opacityDirty = true;
-		baseTexDirty = true;
-	}
-
-	void updateBaseAlpha()
-	{
-		/* This is always applied unconditionally */
-		backgroundVert.setAlpha(backOpacity.norm);
+			vert[j].color = Vec4(1, 1, 1, j < b.bgCount*4 ? backOpacity.norm : 1);
 
-		baseTexQuad.setColor(Vec4(1, 1, 1, opacity.norm));
-
-		baseTexDirty = true;
+		b.quads.commit();
+		b.built = true;
 	}
 
 	void ensureBaseTexReady()
 	{
-		/* Make sure texture is big enough */
-		int newW = baseTex.width;
-		int newH = baseTex.height;
-		bool resizeNeeded = false;
-
-		if (size.x > baseTex.width)
-		{
-			newW = findNextPow2(size.x);
-			resizeNeeded = true;
-		}
-		if (size.y > baseTex.height)
-		{
-			newH = findNextPow2(size.y);
-			resizeNeeded = true;
-		}
-
-		if (!resizeNeeded)
+		/* The base size never changes, so this
+		 * only has to happen once */
+		if (base->tex.tex != TEX::ID(0))
 			return;
 
-		shState->texPool().release(baseTex);
-		baseTex = shState->texPool().request(newW, newH);
-
-		baseTexDirty = true;
+		base->tex = shState->texPool().request(findNextPow2(size.x),
+		                                       findNextPow2(size.y));
 	}
 
 	void redrawBaseTex()
 	{
+		TEXFBO &baseTex = base->tex;
+		ColorQuadArray &baseQuadArray = base->quads;
+
 		/* Discard old buffer */
 		TEX::bind(baseTex.tex);
 		TEX::allocEmpty(baseTex.width, baseTex.height);
@@ -459,13 +485,13 @@ struct WindowPrivate
 		 * Otherwise it would be mutliplied by the backgrounds 0 alpha */
 		glState.blend.pushSet(false);
 
-		baseQuadArray.draw(0, backgroundVert.count);
+		baseQuadArray.draw(0, base->bgCount);
 
 		/* Now draw the rest (ie. the frame) with blending */
 		glState.blend.pop();
 		glState.blendMode.pushSet(BlendNormal);
 
-		baseQuadArray.draw(backgroundVert.count, baseQuadArray.count()-backgroundVert.count);
+		baseQuadArray.draw(base->bgCount, baseQuadArray.count()-base->bgCount);
 
 		glState.clearColor.pop();
 		glState.blendMode.pop();
@@ -531,44 +557,36 @@ struct WindowPrivate
 		if (size.x <= 0 || size.y <= 0)
 			return;
 
-		bool updateBaseQuadArray = false;
-
 		if (baseVertDirty)
 		{
-			buildBaseVert();
+			acquireBase();
 			baseVertDirty = false;
-			updateBaseQuadArray = true;
 		}
 
 		if (opacityDirty)
 		{
-			updateBaseAlpha();
+			baseTexQuad.setColor(Vec4(1, 1, 1, opacity.norm));
 			opacityDirty = false;
-			updateBaseQuadArray = true;
 		}
 
-		if (updateBaseQuadArray)
-			baseQuadArray.commit();
+		if (!base)
+			return;
 
 		/* If opacity has effect, we must prerender to a texture
 		 * and then draw this texture instead of the quad array */
 		useBaseTex = opacity < 255;
 
-		if (useBaseTex)
+		if (useBaseTex && !base->texValid)
 		{
 			ensureBaseTexReady();
-
-			if (baseTexDirty)
-			{
-				redrawBaseTex();
-				baseTexDirty = false;
-			}
+			redrawBaseTex();
+			base->texValid = true;
 		}
 	}
 
 	void drawBase()
 	{
-		if (nullOrDisposed(windowskin))
+		if (nullOrDisposed(windowskin) || !base)
 			return;
 
 		if (size == Vec2i(0, 0))
@@ -581,9 +599,9 @@ struct WindowPrivate
 
 		if (useBaseTex)
 		{
-			shader.setTexSize(Vec2i(baseTex.width, baseTex.height));
+			shader.setTexSize(Vec2i(base->tex.width, base->tex.height));
 
-			TEX::bind(baseTex.tex);
+			TEX::bind(base->tex.tex);
 			baseTexQuad.draw();
 		}
 		else
@@ -591,7 +609,7 @@ struct WindowPrivate
 			windowskin->bindTex(shader);
 			TEX::setSmooth(true);
 
-			baseQuadArray.draw();
+			base->quads.draw();
 
 			TEX::setSmooth(false);
 		}
@@ -713,10 +731,14 @@ void Window::update()
 
 	p->updateControls();
 	p->stepAnimations();
+
+	/* Cursor blink and pause arrow animate every update */
+	if (p->active || p->pause)
+		notifyChange();
 }
 
-DEF_ATTR_SIMPLE(Window, X,          int,     p->position.x)
-DEF_ATTR_SIMPLE(Window, Y,          int,     p->position.y)
+DEF_SCENE_ATTR_SIMPLE(Window, X,          int,     p->position.x)
+DEF_SCENE_ATTR_SIMPLE(Window, Y,          int,     p->position.y)
 DEF_ATTR_SIMPLE(Window, CursorRect, Rect&,  *p->cursorRect)
 
 DEF_ATTR_RD_SIMPLE(Window, Windowskin,      Bitmap*, p->windowskin)
@@ -736,8 +758,12 @@ void Window::setWindowskin(Bitmap *value)
 {
 	guardDisposed();
 
+	notifyChange();
+
 	p->windowskin = value;
+	p->baseVertDirty = true;
 
+	p->windowskinCon.disconnect();
 	p->windowskinDispCon.disconnect();
 
 	if (nullOrDisposed(value))
@@ -748,7 +774,8 @@ void Window::setWindowskin(Bitmap *value)
 
 	value->ensureNonMega();
 	
-	p->windowskinDispCon = value->wasDisposed.connect(&WindowPrivate::windowskinDisposal, p);
+	p->windowskinCon = value->modified.connect(&WindowPrivate::notifyChange, p);
+	p->windowskinDispCon = value->wasDisposed.connect(&WindowPrivate::onWindowskinDisposed, p);
 }
 
 void Window::setContents(Bitmap *value)
@@ -758,9 +785,12 @@ void Window::setContents(Bitmap *value)
 	if (p->contents == value)
 		return;
 
+	notifyChange();
+
 	p->contents = value;
 	p->controlsVertDirty = true;
 
+	p->contentsCon.disconnect();
 	p->contentsDispCon.disconnect();
 
 	if (nullOrDisposed(value))
@@ -769,7 +799,8 @@ void Window::setContents(Bitmap *value)
 		return;
 	}
 
-	p->contentsDispCon = value->wasDisposed.connect(&WindowPrivate::contentsDisposal, p);
+	p->contentsCon = value->modified.connect(&WindowPrivate::notifyChange, p);
+	p->contentsDispCon = value->wasDisposed.connect(&WindowPrivate::onContentsDisposed, p);
 
 	value->ensureNonMega();
 
@@ -783,6 +814,8 @@ void Window::setStretch(bool value)
 	if (value == p->bgStretch)
 		return;
 
+	notifyChange();
+
 	p->bgStretch = value;
 	p->baseVertDirty = true;
 }
@@ -794,6 +827,8 @@ void Window::setActive(bool value)
 	if (p->active == value)
 		return;
 
+	notifyChange();
+
 	p->active = value;
 	p->cursorAniAlphaIdx = 0;
 }
@@ -805,6 +840,8 @@ void Window::setPause(bool value)
 	if (p->pause == value)
 		return;
 
+	notifyChange();
+
 	p->pause = value;
 	p->pauseAniAlphaIdx = 0;
 	p->pauseAniQuadIdx = 0;
@@ -818,6 +855,8 @@ void Window::setWidth(int value)
 	if (p->size.x == value)
 		return;
 
+	notifyChange();
+
 	p->size.x = value;
 	p->baseVertDirty = true;
 }
@@ -829,6 +868,8 @@ void Window::setHeight(int value)
 	if (p->size.y == value)
 		return;
 
+	notifyChange();
+
 	p->size.y = value;
 	p->baseVertDirty = true;
 }
@@ -840,6 +881,8 @@ void Window::setOX(int value)
 	if (p->contentsOffset.x == value)
 		return;
 
+	notifyChange();
+
 	p->contentsOffset.x = value;
 	p->controlsVertDirty = true;
 }
@@ -851,6 +894,8 @@ void Window::setOY(int value)
 	if (p->contentsOffset.y == value)
 		return;
 
+	notifyChange();
+
 	p->contentsOffset.y = value;
 	p->controlsVertDirty = true;
 }
@@ -862,6 +907,8 @@ void Window::setOpacity(int value)
 	if (p->opacity == value)
 		return;
 
+	notifyChange();
+
 	p->opacity = value;
 	p->opacityDirty = true;
 }
@@ -873,8 +920,10 @@ void Window::setBackOpacity(int value)
 	if (p->backOpacity == value)
 		return;
 
+	notifyChange();
+
 	p->backOpacity = value;
-	p->opacityDirty = true;
+	p->baseVertDirty = true;
 }
 
 void Window::setContentsOpacity(int value)
@@ -884,6 +933,8 @@ void Window::setContentsOpacity(int value)
 	if (p->contentsOpacity == value)
 		return;
 
+	notifyChange();
+
 	p->contentsOpacity = value;
 	p->contentsQuad.setColor(Vec4(1, 1, 1, p->contentsOpacity.norm));
 }
@@ -62,6 +62,7 @@ private:
 	WindowPrivate *p;
 
 	void draw();
+	FrameProfiler::Phase profilePhase() const { return FrameProfiler::PhaseWindow; }
 	void onGeometryChange(const Scene::Geometry &);
 	void setZ(int value);
 	void setVisible(bool value);
@@ -0,0 +1,241 @@
+/*
+** windowbasecache.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "windowbasecache.h"
+
+#include "bitmap.h"
+#include "sharedstate.h"
+#include "texpool.h"
+
+#include "sigslot/signal.hpp"
+
+#include <limits.h>
+#include <map>
+#include <tuple>
+
+/* Unused bases kept before the least recently used goes */
+#define MAX_IDLE_BASES 32
+
+typedef std::tuple<Bitmap*, int, int, bool, int> BaseKey;
+
+struct SkinWatch
+{
+	int bases;
+
+	sigslot::connection modifiedCon;
+	sigslot::connection disposedCon;
+
+	SkinWatch()
+	    : bases(0)
+	{}
+};
+
+struct WindowBaseCachePrivate
+{
+	/* Ordered by windowskin first, so all bases of
+	 * one skin form a contiguous range */
+	std::map<BaseKey, WindowBase*> bases;
+
+	/* Unreferenced bases, most recently released first */
+	std::list<WindowBase*> idle;
+
+	/* Bases whose windowskin is gone, but that are still in use */
+	std::list<WindowBase*> detached;
+
+	std::map<Bitmap*, SkinWatch> skins;
+
+	static BaseKey keyOf(const WindowBase *base)
+	{
+		return BaseKey(base->skin, base->size.x, base->size.y,
+		               base->stretch, base->backOpacity);
+	}
+
+	std::map<BaseKey, WindowBase*>::iterator skinBegin(Bitmap *skin)
+	{
+		return bases.lower_bound(BaseKey(skin, INT_MIN, INT_MIN, false, INT_MIN));
+	}
+
+	void destroy(WindowBase *base)
+	{
+		shState->texPool().release(base->tex);
+		delete base;
+	}
+
+	void watchSkin(Bitmap *skin)
+	{
+		SkinWatch &watch = skins[skin];
+
+		if (watch.bases++ > 0)
+			return;
+
+		watch.modifiedCon = skin->modified.connect
+			([this, skin] { skinModified(skin); });
+		watch.disposedCon = skin->wasDisposed.connect
+			([this, skin] { skinDisposed(skin); });
+	}
+
+	void unwatchSkin(Bitmap *skin)
+	{
+		std::map<Bitmap*, SkinWatch>::iterator iter = skins.find(skin);
+
+		if (iter == skins.end() || --iter->second.bases > 0)
+			return;
+
+		iter->second.modifiedCon.disconnect();
+		iter->second.disposedCon.disconnect();
+		skins.erase(iter);
+	}
+
+	void evictIdle()
+	{
+		WindowBase *base = idle.back();
+		idle.pop_back();
+
+		bases.erase(keyOf(base));
+		unwatchSkin(base->skin);
+		destroy(base);
+	}
+
+	void skinModified(Bitmap *skin)
+	{
+		std::map<BaseKey, WindowBase*>::iterator iter;
+
+		for (iter = skinBegin(skin);
+		     iter != bases.end() && std::get<0>(iter->first) == skin; ++iter)
+			iter->second->texValid = false;
+	}
+
+	void skinDisposed(Bitmap *skin)
+	{
+		std::map<BaseKey, WindowBase*>::iterator iter = skinBegin(skin);
+
+		while (iter != bases.end() && std::get<0>(iter->first) == skin)
+		{
+			WindowBase *base = iter->second;
+			bases.erase(iter++);
+
+			if (base->refCount > 0)
+			{
+				base->detached = true;
+				detached.push_front(base);
+				base->idleIter = detached.begin();
+				continue;
+			}
+
+			idle.erase(base->idleIter);
+			destroy(base);
+		}
+
+		std::map<Bitmap*, SkinWatch>::iterator watch = skins.find(skin);
+
+		if (watch == skins.end())
+			return;
+
+		watch->second.modifiedCon.disconnect();
+		watch->second.disposedCon.disconnect();
+		skins.erase(watch);
+	}
+};
+
+WindowBaseCache::WindowBaseCache()
+{
+	p = new WindowBaseCachePrivate;
+}
+
+WindowBaseCache::~WindowBaseCache()
+{
+	std::map<BaseKey, WindowBase*>::iterator iter;
+
+	for (iter = p->bases.begin(); iter != p->bases.end(); ++iter)
+	{
+		TEXFBO::fini(iter->second->tex);
+		delete iter->second;
+	}
+
+	/* Windows still holding on to these never got to release them */
+	std::list<WindowBase*>::iterator det;
+
+	for (det = p->detached.begin(); det != p->detached.end(); ++det)
+	{
+		TEXFBO::fini((*det)->tex);
+		delete *det;
+	}
+
+	std::map<Bitmap*, SkinWatch>::iterator watch;
+
+	for (watch = p->skins.begin(); watch != p->skins.end(); ++watch)
+	{
+		watch->second.modifiedCon.disconnect();
+		watch->second.disposedCon.disconnect();
+	}
+
+	delete p;
+}
+
+WindowBase *WindowBaseCache::acquire(Bitmap *skin, const Vec2i &size,
+                                     bool stretch, int backOpacity)
+{
+	const BaseKey key(skin, size.x, size.y, stretch, backOpacity);
+
+	std::map<BaseKey, WindowBase*>::iterator iter = p->bases.find(key);
+
+	if (iter != p->bases.end())
+	{
+		WindowBase *base = iter->second;
+
+		if (base->refCount++ == 0)
+			p->idle.erase(base->idleIter);
+
+		return base;
+	}
+
+	WindowBase *base = new WindowBase;
+	base->skin = skin;
+	base->size = size;
+	base->stretch = stretch;
+	base->backOpacity = backOpacity;
+	base->refCount = 1;
+
+	p->bases.insert(std::make_pair(key, base));
+	p->watchSkin(skin);
+
+	return base;
+}
+
+void WindowBaseCache::release(WindowBase *base)
+{
+	if (!base)
+		return;
+
+	if (--base->refCount > 0)
+		return;
+
+	if (base->detached)
+	{
+		p->detached.erase(base->idleIter);
+		p->destroy(base);
+		return;
+	}
+
+	p->idle.push_front(base);
+	base->idleIter = p->idle.begin();
+
+	if (p->idle.size() > MAX_IDLE_BASES)
+		p->evictIdle();
+}
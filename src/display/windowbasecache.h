@@ -0,0 +1,99 @@
+/*
+** windowbasecache.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WINDOWBASECACHE_H
+#define WINDOWBASECACHE_H
+
+#include "quadarray.h"
+#include "gl-util.h"
+#include "etc-internal.h"
+
+#include <list>
+
+class Bitmap;
+struct WindowBaseCachePrivate;
+
+/* The base (background and frame) of a Window, shared by all
+ * windows with the same windowskin, size, stretch mode and
+ * back opacity. The vertex data is filled in by the first
+ * window to acquire it; the prerendered texture is only
+ * drawn once some window actually needs it (opacity < 255) */
+struct WindowBase
+{
+	/* Background quads first, then the frame */
+	ColorQuadArray quads;
+	int bgCount;
+	bool built;
+
+	TEXFBO tex;
+	/* Cleared when the windowskin is modified */
+	bool texValid;
+
+	WindowBase()
+	    : bgCount(0),
+	      built(false),
+	      texValid(false),
+	      skin(0),
+	      stretch(false),
+	      backOpacity(0),
+	      refCount(0),
+	      detached(false)
+	{}
+
+private:
+	friend class WindowBaseCache;
+	friend struct WindowBaseCachePrivate;
+
+	/* Cache key */
+	Bitmap *skin;
+	Vec2i size;
+	bool stretch;
+	int backOpacity;
+
+	int refCount;
+	/* Windowskin was disposed while in use; the
+	 * base is deleted with its last reference */
+	bool detached;
+	/* Position in the idle list, or the detached
+	 * list while 'detached' is set */
+	std::list<WindowBase*>::iterator idleIter;
+};
+
+/* Unused bases are kept around (up to a fixed count) so windows
+ * that are closed and reopened, eg. with menus, don't have to
+ * rebuild theirs. Everything built from a windowskin is dropped
+ * when it is disposed */
+class WindowBaseCache
+{
+public:
+	WindowBaseCache();
+	~WindowBaseCache();
+
+	/* Each acquire() must be paired with a release() */
+	WindowBase *acquire(Bitmap *skin, const Vec2i &size,
+	                    bool stretch, int backOpacity);
+
+	/* Null is ignored */
+	void release(WindowBase *base);
+
+private:
+	WindowBaseCachePrivate *p;
+};
+
+#endif // WINDOWBASECACHE_H
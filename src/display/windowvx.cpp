@@ -150,10 +150,14 @@ static elementsN(pauseQuad);
 
 struct WindowVXPrivate
 {
+	WindowVX *self;
+
 	Bitmap *windowskin;
 
 	Bitmap *contents;
 	
+	sigslot::connection windowskinCon;
+	sigslot::connection contentsCon;
 	sigslot::connection windowskinDispCon;
 	sigslot::connection contentsDispCon;
 
@@ -224,8 +228,9 @@ struct WindowVXPrivate
 
 	Vec2i sceneOffset;
 
-	WindowVXPrivate(int x, int y, int w, int h)
-	    : windowskin(0),
+	WindowVXPrivate(WindowVX *self, int x, int y, int w, int h)
+	    : self(self),
+	      windowskin(0),
 	      contents(0),
 	      cursorRect(&tmp.rect),
 	      active(true),
@@ -289,23 +294,45 @@ struct WindowVXPrivate
 	void windowskinDisposal()
 	{
 		windowskin = 0;
+		windowskinCon.disconnect();
 		windowskinDispCon.disconnect();
 	}
 
 	void contentsDisposal()
 	{
 		contents = 0;
+		contentsCon.disconnect();
 		contentsDispCon.disconnect();
 	}
 
+	/* Disposed while still shown */
+	void onWindowskinDisposed()
+	{
+		windowskinDisposal();
+		notifyChange();
+	}
+
+	void onContentsDisposed()
+	{
+		contentsDisposal();
+		notifyChange();
+	}
+
+	void notifyChange()
+	{
+		self->notifyChange();
+	}
+
 	void invalidateCursorVert()
 	{
 		cursorVertDirty = true;
+		notifyChange();
 	}
 
 	void invalidateBaseTex()
 	{
 		base.texDirty = true;
+		notifyChange();
 	}
 
 	void refreshCursorRectCon()
@@ -835,14 +862,14 @@ struct WindowVXPrivate
 WindowVX::WindowVX(Viewport *viewport)
     : ViewportElement(viewport, DEF_Z, DEF_SPRITE_Y)
 {
-	p = new WindowVXPrivate(0, 0, 0, 0);
+	p = new WindowVXPrivate(this, 0, 0, 0, 0);
 	onGeometryChange(scene->getGeometry());
 }
 
 WindowVX::WindowVX(int x, int y, int width, int height)
     : ViewportElement(0, DEF_Z, DEF_SPRITE_Y)
 {
-	p = new WindowVXPrivate(x, y, width, height);
+	p = new WindowVXPrivate(this, x, y, width, height);
 	onGeometryChange(scene->getGeometry());
 }
 
@@ -859,12 +886,18 @@ void WindowVX::update()
 
 	p->updatePauseQuad();
 	p->updateCursorAlpha();
+
+	/* Cursor blink and pause arrow animate every update */
+	if (p->active || p->pause)
+		notifyChange();
 }
 
 void WindowVX::move(int x, int y, int width, int height)
 {
 	guardDisposed();
 
+	notifyChange();
+
 	p->width = width;
 	p->height = height;
 
@@ -896,8 +929,8 @@ bool WindowVX::isClosed() const
 	return p->openness == 0;
 }
 
-DEF_ATTR_SIMPLE(WindowVX, X,          int,     p->geo.x)
-DEF_ATTR_SIMPLE(WindowVX, Y,          int,     p->geo.y)
+DEF_SCENE_ATTR_SIMPLE(WindowVX, X,          int,     p->geo.x)
+DEF_SCENE_ATTR_SIMPLE(WindowVX, Y,          int,     p->geo.y)
 DEF_ATTR_SIMPLE(WindowVX, CursorRect, Rect&,  *p->cursorRect)
 DEF_ATTR_SIMPLE(WindowVX, Tone,       Tone&,  *p->tone)
 
@@ -924,9 +957,12 @@ void WindowVX::setWindowskin(Bitmap *value)
 	if (p->windowskin == value)
 		return;
 
+	notifyChange();
+
 	p->windowskin = value;
 	p->base.texDirty = true;
 
+	p->windowskinCon.disconnect();
 	p->windowskinDispCon.disconnect();
 
 	if (nullOrDisposed(value))
@@ -935,7 +971,8 @@ void WindowVX::setWindowskin(Bitmap *value)
 		return;
 	}
 
-	p->windowskinDispCon = value->wasDisposed.connect(&WindowVXPrivate::windowskinDisposal, p);
+	p->windowskinCon = value->modified.connect(&WindowVXPrivate::notifyChange, p);
+	p->windowskinDispCon = value->wasDisposed.connect(&WindowVXPrivate::onWindowskinDisposed, p);
 }
 
 void WindowVX::setContents(Bitmap *value)
@@ -945,8 +982,11 @@ void WindowVX::setContents(Bitmap *value)
 	if (p->contents == value)
 		return;
 
+	notifyChange();
+
 	p->contents = value;
 
+	p->contentsCon.disconnect();
 	p->contentsDispCon.disconnect();
 
 	if (nullOrDisposed(value))
@@ -955,7 +995,8 @@ void WindowVX::setContents(Bitmap *value)
 		return;
 	}
 
-	p->contentsDispCon = value->wasDisposed.connect(&WindowVXPrivate::contentsDisposal, p);
+	p->contentsCon = value->modified.connect(&WindowVXPrivate::notifyChange, p);
+	p->contentsDispCon = value->wasDisposed.connect(&WindowVXPrivate::onContentsDisposed, p);
 
 	FloatRect rect = p->contents->rect();
 	p->contentsQuad.setTexPosRect(rect, rect);
@@ -969,6 +1010,8 @@ void WindowVX::setActive(bool value)
 	if (p->active == value)
 		return;
 
+	notifyChange();
+
 	p->active = value;
 	p->cursorAlphaIdx = cursorAlphaResetIdx;
 	p->updateCursorAlpha();
@@ -981,6 +1024,8 @@ void WindowVX::setArrowsVisible(bool value)
 	if (p->arrowsVisible == value)
 		return;
 
+	notifyChange();
+
 	p->arrowsVisible = value;
 	p->ctrlVertDirty = true;
 }
@@ -992,6 +1037,8 @@ void WindowVX::setPause(bool value)
 	if (p->pause == value)
 		return;
 
+	notifyChange();
+
 	p->pause = value;
 	p->pauseAlphaIdx = 0;
 	p->pauseQuadIdx = 0;
@@ -1005,6 +1052,8 @@ void WindowVX::setWidth(int value)
 	if (p->width == value)
 		return;
 
+	notifyChange();
+
 	p->width = value;
 	p->geo.w = std::max(0, value);
 	p->base.vertDirty = true;
@@ -1021,6 +1070,8 @@ void WindowVX::setHeight(int value)
 	if (p->height == value)
 		return;
 
+	notifyChange();
+
 	p->height = value;
 	p->geo.h = std::max(0, value);
 	p->base.vertDirty = true;
@@ -1037,6 +1088,8 @@ void WindowVX::setOX(int value)
 	if (p->contentsOff.x == value)
 		return;
 
+	notifyChange();
+
 	p->contentsOff.x = value;
 	p->ctrlVertDirty = true;
 }
@@ -1048,6 +1101,8 @@ void WindowVX::setOY(int value)
 	if (p->contentsOff.y == value)
 		return;
 
+	notifyChange();
+
 	p->contentsOff.y = value;
 	p->ctrlVertDirty = true;
 }
@@ -1059,6 +1114,8 @@ void WindowVX::setPadding(int value)
 	if (p->padding == value)
 		return;
 
+	notifyChange();
+
 	p->padding = value;
 	p->paddingBottom = value;
 	p->clipRectDirty = true;
@@ -1071,6 +1128,8 @@ void WindowVX::setPaddingBottom(int value)
 	if (p->paddingBottom == value)
 		return;
 
+	notifyChange();
+
 	p->paddingBottom = value;
 	p->clipRectDirty = true;
 }
@@ -1082,6 +1141,8 @@ void WindowVX::setOpacity(int value)
 	if (p->opacity == value)
 		return;
 
+	notifyChange();
+
 	p->opacity = value;
 	p->base.quad.setColor(Vec4(1, 1, 1, p->opacity.norm));
 }
@@ -1093,6 +1154,8 @@ void WindowVX::setBackOpacity(int value)
 	if (p->backOpacity == value)
 		return;
 
+	notifyChange();
+
 	p->backOpacity = value;
 	p->base.texDirty = true;
 }
@@ -1104,6 +1167,8 @@ void WindowVX::setContentsOpacity(int value)
 	if (p->contentsOpacity == value)
 		return;
 
+	notifyChange();
+
 	p->contentsOpacity = value;
 	p->contentsQuad.setColor(Vec4(1, 1, 1, p->contentsOpacity.norm));
 }
@@ -1115,6 +1180,8 @@ void WindowVX::setOpenness(int value)
 	if (p->openness == value)
 		return;
 
+	notifyChange();
+
 	p->openness = value;
 	p->updateBaseQuad();
 }
@@ -72,6 +72,7 @@ private:
 	WindowVXPrivate *p;
 
 	void draw();
+	FrameProfiler::Phase profilePhase() const { return FrameProfiler::PhaseWindow; }
 	void onGeometryChange(const Scene::Geometry &);
 
 	void releaseResources();
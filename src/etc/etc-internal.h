@@ -220,6 +220,17 @@ struct IntRect : SDL_Rect
 		        x+w >= o.x+o.w &&
 		        y+h >= o.y+o.h);
 	}
+
+	/* Empty (zero size) if the two don't overlap */
+	IntRect intersected(const IntRect &o) const
+	{
+		int x1 = std::max(x, o.x);
+		int y1 = std::max(y, o.y);
+		int x2 = std::min(x+w, o.x+o.w);
+		int y2 = std::min(y+h, o.y+o.h);
+
+		return IntRect(x1, y1, std::max(x2-x1, 0), std::max(y2-y1, 0));
+	}
 };
 
 struct StaticRect { float x, y, w, h; };
@@ -22,6 +22,7 @@
 #include "etc.h"
 
 #include "serial-util.h"
+#include "scene.h"
 #include "exception.h"
 
 #include <SDL_types.h>
@@ -54,47 +55,84 @@ bool Color::operator==(const Color &o) const
 
 const Color &Color::operator=(const Color &o)
 {
+	if (*this == o)
+		return o;
+
+	SceneRevision::bump();
+
 	red   = o.red;
 	green = o.green;
 	blue  = o.blue;
 	alpha = o.alpha;
 	norm  = o.norm;
 
+	valueChanged();
+
 	return o;
 }
 
 void Color::set(double red, double green, double blue, double alpha)
 {
+	if (*this == Color(red, green, blue, alpha))
+		return;
+
+	SceneRevision::bump();
+
 	this->red   = red;
 	this->green = green;
 	this->blue  = blue;
 	this->alpha = alpha;
 
 	updateInternal();
+	valueChanged();
 }
 
 void Color::setRed(double value)
 {
+	if (red == value)
+		return;
+
+	SceneRevision::bump();
+
 	red = value;
 	norm.x = clamp<double>(value, 0, 255) / 255;
+	valueChanged();
 }
 
 void Color::setGreen(double value)
 {
+	if (green == value)
+		return;
+
+	SceneRevision::bump();
+
 	green = value;
 	norm.y = clamp<double>(value, 0, 255) / 255;
+	valueChanged();
 }
 
 void Color::setBlue(double value)
 {
+	if (blue == value)
+		return;
+
+	SceneRevision::bump();
+
 	blue = value;
 	norm.z = clamp<double>(value, 0, 255) / 255;
+	valueChanged();
 }
 
 void Color::setAlpha(double value)
 {
+	if (alpha == value)
+		return;
+
+	SceneRevision::bump();
+
 	alpha = value;
 	norm.w = clamp<double>(value, 0, 255) / 255;
+	valueChanged();
 }
 
 /* Serializable */
@@ -176,6 +214,11 @@ bool Tone::operator==(const Tone &o) const
 
 void Tone::set(double red, double green, double blue, double gray)
 {
+	if (*this == Tone(red, green, blue, gray))
+		return;
+
+	SceneRevision::bump();
+
 	this->red   = red;
 	this->green = green;
 	this->blue  = blue;
@@ -187,6 +230,9 @@ void Tone::set(double red, double green, double blue, double gray)
 
 const Tone& Tone::operator=(const Tone &o)
 {
+	if (!(*this == o))
+		SceneRevision::bump();
+
 	red   = o.red;
 	green = o.green;
 	blue  = o.blue;
@@ -200,6 +246,11 @@ const Tone& Tone::operator=(const Tone &o)
 
 void Tone::setRed(double value)
 {
+	if (red == value)
+		return;
+
+	SceneRevision::bump();
+
 	red = value;
 	norm.x = (float) clamp<double>(value, -255, 255) / 255;
 
@@ -208,6 +259,11 @@ void Tone::setRed(double value)
 
 void Tone::setGreen(double value)
 {
+	if (green == value)
+		return;
+
+	SceneRevision::bump();
+
 	green = value;
 	norm.y = (float) clamp<double>(value, -255, 255) / 255;
 
@@ -216,6 +272,11 @@ void Tone::setGreen(double value)
 
 void Tone::setBlue(double value)
 {
+	if (blue == value)
+		return;
+
+	SceneRevision::bump();
+
 	blue = value;
 	norm.z = (float) clamp<double>(value, -255, 255) / 255;
 
@@ -224,6 +285,11 @@ void Tone::setBlue(double value)
 
 void Tone::setGray(double value)
 {
+	if (gray == value)
+		return;
+
+	SceneRevision::bump();
+
 	gray = value;
 	norm.w = (float) clamp<double>(value, 0, 255) / 255;
 
@@ -312,11 +378,15 @@ void Rect::set(int x, int y, int w, int h)
 	this->y = y;
 	width = w;
 	height = h;
+	SceneRevision::bump();
 	valueChanged();
 }
 
 const Rect &Rect::operator=(const Rect &o)
 {
+	if (!(*this == o))
+		SceneRevision::bump();
+
 	x      = o.x;
 	y      = o.y;
 	width  = o.width;
@@ -333,6 +403,7 @@ void Rect::empty()
 		return;
 
 	x = y = width = height = 0;
+	SceneRevision::bump();
 	valueChanged();
 }
 
@@ -347,6 +418,7 @@ void Rect::setX(int value)
 		return;
 
 	x = value;
+	SceneRevision::bump();
 	valueChanged();
 }
 
@@ -356,6 +428,7 @@ void Rect::setY(int value)
 		return;
 
 	y = value;
+	SceneRevision::bump();
 	valueChanged();
 }
 
@@ -365,6 +438,7 @@ void Rect::setWidth(int value)
 		return;
 
 	width = value;
+	SceneRevision::bump();
 	valueChanged();
 }
 
@@ -374,6 +448,7 @@ void Rect::setHeight(int value)
 		return;
 
 	height = value;
+	SceneRevision::bump();
 	valueChanged();
 }
 
@@ -31,6 +31,7 @@ struct SDL_Color;
 
 enum BlendType
 {
+	BlendPremultiplied = -2,
 	BlendKeepDestAlpha = -1,
 
 	BlendNormal = 0,
@@ -89,6 +90,8 @@ struct Color : public Serializable
 
 	/* Normalized (0.0 ~ 1.0) */
 	Vec4 norm;
+
+	sigslot::signal<> valueChanged;
 };
 
 struct Tone : public Serializable
@@ -89,6 +89,121 @@ void Table::resize(int x)
 	resize(x, ys, zs);
 }
 
+/* Clip a span starting at 'pos' with length 'len'
+ * against [0, size). Returns false if nothing is left */
+static bool clipSpan(int &pos, int &len, int size)
+{
+	if (pos < 0)
+	{
+		len += pos;
+		pos = 0;
+	}
+
+	len = std::min(len, size - pos);
+
+	return len > 0;
+}
+
+/* Same as above, but for a source/destination pair
+ * sharing the same length */
+static bool clipSpan(int &src, int &dst, int &len, int srcSize, int dstSize)
+{
+	if (src < 0)
+	{
+		len += src;
+		dst -= src;
+		src = 0;
+	}
+
+	if (dst < 0)
+	{
+		len += dst;
+		src -= dst;
+		dst = 0;
+	}
+
+	len = std::min(len, std::min(srcSize - src, dstSize - dst));
+
+	return len > 0;
+}
+
+void Table::fill(int16_t value, int x, int y, int z,
+                 int width, int height, int depth)
+{
+	if (!clipSpan(x, width, xs)
+	||  !clipSpan(y, height, ys)
+	||  !clipSpan(z, depth, zs))
+	{
+		return;
+	}
+
+	for (int k = z; k < z + depth; ++k)
+		for (int j = y; j < y + height; ++j)
+			std::fill_n(&at(x, j, k), width, value);
+
+	modified();
+}
+
+void Table::copyRect(const Table &source,
+                     int srcX, int srcY, int srcZ,
+                     int width, int height, int depth,
+                     int dstX, int dstY, int dstZ)
+{
+	if (!clipSpan(srcX, dstX, width, source.xs, xs)
+	||  !clipSpan(srcY, dstY, height, source.ys, ys)
+	||  !clipSpan(srcZ, dstZ, depth, source.zs, zs))
+	{
+		return;
+	}
+
+	/* Copying within the same table may overlap,
+	 * so read from a snapshot in that case */
+	std::vector<int16_t> snapshot;
+	const int16_t *srcData = dataPtr(source.data);
+
+	if (&source == this)
+	{
+		snapshot = data;
+		srcData = dataPtr(snapshot);
+	}
+
+	const int srcXs = source.xs;
+	const int srcYs = source.ys;
+
+	for (int k = 0; k < depth; ++k)
+		for (int j = 0; j < height; ++j)
+		{
+			const int16_t *srcRow =
+				&srcData[srcXs*srcYs*(srcZ+k) + srcXs*(srcY+j) + srcX];
+
+			memcpy(&at(dstX, dstY+j, dstZ+k), srcRow, sizeof(int16_t)*width);
+		}
+
+	modified();
+}
+
+int Table::rawSize() const
+{
+	return (xs * ys * zs) * 2;
+}
+
+void Table::getRaw(char *buffer) const
+{
+	memcpy(buffer, dataPtr(data), sizeof(int16_t)*data.size());
+}
+
+void Table::setRaw(const char *buffer, int len)
+{
+	if (len != rawSize())
+		throw Exception(Exception::MKXPError,
+		                "Table data has wrong size (given %d bytes, need %d)",
+		                len, rawSize());
+
+	memcpy(dataPtr(data), buffer, len);
+
+	modified();
+}
+
 /* Serializable */
 int Table::serialSize() const
 {
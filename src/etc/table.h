@@ -47,6 +47,20 @@ public:
 	void resize(int x, int y);
 	void resize(int x);
 
+	/* Bulk operations; regions are clipped to the table
+	 * bounds and each call emits 'modified' only once */
+	void fill(int16_t value, int x, int y, int z,
+	          int width, int height, int depth);
+	void copyRect(const Table &source,
+	              int srcX, int srcY, int srcZ,
+	              int width, int height, int depth,
+	              int dstX, int dstY, int dstZ);
+
+	/* Packed (native endian) int16 contents in x-major order */
+	int rawSize() const;
+	void getRaw(char *buffer) const;
+	void setRaw(const char *buffer, int len);
+
 	int serialSize() const;
 	void serialize(char *buffer) const;
 	static Table *deserialize(const char *data, int len);
@@ -32,6 +32,7 @@
 #include <alc.h>
 #include <alext.h>
 #include <cmath>
+#include <chrono>
 
 #include "sharedstate.h"
 #include "graphics.h"
@@ -424,6 +425,7 @@ void EventThread::process(RGSSThreadData &rtData)
                 }
                 
                 keyStates[event.key.keysym.scancode] = true;
+                pushInputEvent(InputEvent::Key, event.key.keysym.scancode, 1);
                 break;
                 
             case SDL_KEYUP :
@@ -438,18 +440,22 @@ void EventThread::process(RGSSThreadData &rtData)
                 }
                 
                 keyStates[event.key.keysym.scancode] = false;
+                pushInputEvent(InputEvent::Key, event.key.keysym.scancode, 0);
                 break;
                 
             case SDL_CONTROLLERBUTTONDOWN:
                 controllerState.buttons[event.cbutton.button] = true;
+                pushInputEvent(InputEvent::ControllerButton, event.cbutton.button, 1);
                 break;
                 
             case SDL_CONTROLLERBUTTONUP:
                 controllerState.buttons[event.cbutton.button] = false;
+                pushInputEvent(InputEvent::ControllerButton, event.cbutton.button, 0);
                 break;
                 
             case SDL_CONTROLLERAXISMOTION:
                 controllerState.axes[event.caxis.axis] = event.caxis.value;
+                pushInputEvent(InputEvent::ControllerAxis, event.caxis.axis, event.caxis.value);
                 break;
                 
             case SDL_CONTROLLERDEVICEADDED:
@@ -466,10 +472,12 @@ void EventThread::process(RGSSThreadData &rtData)
                 
             case SDL_MOUSEBUTTONDOWN :
                 mouseState.buttons[event.button.button] = true;
+                pushInputEvent(InputEvent::MouseButton, event.button.button, 1);
                 break;
                 
             case SDL_MOUSEBUTTONUP :
                 mouseState.buttons[event.button.button] = false;
+                pushInputEvent(InputEvent::MouseButton, event.button.button, 0);
                 break;
                 
             case SDL_MOUSEMOTION :
@@ -710,6 +718,25 @@ void EventThread::resetInputStates()
     memset(&controllerState, 0, sizeof(controllerState));
     memset(&mouseState.buttons, 0, sizeof(mouseState.buttons));
     memset(&touchState, 0, sizeof(touchState));
+    
+    /* Also called from the RGSS thread, so this can't go
+     * through the (single producer) event queue */
+    inputResync.set();
+}
+
+void EventThread::pushInputEvent(InputEvent::Source source, int code, int value)
+{
+    InputEvent e;
+    e.source = source;
+    e.code = code;
+    e.value = value;
+    e.stamp = std::chrono::duration_cast<std::chrono::nanoseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+    
+    /* The state arrays are still current, so a
+     * resync loses sub-frame presses at worst */
+    if (!inputEvents.push(e))
+        inputResync.set();
 }
 
 void EventThread::setFullscreen(SDL_Window *win, bool mode)
@@ -44,6 +44,86 @@ union SDL_Event;
 
 #define MAX_FINGERS 4
 
+/* A single key, button or axis change as seen by the
+ * event thread, stamped with the time it was processed */
+struct InputEvent
+{
+	enum Source
+	{
+		Key,
+		ControllerButton,
+		ControllerAxis,
+		MouseButton
+	};
+
+	uint8_t source;
+	uint16_t code;
+
+	/* 0/1 for keys and buttons, raw value for axes */
+	int16_t value;
+
+	/* std::chrono::steady_clock, in nanoseconds */
+	int64_t stamp;
+};
+
+/* Lock-free ring with exactly one producer and one consumer
+ * thread. N must be a power of two */
+template<typename T, unsigned int N>
+struct SPSCRing
+{
+	SPSCRing()
+	{
+		SDL_AtomicSet(&head, 0);
+		SDL_AtomicSet(&tail, 0);
+	}
+
+	/* Producer side. Returns false if the ring is full */
+	bool push(const T &value)
+	{
+		unsigned int h = SDL_AtomicGet(&head);
+		unsigned int t = SDL_AtomicGet(&tail);
+
+		if (h - t == N)
+			return false;
+
+		items[h & (N-1)] = value;
+		SDL_AtomicSet(&head, (int) (h + 1));
+
+		return true;
+	}
+
+	/* Consumer side */
+	bool peek(T &out) const
+	{
+		unsigned int t = SDL_AtomicGet(&tail);
+
+		if (t == (unsigned int) SDL_AtomicGet(&head))
+			return false;
+
+		out = items[t & (N-1)];
+
+		return true;
+	}
+
+	void pop()
+	{
+		SDL_AtomicAdd(&tail, 1);
+	}
+
+	/* Consumer side; drops everything pushed so far */
+	void discard()
+	{
+		SDL_AtomicSet(&tail, SDL_AtomicGet(&head));
+	}
+
+private:
+	mutable SDL_atomic_t head;
+	mutable SDL_atomic_t tail;
+	T items[N];
+};
+
+typedef SPSCRing<InputEvent, 1024> InputEventQueue;
+
 class EventThread
 {
 public:
@@ -80,6 +160,14 @@ public:
     std::string textInputBuffer;
     void lockText(bool lock);
     
+    /* Filled by process(), drained by Input::update */
+    InputEventQueue inputEvents;
+    
+    /* Set when queued events no longer describe the input
+     * state (queue overflow, or states were reset); the
+     * consumer then resyncs from the state arrays above */
+    AtomicFlag inputResync;
+    
 
 	static bool allocUserEvents();
 
@@ -121,6 +209,7 @@ private:
 	static int eventFilter(void *, SDL_Event*);
 
 	void resetInputStates();
+	void pushInputEvent(InputEvent::Source source, int code, int value);
 	void setFullscreen(SDL_Window *, bool mode);
 	void updateCursorState(bool inWindow,
 	                       const SDL_Rect &screen);
@@ -142,14 +231,19 @@ private:
 };
 
 /* Used to asynchronously inform the RGSS thread
- * about certain value changes */
+ * about certain value changes. Every post bumps an
+ * epoch counter; the receiver only takes the lock
+ * once it sees an epoch it hasn't consumed yet */
 template<typename T>
 struct UnidirMessage
 {
 	UnidirMessage()
 	    : mutex(SDL_CreateMutex()),
+	      seen(0),
 	      current(T())
-	{}
+	{
+		SDL_AtomicSet(&epoch, 0);
+	}
 
 	~UnidirMessage()
 	{
@@ -161,8 +255,8 @@ struct UnidirMessage
 	{
 		SDL_LockMutex(mutex);
 
-		changed.set();
 		current = value;
+		SDL_AtomicAdd(&epoch, 1);
 
 		SDL_UnlockMutex(mutex);
 	}
@@ -170,13 +264,13 @@ struct UnidirMessage
 	/* Done from the receiving side */
 	bool poll(T &out) const
 	{
-		if (!changed)
+		if (SDL_AtomicGet(&epoch) == seen)
 			return false;
 
 		SDL_LockMutex(mutex);
 
 		out = current;
-		changed.clear();
+		seen = SDL_AtomicGet(&epoch);
 
 		SDL_UnlockMutex(mutex);
 
@@ -193,7 +287,9 @@ struct UnidirMessage
 
 private:
 	SDL_mutex *mutex;
-	mutable AtomicFlag changed;
+	mutable SDL_atomic_t epoch;
+	/* Last epoch handed out by poll(), receiver side only */
+	mutable int seen;
 	T current;
 };
 
@@ -25,6 +25,7 @@
 #include "util/debugwriter.h"
 #include "util/exception.h"
 #include "util/util.h"
+#include "util/sdl-util.h"
 #include "display/font.h"
 #include "crypto/rgssad.h"
 
@@ -33,7 +34,11 @@
 
 #include <physfs.h>
 
+#include <SDL_mutex.h>
+#include <SDL_atomic.h>
+
 #include <algorithm>
+#include <deque>
 #include <stack>
 #include <stdio.h>
 #include <string.h>
@@ -267,6 +272,214 @@ static void strTolower(std::string &str) {
 
 const Uint32 SDL_RWOPS_PHYSFS = SDL_RWOPS_UNKNOWN + 10;
 
+/* Upper bound for the bytes held by the prefetch cache.
+ * Once exceeded, the oldest entries are dropped first */
+#define PREFETCH_CACHE_BUDGET (64 * 1024 * 1024)
+
+/* Reads files into memory on a worker thread ahead of time,
+ * so the (possibly decrypting) archive read doesn't stall the
+ * thread that eventually needs the data. Entries are handed out
+ * exactly once and then forgotten, so a file that changes on
+ * disk is never served stale more than one time. */
+struct Prefetcher {
+  SDL_Thread *thread;
+  SDL_mutex *mutex;
+  SDL_cond *cond;
+
+  /* Normalized paths still waiting for the worker */
+  std::deque<std::string> queue;
+  /* Path the worker is currently reading, if any */
+  std::string inFlight;
+
+  BoostHash<std::string, std::string> cache;
+  /* Cached paths in insertion order, for eviction */
+  std::deque<std::string> order;
+  size_t cacheBytes;
+
+  /* Bumped by clear(); reads started before that are dropped */
+  unsigned int generation;
+
+  /* Number of queued, in flight and cached paths, readable
+   * without the mutex. Only the thread calling enqueue() can
+   * raise it from zero, so that thread may trust a zero */
+  SDL_atomic_t pending;
+
+  bool quit;
+
+  Prefetcher()
+      : thread(0), mutex(SDL_CreateMutex()), cond(SDL_CreateCond()),
+        cacheBytes(0), generation(0), quit(false) {
+    SDL_AtomicSet(&pending, 0);
+  }
+
+  ~Prefetcher() {
+    if (thread) {
+      SDL_LockMutex(mutex);
+      quit = true;
+      SDL_CondBroadcast(cond);
+      SDL_UnlockMutex(mutex);
+
+      SDL_WaitThread(thread, 0);
+    }
+
+    SDL_DestroyCond(cond);
+    SDL_DestroyMutex(mutex);
+  }
+
+  /* Expects the mutex to be held */
+  void updatePending() {
+    SDL_AtomicSet(&pending, queue.size() + order.size() + !inFlight.empty());
+  }
+
+  bool isIdle() {
+    return SDL_AtomicGet(&pending) == 0;
+  }
+
+  bool known(const std::string &path) const {
+    return cache.contains(path) || inFlight == path ||
+           std::find(queue.begin(), queue.end(), path) != queue.end();
+  }
+
+  void enqueue(const std::string &path) {
+    SDL_LockMutex(mutex);
+
+    if (!known(path)) {
+      queue.push_back(path);
+      updatePending();
+      SDL_CondBroadcast(cond);
+    }
+
+    SDL_UnlockMutex(mutex);
+
+    if (!thread)
+      thread = createSDLThread<Prefetcher, &Prefetcher::run>(this, "prefetch");
+  }
+
+  /* Expects the mutex to be held */
+  void drop(const std::string &path) {
+    if (!cache.contains(path))
+      return;
+
+    cacheBytes -= cache[path].size();
+    cache.remove(path);
+    order.erase(std::find(order.begin(), order.end(), path));
+    updatePending();
+  }
+
+  void store(const std::string &path, std::string &data) {
+    /* Never worth evicting everything else for */
+    if (data.size() > PREFETCH_CACHE_BUDGET)
+      return;
+
+    while (cacheBytes + data.size() > PREFETCH_CACHE_BUDGET && !order.empty()) {
+      std::string oldest = order.front();
+      drop(oldest);
+    }
+
+    cacheBytes += data.size();
+    cache[path].swap(data);
+    order.push_back(path);
+    updatePending();
+  }
+
+  bool take(const std::string &path, std::string &out) {
+    SDL_LockMutex(mutex);
+
+    /* Not started yet; the caller is better off reading
+     * it directly than waiting behind the rest of the queue */
+    std::deque<std::string>::iterator q = std::find(queue.begin(), queue.end(), path);
+    if (q != queue.end())
+      queue.erase(q);
+
+    while (inFlight == path)
+      SDL_CondWait(cond, mutex);
+
+    bool hit = cache.contains(path);
+
+    if (hit) {
+      out.swap(cache[path]);
+      cacheBytes -= out.size();
+      cache.remove(path);
+      order.erase(std::find(order.begin(), order.end(), path));
+    }
+
+    updatePending();
+    SDL_UnlockMutex(mutex);
+
+    return hit;
+  }
+
+  void clear() {
+    SDL_LockMutex(mutex);
+
+    /* Queued paths were resolved against the old mounts too */
+    queue.clear();
+    cache.clear();
+    order.clear();
+    cacheBytes = 0;
+    ++generation;
+    updatePending();
+
+    SDL_UnlockMutex(mutex);
+  }
+
+  static bool readAll(const std::string &path, std::string &out) {
+    PHYSFS_File *handle = PHYSFS_openRead(path.c_str());
+
+    if (!handle)
+      return false;
+
+    PHYSFS_sint64 length = PHYSFS_fileLength(handle);
+    bool ok = length >= 0;
+
+    if (ok) {
+      out.resize(length);
+      ok = length == 0 ||
+           PHYSFS_readBytes(handle, &out[0], length) == length;
+    }
+
+    PHYSFS_close(handle);
+
+    return ok;
+  }
+
+  void run() {
+    SDL_LockMutex(mutex);
+
+    while (true) {
+      while (queue.empty() && !quit)
+        SDL_CondWait(cond, mutex);
+
+      if (quit)
+        break;
+
+      inFlight = queue.front();
+      queue.pop_front();
+
+      const unsigned int gen = generation;
+
+      SDL_UnlockMutex(mutex);
+
+      /* Failures are not cached; the eventual load_data will
+       * retry the read and report the error the usual way */
+      std::string data;
+      bool ok = readAll(inFlight, data);
+
+      SDL_LockMutex(mutex);
+
+      /* The mounts changed while reading; the data may be stale */
+      if (ok && gen == generation)
+        store(inFlight, data);
+
+      inFlight.clear();
+      updatePending();
+      SDL_CondBroadcast(cond);
+    }
+
+    SDL_UnlockMutex(mutex);
+  }
+};
+
 struct FileSystemPrivate {
   /* Maps: lower case full filepath,
    * To:   mixed case full filepath */
@@ -278,6 +491,8 @@ struct FileSystemPrivate {
   /* This is for compatibility with games that take Windows'
    * case insensitivity for granted */
   bool havePathCache;
+
+  Prefetcher prefetcher;
 };
 
 static void throwPhysfsError(const char *desc) {
@@ -339,6 +554,9 @@ void FileSystem::addPath(const char *path, const char *mountpoint, bool reload)
         throw Exception(Exception::PHYSFSError, "Failed to mount %s (%s)", path, PHYSFS_getErrorByCode(err));
     }
     
+    /* The new mount may shadow files we already read */
+    p->prefetcher.clear();
+
     if (reload) reloadPathCache();
 }
 
@@ -349,6 +567,8 @@ void FileSystem::removePath(const char *path, bool reload) {
         throw Exception(Exception::PHYSFSError, "Failed to unmount %s (%s)", path, PHYSFS_getErrorByCode(err));
     }
     
+    p->prefetcher.clear();
+
     if (reload) reloadPathCache();
 }
 
@@ -671,6 +891,49 @@ void FileSystem::openReadRaw(SDL_RWops &ops, const char *filename,
     return;
 }
 
+std::string FileSystem::resolvePath(const char *filename) {
+  std::string path = normalize(filename, 0, 0);
+
+  if (!p->havePathCache)
+    return path;
+
+  std::string lower = path;
+  strTolower(lower);
+
+  if (p->pathCache.contains(lower))
+    return p->pathCache[lower];
+
+  return path;
+}
+
+void FileSystem::prefetch(const char *filename) {
+  p->prefetcher.enqueue(resolvePath(filename));
+}
+
+bool FileSystem::hasPrefetches() {
+  return !p->prefetcher.isIdle();
+}
+
+bool FileSystem::takePrefetched(const char *filename, std::string &out) {
+  return p->prefetcher.take(resolvePath(filename), out);
+}
+
+void FileSystem::dropPrefetched(const char *filename) {
+  Prefetcher &pf = p->prefetcher;
+
+  SDL_LockMutex(pf.mutex);
+
+  /* Let a read in progress finish, so it can't
+   * put the old contents back afterwards */
+  std::string path = resolvePath(filename);
+  while (pf.inFlight == path)
+    SDL_CondWait(pf.cond, pf.mutex);
+
+  pf.drop(path);
+
+  SDL_UnlockMutex(pf.mutex);
+}
+
 std::string FileSystem::normalize(const char *pathname, bool preferred,
                             bool absolute) {
     return filesystemImpl::normalizePath(pathname, preferred, absolute);
@@ -72,8 +72,31 @@ public:
 	                 const char *filename,
 	                 bool freeOnClose = false);
 
+	/* Queues 'filename' to be read into memory in the
+	 * background. Does not perform extension supplementing */
+	void prefetch(const char *filename);
+
+	/* False if nothing is queued, being read or cached, in which
+	 * case takePrefetched() can't hit. Reliable only on the
+	 * thread calling prefetch() */
+	bool hasPrefetches();
+
+	/* Hands over (and forgets) the prefetched contents of
+	 * 'filename', waiting if it's being read right now.
+	 * Returns false if it was never prefetched or the
+	 * read failed */
+	bool takePrefetched(const char *filename, std::string &out);
+
+	/* Forgets prefetched contents, eg. after the file was
+	 * written to */
+	void dropPrefetched(const char *filename);
+
 	std::string normalize(const char *pathname, bool preferred, bool absolute);
 
+	/* Normalizes 'filename' and, with the path cache active,
+	 * translates it to the case the file has on disk */
+	std::string resolvePath(const char *filename);
+
 	/* Does not perform extension supplementing */
 	bool exists(const char *filename);
 
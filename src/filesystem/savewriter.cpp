@@ -0,0 +1,309 @@
+/*
+** savewriter.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "savewriter.h"
+
+#include "system/system.h"
+#include "exception.h"
+#include "debugwriter.h"
+#include "sdl-util.h"
+
+#include <SDL_mutex.h>
+
+#include <deque>
+#include <stdio.h>
+
+#if MKXPZ_PLATFORM == MKXPZ_PLATFORM_WINDOWS
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if MKXPZ_PLATFORM == MKXPZ_PLATFORM_WINDOWS
+static std::wstring utf8ToWide(const char *str)
+{
+	std::wstring ret;
+	int size = MultiByteToWideChar(CP_UTF8, 0, str, -1, 0, 0);
+
+	if (size > 0)
+	{
+		ret.resize(size);
+		MultiByteToWideChar(CP_UTF8, 0, str, -1, &ret[0], size);
+		ret.resize(size-1);
+	}
+
+	return ret;
+}
+
+static FILE *openFile(const std::string &path)
+{
+	return _wfopen(utf8ToWide(path.c_str()).c_str(), L"wb");
+}
+
+static void removeFile(const std::string &path)
+{
+	_wremove(utf8ToWide(path.c_str()).c_str());
+}
+
+static bool syncFile(FILE *f)
+{
+	return _commit(_fileno(f)) == 0;
+}
+
+static bool replaceFile(const std::string &from, const char *to)
+{
+	return MoveFileExW(utf8ToWide(from.c_str()).c_str(), utf8ToWide(to).c_str(),
+	                   MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+}
+#else
+static FILE *openFile(const std::string &path)
+{
+	return fopen(path.c_str(), "wb");
+}
+
+static void removeFile(const std::string &path)
+{
+	remove(path.c_str());
+}
+
+static bool syncFile(FILE *f)
+{
+	return fsync(fileno(f)) == 0;
+}
+
+static bool replaceFile(const std::string &from, const char *to)
+{
+	if (rename(from.c_str(), to) != 0)
+		return false;
+
+	/* The rename itself only becomes durable once the
+	 * containing directory is synced. Best effort */
+	std::string dir(to);
+	size_t sep = dir.rfind('/');
+	dir = (sep == std::string::npos) ? "." : dir.substr(0, sep ? sep : 1);
+
+	int fd = open(dir.c_str(), O_RDONLY);
+
+	if (fd >= 0)
+	{
+		fsync(fd);
+		close(fd);
+	}
+
+	return true;
+}
+#endif
+
+void SaveWriter::writeFile(const char *path, const char *data, size_t size)
+{
+	const std::string tmp = std::string(path) + ".tmp";
+
+	FILE *f = openFile(tmp);
+
+	if (!f)
+		throw Exception(Exception::MKXPError, "Failed to open '%s' for writing", tmp.c_str());
+
+	bool ok = fwrite(data, 1, size, f) == size;
+	ok = fflush(f) == 0 && ok;
+	ok = syncFile(f) && ok;
+	ok = fclose(f) == 0 && ok;
+
+	if (!ok)
+	{
+		removeFile(tmp);
+		throw Exception(Exception::MKXPError, "Failed to write '%s'", tmp.c_str());
+	}
+
+	if (!replaceFile(tmp, path))
+	{
+		removeFile(tmp);
+		throw Exception(Exception::MKXPError, "Failed to replace '%s'", path);
+	}
+}
+
+struct SaveJob
+{
+	std::string path;
+	std::string data;
+};
+
+struct SaveWriterPrivate
+{
+	SDL_Thread *thread;
+	SDL_mutex *mutex;
+	SDL_cond *cond;
+
+	std::deque<SaveJob> queue;
+	/* Path being written right now, if 'busy' */
+	std::string current;
+	bool busy;
+
+	std::string error;
+	bool quit;
+
+	SaveWriterPrivate()
+	    : thread(0),
+	      mutex(SDL_CreateMutex()),
+	      cond(SDL_CreateCond()),
+	      busy(false),
+	      quit(false)
+	{}
+
+	~SaveWriterPrivate()
+	{
+		SDL_DestroyCond(cond);
+		SDL_DestroyMutex(mutex);
+	}
+
+	void run()
+	{
+		SDL_LockMutex(mutex);
+
+		while (true)
+		{
+			while (queue.empty() && !quit)
+				SDL_CondWait(cond, mutex);
+
+			if (queue.empty())
+				break;
+
+			SaveJob job;
+			job.path.swap(queue.front().path);
+			job.data.swap(queue.front().data);
+			queue.pop_front();
+
+			current = job.path;
+			busy = true;
+
+			SDL_UnlockMutex(mutex);
+
+			std::string failure;
+
+			try
+			{
+				SaveWriter::writeFile(job.path.c_str(), job.data.data(), job.data.size());
+			}
+			catch (const Exception &e)
+			{
+				failure = e.msg.c_str();
+				Debug() << "Background save failed:" << failure;
+			}
+
+			SDL_LockMutex(mutex);
+
+			if (!failure.empty() && error.empty())
+				error = failure;
+
+			busy = false;
+			SDL_CondBroadcast(cond);
+		}
+
+		SDL_UnlockMutex(mutex);
+	}
+};
+
+SaveWriter::SaveWriter()
+    : p(new SaveWriterPrivate)
+{}
+
+SaveWriter::~SaveWriter()
+{
+	if (p->thread)
+	{
+		/* The worker drains the queue before it exits */
+		SDL_LockMutex(p->mutex);
+		p->quit = true;
+		SDL_CondBroadcast(p->cond);
+		SDL_UnlockMutex(p->mutex);
+
+		SDL_WaitThread(p->thread, 0);
+	}
+
+	delete p;
+}
+
+void SaveWriter::queue(const char *path, std::string &data)
+{
+	SDL_LockMutex(p->mutex);
+
+	p->queue.push_back(SaveJob());
+	p->queue.back().path = path;
+	p->queue.back().data.swap(data);
+
+	SDL_CondBroadcast(p->cond);
+	SDL_UnlockMutex(p->mutex);
+
+	if (!p->thread)
+		p->thread = createSDLThread<SaveWriterPrivate, &SaveWriterPrivate::run>(p, "savewriter");
+}
+
+bool SaveWriter::isPending(const char *path)
+{
+	SDL_LockMutex(p->mutex);
+
+	bool pending;
+
+	if (!path)
+	{
+		pending = p->busy || !p->queue.empty();
+	}
+	else
+	{
+		pending = p->busy && p->current == path;
+
+		for (size_t i = 0; i < p->queue.size() && !pending; ++i)
+			pending = p->queue[i].path == path;
+	}
+
+	SDL_UnlockMutex(p->mutex);
+
+	return pending;
+}
+
+void SaveWriter::flush()
+{
+	SDL_LockMutex(p->mutex);
+
+	while (p->busy || !p->queue.empty())
+		SDL_CondWait(p->cond, p->mutex);
+
+	SDL_UnlockMutex(p->mutex);
+}
+
+bool SaveWriter::takeError(std::string &error)
+{
+	SDL_LockMutex(p->mutex);
+
+	bool failed = !p->error.empty();
+
+	if (failed)
+	{
+		error.swap(p->error);
+		p->error.clear();
+	}
+
+	SDL_UnlockMutex(p->mutex);
+
+	return failed;
+}
@@ -0,0 +1,61 @@
+/*
+** savewriter.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SAVEWRITER_H
+#define SAVEWRITER_H
+
+#include <string>
+
+struct SaveWriterPrivate;
+
+/* Writes files on a background thread. Every file is first
+ * written to a temporary sibling, flushed to disk, and then
+ * renamed over the destination, so a crash leaves either the
+ * old or the new contents behind, never a mix. Writes to the
+ * same path land in the order they were queued. */
+class SaveWriter
+{
+public:
+	SaveWriter();
+	/* Finishes all queued writes first */
+	~SaveWriter();
+
+	/* Takes over the contents of 'data' */
+	void queue(const char *path, std::string &data);
+
+	/* Whether writes to 'path' (or any path, if null)
+	 * are still queued or in progress */
+	bool isPending(const char *path = 0);
+
+	/* Blocks until nothing is pending anymore */
+	void flush();
+
+	/* Returns false if no write failed since the last call,
+	 * otherwise describes the first failure in 'error' */
+	bool takeError(std::string &error);
+
+	/* Writes 'size' bytes to 'path' the same way, on the
+	 * calling thread. Throws an Exception on failure */
+	static void writeFile(const char *path, const char *data, size_t size);
+
+private:
+	SaveWriterPrivate *p;
+};
+
+#endif // SAVEWRITER_H
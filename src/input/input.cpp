@@ -24,6 +24,9 @@
 #include "sharedstate.h"
 #include "eventthread.h"
 #include "input/keybindings.h"
+#include "input/inputlog.h"
+#include "graphics.h"
+#include "debugwriter.h"
 #include "util/exception.h"
 #include "util/util.h"
 
@@ -34,9 +37,11 @@
 
 #include <vector>
 #include <cmath>
+#include <chrono>
 #include <unordered_map>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 
 #define BUTTON_CODE_COUNT 26
 
@@ -475,14 +480,38 @@ struct ButtonState
     bool repeated;
     bool released;
     
+    /* runTime() at which the press arrived */
+    double pressTime;
+    
     ButtonState()
     : pressed(false),
     triggered(false),
     repeated(false),
-    released(false)
+    released(false),
+    pressTime(0)
     {}
 };
 
+/* Input state as of the last Input.update, rebuilt by
+ * replaying the event thread's timestamped queue */
+struct SourceStates
+{
+    uint8_t keys[SDL_NUM_SCANCODES];
+    uint8_t ctrlButtons[SDL_CONTROLLER_BUTTON_MAX];
+    int ctrlAxes[SDL_CONTROLLER_AXIS_MAX];
+    uint8_t mouseButtons[32];
+    
+    int mouseX, mouseY;
+    bool mouseInWindow;
+    
+    /* Accumulated until handed out through scrollV */
+    int scroll;
+    
+    double keyPressTime[SDL_NUM_SCANCODES];
+    double ctrlPressTime[SDL_CONTROLLER_BUTTON_MAX];
+    double mousePressTime[32];
+};
+
 struct KbBindingData
 {
     SDL_Scancode source;
@@ -495,9 +524,12 @@ struct Binding
     : target(target)
     {}
     
-    virtual bool sourceActive() const = 0;
+    virtual bool sourceActive(const SourceStates &s) const = 0;
     virtual bool sourceRepeatable() const = 0;
     
+    /* Only meaningful while the source is active */
+    virtual double sourcePressTime(const SourceStates &s) const = 0;
+    
     Input::ButtonCode target;
 };
 
@@ -511,18 +543,26 @@ struct KbBinding : public Binding
     source(data.source)
     {}
     
-    bool sourceActive() const
+    /* Special case aliases */
+    SDL_Scancode alias() const
     {
-        /* Special case aliases */
         if (source == SDL_SCANCODE_LSHIFT)
-            return EventThread::keyStates[source]
-            || EventThread::keyStates[SDL_SCANCODE_RSHIFT];
+            return SDL_SCANCODE_RSHIFT;
         
         if (source == SDL_SCANCODE_RETURN)
-            return EventThread::keyStates[source]
-            || EventThread::keyStates[SDL_SCANCODE_KP_ENTER];
+            return SDL_SCANCODE_KP_ENTER;
         
-        return EventThread::keyStates[source];
+        return source;
+    }
+    
+    bool sourceActive(const SourceStates &s) const
+    {
+        return s.keys[source] || s.keys[alias()];
+    }
+    
+    double sourcePressTime(const SourceStates &s) const
+    {
+        return s.keys[source] ? s.keyPressTime[source] : s.keyPressTime[alias()];
     }
     
     bool sourceRepeatable() const
@@ -542,9 +582,14 @@ struct CtrlButtonBinding : public Binding
 {
     CtrlButtonBinding() {}
     
-    bool sourceActive() const
+    bool sourceActive(const SourceStates &s) const
     {
-        return EventThread::controllerState.buttons[source];
+        return s.ctrlButtons[source];
+    }
+    
+    double sourcePressTime(const SourceStates &s) const
+    {
+        return s.ctrlPressTime[source];
     }
     
     bool sourceRepeatable() const
@@ -562,9 +607,9 @@ struct CtrlAxisBinding : public Binding
     CtrlAxisBinding(uint8_t source, AxisDir dir, Input::ButtonCode target)
     : Binding(target), source(source), dir(dir) {}
     
-    bool sourceActive() const
+    bool sourceActive(const SourceStates &s) const
     {
-        float val = EventThread::controllerState.axes[source];
+        float val = s.ctrlAxes[source];
         
         if (dir == Negative)
             return val < -JAXIS_THRESHOLD;
@@ -572,6 +617,13 @@ struct CtrlAxisBinding : public Binding
             return val > JAXIS_THRESHOLD;
     }
     
+    /* Axis events don't cross the threshold at a single
+     * well defined moment, so there's nothing better */
+    double sourcePressTime(const SourceStates &) const
+    {
+        return shState->runTime();
+    }
+    
     bool sourceRepeatable() const {
         return true;
     }
@@ -591,9 +643,14 @@ struct MsBinding : public Binding
     index(buttonIndex)
     {}
     
-    bool sourceActive() const
+    bool sourceActive(const SourceStates &s) const
     {
-        return EventThread::mouseState.buttons[index];
+        return s.mouseButtons[index];
+    }
+    
+    double sourcePressTime(const SourceStates &s) const
+    {
+        return s.mousePressTime[index];
     }
     
     bool sourceRepeatable() const
@@ -666,6 +723,21 @@ static const Input::ButtonCode otherDirs[4][3] =
     { Input::Left, Input::Right, Input::Up    }  /* Up    */
 };
 
+/* Flattened SourceStates layout used by InputLog */
+enum
+{
+    SlotKeys = 0,
+    SlotCtrlButtons = SlotKeys + SDL_NUM_SCANCODES,
+    SlotCtrlAxes = SlotCtrlButtons + SDL_CONTROLLER_BUTTON_MAX,
+    SlotMouseButtons = SlotCtrlAxes + SDL_CONTROLLER_AXIS_MAX,
+    SlotMouseX = SlotMouseButtons + 32,
+    SlotMouseY,
+    SlotMouseInWindow,
+    SlotScroll,
+    
+    SlotCount
+};
+
 struct InputPrivate
 {
     std::vector<KbBinding> kbStatBindings;
@@ -682,6 +754,12 @@ struct InputPrivate
     ButtonState *states;
     ButtonState *statesOld;
     
+    SourceStates src;
+    
+    /* Set while recording or replaying */
+    InputLog *log;
+    bool replayDesyncWarned;
+    
     // Raw keystates
     uint8_t rawStateArray[SDL_NUM_SCANCODES*2];
     
@@ -786,6 +864,269 @@ struct InputPrivate
         dir8Data.active = 0;
         
         vScrollDistance = 0;
+        
+        /* Picked up from the event thread on the first update */
+        memset(&src, 0, sizeof(src));
+        rtData.ethread->inputResync.set();
+        
+        log = 0;
+        replayDesyncWarned = false;
+        openLog(rtData.config);
+    }
+    
+    ~InputPrivate()
+    {
+        delete log;
+    }
+    
+    void openLog(const Config &conf)
+    {
+        try
+        {
+            if (!conf.inputLog.replayPath.empty())
+            {
+                log = new InputLog(conf.inputLog.replayPath.c_str(),
+                                   InputLog::Replay, SlotCount);
+                Debug() << "Replaying input from" << conf.inputLog.replayPath;
+            }
+            else if (!conf.inputLog.recordPath.empty())
+            {
+                uint32_t seed = (uint32_t) time(0) ^ (uint32_t) SDL_GetPerformanceCounter();
+                log = new InputLog(conf.inputLog.recordPath.c_str(),
+                                   InputLog::Record, SlotCount, seed);
+                Debug() << "Recording input to" << conf.inputLog.recordPath;
+            }
+        }
+        catch (const Exception &exc)
+        {
+            Debug() << exc.msg;
+        }
+    }
+    
+    void packSources(int32_t *slots) const
+    {
+        for (int i = 0; i < SDL_NUM_SCANCODES; ++i)
+            slots[SlotKeys+i] = src.keys[i];
+        
+        for (int i = 0; i < SDL_CONTROLLER_BUTTON_MAX; ++i)
+            slots[SlotCtrlButtons+i] = src.ctrlButtons[i];
+        
+        for (int i = 0; i < SDL_CONTROLLER_AXIS_MAX; ++i)
+            slots[SlotCtrlAxes+i] = src.ctrlAxes[i];
+        
+        for (int i = 0; i < 32; ++i)
+            slots[SlotMouseButtons+i] = src.mouseButtons[i];
+        
+        slots[SlotMouseX] = src.mouseX;
+        slots[SlotMouseY] = src.mouseY;
+        slots[SlotMouseInWindow] = src.mouseInWindow;
+        slots[SlotScroll] = src.scroll;
+    }
+    
+    void unpackSources(const int32_t *slots)
+    {
+        const double now = shState->runTime();
+        
+        for (int i = 0; i < SDL_NUM_SCANCODES; ++i)
+        {
+            if (slots[SlotKeys+i] && !src.keys[i])
+                src.keyPressTime[i] = now;
+            src.keys[i] = slots[SlotKeys+i];
+        }
+        
+        for (int i = 0; i < SDL_CONTROLLER_BUTTON_MAX; ++i)
+        {
+            if (slots[SlotCtrlButtons+i] && !src.ctrlButtons[i])
+                src.ctrlPressTime[i] = now;
+            src.ctrlButtons[i] = slots[SlotCtrlButtons+i];
+        }
+        
+        for (int i = 0; i < SDL_CONTROLLER_AXIS_MAX; ++i)
+            src.ctrlAxes[i] = slots[SlotCtrlAxes+i];
+        
+        for (int i = 0; i < 32; ++i)
+        {
+            if (slots[SlotMouseButtons+i] && !src.mouseButtons[i])
+                src.mousePressTime[i] = now;
+            src.mouseButtons[i] = slots[SlotMouseButtons+i];
+        }
+        
+        src.mouseX = slots[SlotMouseX];
+        src.mouseY = slots[SlotMouseY];
+        src.mouseInWindow = slots[SlotMouseInWindow];
+        src.scroll = slots[SlotScroll];
+    }
+    
+    /* Returns false once the log runs out */
+    bool replaySources()
+    {
+        EventThread &et = shState->eThread();
+        
+        /* Live input is ignored while replaying */
+        et.inputEvents.discard();
+        SDL_AtomicSet(&EventThread::verticalScrollDistance, 0);
+        
+        int32_t slots[SlotCount];
+        unsigned int frame;
+        
+        if (!log->read(frame, slots))
+        {
+            Debug() << "Input replay finished";
+            
+            delete log;
+            log = 0;
+            et.inputResync.set();
+            
+            if (shState->config().headless.enabled)
+                et.requestTerminate();
+            
+            return false;
+        }
+        
+        const unsigned int current = shState->graphics().getFrameCount();
+        
+        if (frame != current && !replayDesyncWarned)
+        {
+            Debug() << "Input replay out of sync: log frame" << frame
+                    << "played at frame" << current;
+            replayDesyncWarned = true;
+        }
+        
+        unpackSources(slots);
+        
+        return true;
+    }
+    
+    void updateSources()
+    {
+        if (log && log->mode() == InputLog::Replay && replaySources())
+            return;
+        
+        drainSources();
+        
+        src.mouseX = EventThread::mouseState.x;
+        src.mouseY = EventThread::mouseState.y;
+        src.mouseInWindow = EventThread::mouseState.inWindow;
+        src.scroll += SDL_AtomicSet(&EventThread::verticalScrollDistance, 0);
+        
+        if (log)
+        {
+            int32_t slots[SlotCount];
+            packSources(slots);
+            log->write(shState->graphics().getFrameCount(), slots);
+        }
+    }
+    
+    /* Takes over the event thread's current state arrays
+     * as they are, dropping anything still queued */
+    void resyncSources()
+    {
+        EventThread &et = shState->eThread();
+        
+        et.inputResync.clear();
+        et.inputEvents.discard();
+        
+        const double now = shState->runTime();
+        
+        for (int i = 0; i < SDL_NUM_SCANCODES; ++i)
+        {
+            if (EventThread::keyStates[i] && !src.keys[i])
+                src.keyPressTime[i] = now;
+            src.keys[i] = EventThread::keyStates[i];
+        }
+        
+        for (int i = 0; i < SDL_CONTROLLER_BUTTON_MAX; ++i)
+        {
+            if (EventThread::controllerState.buttons[i] && !src.ctrlButtons[i])
+                src.ctrlPressTime[i] = now;
+            src.ctrlButtons[i] = EventThread::controllerState.buttons[i];
+        }
+        
+        for (int i = 0; i < SDL_CONTROLLER_AXIS_MAX; ++i)
+            src.ctrlAxes[i] = EventThread::controllerState.axes[i];
+        
+        for (int i = 0; i < 32; ++i)
+        {
+            if (EventThread::mouseState.buttons[i] && !src.mouseButtons[i])
+                src.mousePressTime[i] = now;
+            src.mouseButtons[i] = EventThread::mouseState.buttons[i];
+        }
+    }
+    
+    /* Replays queued events in arrival order. A second change
+     * to the same key or button ends the replay early, so that
+     * taps shorter than a frame are still seen as pressed for
+     * one update and released in the next one */
+    void drainSources()
+    {
+        EventThread &et = shState->eThread();
+        
+        if (et.inputResync)
+        {
+            resyncSources();
+            return;
+        }
+        
+        const int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>
+            (std::chrono::steady_clock::now().time_since_epoch()).count();
+        const double now = shState->runTime();
+        
+        uint8_t keysChanged[SDL_NUM_SCANCODES] = { 0 };
+        uint8_t ctrlChanged[SDL_CONTROLLER_BUTTON_MAX] = { 0 };
+        uint8_t mouseChanged[32] = { 0 };
+        
+        InputEvent e;
+        
+        while (et.inputEvents.peek(e))
+        {
+            uint8_t *changed;
+            uint8_t *state;
+            double *pressTime;
+            
+            switch (e.source)
+            {
+                case InputEvent::Key :
+                    changed = &keysChanged[e.code];
+                    state = &src.keys[e.code];
+                    pressTime = &src.keyPressTime[e.code];
+                    break;
+                    
+                case InputEvent::ControllerButton :
+                    changed = &ctrlChanged[e.code];
+                    state = &src.ctrlButtons[e.code];
+                    pressTime = &src.ctrlPressTime[e.code];
+                    break;
+                    
+                case InputEvent::MouseButton :
+                    changed = &mouseChanged[e.code];
+                    state = &src.mouseButtons[e.code];
+                    pressTime = &src.mousePressTime[e.code];
+                    break;
+                    
+                case InputEvent::ControllerAxis :
+                default :
+                    src.ctrlAxes[e.code] = e.value;
+                    et.inputEvents.pop();
+                    continue;
+            }
+            
+            /* Key repeat */
+            if ((e.value != 0) == (*state != 0))
+            {
+                et.inputEvents.pop();
+                continue;
+            }
+            
+            if (*changed)
+                break;
+            
+            if (e.value)
+                *pressTime = now - (nowNs - e.stamp) / 1000000000.0;
+            
+            *changed = 1;
+            *state = e.value != 0;
+            et.inputEvents.pop();
+        }
     }
     
     inline ButtonState &getStateCheck(int code)
@@ -1021,7 +1362,7 @@ struct InputPrivate
     void pollBindingPriv(const Binding &b,
                          Input::ButtonCode &repeatCand)
     {
-        if (!b.sourceActive())
+        if (!b.sourceActive(src))
             return;
         
         if (b.target == Input::None)
@@ -1030,6 +1371,12 @@ struct InputPrivate
         ButtonState &state = getState(b.target);
         ButtonState &oldState = getOldState(b.target);
         
+        /* With several sources bound, the first one counts */
+        if (oldState.pressed)
+            state.pressTime = oldState.pressTime;
+        else if (!state.pressed || b.sourcePressTime(src) < state.pressTime)
+            state.pressTime = b.sourcePressTime(src);
+        
         state.pressed = true;
         
         /* Must have been released before to trigger */
@@ -1054,7 +1401,7 @@ struct InputPrivate
     void updateRaw()
     {
         
-        memcpy(rawStates, shState->eThread().keyStates, SDL_NUM_SCANCODES);
+        memcpy(rawStates, src.keys, SDL_NUM_SCANCODES);
         
         for (int i = 0; i < SDL_NUM_SCANCODES; i++)
         {
@@ -1082,9 +1429,9 @@ struct InputPrivate
     void updateControllerRaw()
     {
         for (int i = 0; i < SDL_CONTROLLER_AXIS_MAX; i++)
-            axisStateArray[i] = shState->eThread().controllerState.axes[i];
+            axisStateArray[i] = src.ctrlAxes[i];
         
-        memcpy(rawButtonStates, shState->eThread().controllerState.buttons, SDL_CONTROLLER_BUTTON_MAX);
+        memcpy(rawButtonStates, src.ctrlButtons, SDL_CONTROLLER_BUTTON_MAX);
         
         for (int i = 0; i < SDL_CONTROLLER_BUTTON_MAX; i++)
         {
@@ -1210,6 +1557,8 @@ void Input::update()
     p->swapBuffers();
     p->clearBuffer();
     
+    p->updateSources();
+    
     ButtonCode repeatCand = None;
     
     /* Poll all bindings */
@@ -1220,9 +1569,9 @@ void Input::update()
     p->updateControllerRaw();
     
     // Record mouse positions
-    p->mousePos[0] = shState->eThread().mouseState.x;
-    p->mousePos[1] = shState->eThread().mouseState.y;
-    p->mouseInWindow = shState->eThread().mouseState.inWindow;
+    p->mousePos[0] = p->src.mouseX;
+    p->mousePos[1] = p->src.mouseY;
+    p->mouseInWindow = p->src.mouseInWindow;
     
     
     /* Check for new repeating key */
@@ -1259,7 +1608,8 @@ void Input::update()
     p->repeating = None;
     
     /* Fetch new cumulative scroll distance and reset counter */
-    p->vScrollDistance = SDL_AtomicSet(&EventThread::verticalScrollDistance, 0);
+    p->vScrollDistance = p->src.scroll;
+    p->src.scroll = 0;
     
     p->last_update = shState->runTime();
     
@@ -1393,6 +1743,36 @@ double Input::repeatTimeEx(int code, bool isVKey) {
     return shState->runTime() - p->rawRepeatTime;
 }
 
+bool Input::randomSeed(uint32_t &seed) const {
+    if (!p->log)
+        return false;
+    
+    seed = p->log->seed();
+    return true;
+}
+
+double Input::pressTime(int button) {
+    const ButtonState &state = p->getStateCheck(button);
+    
+    if (!state.pressed)
+        return 0;
+    
+    return shState->runTime() - state.pressTime;
+}
+
+double Input::pressTimeEx(int code, bool isVKey) {
+    int c = code;
+    if (isVKey) {
+        try { c = vKeyToScancode[code]; }
+        catch (...) { return 0; }
+    }
+    
+    if (c < 0 || c >= SDL_NUM_SCANCODES || !p->rawStates[c])
+        return 0;
+    
+    return shState->runTime() - p->src.keyPressTime[c];
+}
+
 double Input::controllerRepeatTimeEx(int button) {
     if (button != p->buttonRepeating)
         return 0;
@@ -26,6 +26,7 @@
 #include <SDL_gamecontroller.h>
 #include <string>
 #include <vector>
+#include <stdint.h>
 
 extern std::unordered_map<int, int> vKeyToScancode;
 extern std::unordered_map<std::string, int> strToScancode;
@@ -78,12 +79,18 @@ public:
     unsigned int count(int button);
     double repeatTime(int button);
     
+    /* Seconds since the button went down, measured from
+     * when the event arrived rather than from the update
+     * that first saw it. 0 if not pressed */
+    double pressTime(int button);
+    
     bool isPressedEx(int code, bool isVKey);
     bool isTriggeredEx(int code, bool isVKey);
     bool isRepeatedEx(int code, bool isVKey);
     bool isReleasedEx(int code, bool isVKey);
     unsigned int repeatcount(int code, bool isVKey);
     double repeatTimeEx(int code, bool isVKey);
+    double pressTimeEx(int code, bool isVKey);
     
     bool controllerIsPressedEx(int button);
     bool controllerIsTriggeredEx(int button);
@@ -126,6 +133,10 @@ public:
 
 	bool hasQuit();
 
+	/* Seed for Ruby's RNG while recording or replaying
+	 * an input log; false if neither is active */
+	bool randomSeed(uint32_t &seed) const;
+
 private:
 	Input(const RGSSThreadData &rtData);
 	~Input();
@@ -0,0 +1,170 @@
+/*
+** inputlog.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "inputlog.h"
+
+#include "exception.h"
+
+#include <SDL_endian.h>
+
+#include <string.h>
+
+static const char logMagic[8] = { 'M', 'K', 'X', 'P', 'I', 'N', 'P', 'T' };
+static const uint32_t logVersion = 1;
+
+/* Updates between flushes while recording */
+#define FLUSH_INTERVAL 60
+
+static void writeU16(FILE *f, uint16_t value)
+{
+	value = SDL_SwapLE16(value);
+	fwrite(&value, sizeof(value), 1, f);
+}
+
+static void writeU32(FILE *f, uint32_t value)
+{
+	value = SDL_SwapLE32(value);
+	fwrite(&value, sizeof(value), 1, f);
+}
+
+static bool readU16(FILE *f, uint16_t &value)
+{
+	if (fread(&value, sizeof(value), 1, f) != 1)
+		return false;
+
+	value = SDL_SwapLE16(value);
+
+	return true;
+}
+
+static bool readU32(FILE *f, uint32_t &value)
+{
+	if (fread(&value, sizeof(value), 1, f) != 1)
+		return false;
+
+	value = SDL_SwapLE32(value);
+
+	return true;
+}
+
+InputLog::InputLog(const char *path, Mode mode,
+                   int slotCount, uint32_t seed)
+    : f(0),
+      logMode(mode),
+      logSeed(seed),
+      prev(slotCount, 0),
+      unflushed(0)
+{
+	f = fopen(path, mode == Record ? "wb" : "rb");
+
+	if (!f)
+		throw Exception(Exception::MKXPError, "Failed to open input log '%s'", path);
+
+	if (mode == Record)
+	{
+		fwrite(logMagic, sizeof(logMagic), 1, f);
+		writeU32(f, logVersion);
+		writeU32(f, slotCount);
+		writeU32(f, seed);
+
+		return;
+	}
+
+	char magic[sizeof(logMagic)];
+	uint32_t version, slots;
+
+	if (fread(magic, sizeof(magic), 1, f) != 1 ||
+	    memcmp(magic, logMagic, sizeof(magic)) ||
+	    !readU32(f, version) || version != logVersion ||
+	    !readU32(f, slots) || slots != (uint32_t) slotCount ||
+	    !readU32(f, logSeed))
+	{
+		fclose(f);
+		throw Exception(Exception::MKXPError, "'%s' is not a compatible input log", path);
+	}
+}
+
+InputLog::~InputLog()
+{
+	fclose(f);
+}
+
+void InputLog::write(unsigned int frame, const int32_t *state)
+{
+	uint16_t changes = 0;
+
+	for (size_t i = 0; i < prev.size(); ++i)
+		if (state[i] != prev[i])
+			++changes;
+
+	writeU32(f, frame);
+	writeU16(f, changes);
+
+	for (size_t i = 0; i < prev.size(); ++i)
+	{
+		if (state[i] == prev[i])
+			continue;
+
+		writeU16(f, i);
+		writeU32(f, state[i]);
+		prev[i] = state[i];
+	}
+
+	/* A crashed session is the one most worth replaying,
+	 * but a flush on every update would cost a syscall
+	 * per frame */
+	if (++unflushed < FLUSH_INTERVAL)
+		return;
+
+	fflush(f);
+	unflushed = 0;
+}
+
+bool InputLog::read(unsigned int &frame, int32_t *state)
+{
+	uint32_t frameValue;
+	uint16_t changes;
+
+	if (!readU32(f, frameValue) || !readU16(f, changes))
+		return false;
+
+	frame = frameValue;
+
+	for (uint16_t i = 0; i < changes; ++i)
+	{
+		uint16_t slot;
+		uint32_t value;
+
+		if (!readU16(f, slot) || !readU32(f, value))
+			return false;
+
+		/* Corrupt entry; skip rather than write out of bounds */
+		if (slot >= prev.size())
+			continue;
+
+		prev[slot] = (int32_t) value;
+	}
+
+	/* Changes were recorded against the previous logged state,
+	 * so that's what they have to be applied to as well */
+	for (size_t i = 0; i < prev.size(); ++i)
+		state[i] = prev[i];
+
+	return true;
+}
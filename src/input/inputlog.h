@@ -0,0 +1,78 @@
+/*
+** inputlog.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INPUTLOG_H
+#define INPUTLOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+/* Per-update input state log, used to record a play session
+ * and feed it back into Input later on.
+ *
+ * The input state is treated as a flat array of integer slots.
+ * After a small header (magic, version, slot count, RNG seed),
+ * every update is stored as its frame number followed by the
+ * slots that changed since the previous update:
+ *
+ *   u32 frame, u16 changeCount, changeCount * { u16 slot, i32 value }
+ *
+ * All values are little endian. */
+class InputLog
+{
+public:
+	enum Mode
+	{
+		Record,
+		Replay
+	};
+
+	/* Throws an Exception if the file can't be opened,
+	 * or (for replays) isn't a log for 'slotCount' slots */
+	InputLog(const char *path, Mode mode,
+	         int slotCount, uint32_t seed = 0);
+	~InputLog();
+
+	Mode mode() const { return logMode; }
+	uint32_t seed() const { return logSeed; }
+
+	/* Appends one update. The log is flushed to disk every
+	 * so many updates, so a crash loses at most a second
+	 * or so of input, and on destruction */
+	void write(unsigned int frame, const int32_t *state);
+
+	/* Applies the next update to the last state read and
+	 * stores the result in 'state' (all slots are written).
+	 * Returns false at the end of the log */
+	bool read(unsigned int &frame, int32_t *state);
+
+private:
+	FILE *f;
+	Mode logMode;
+	uint32_t logSeed;
+
+	/* Last state written or read, to diff against */
+	std::vector<int32_t> prev;
+
+	/* Updates written since the last flush */
+	unsigned int unflushed;
+};
+
+#endif // INPUTLOG_H
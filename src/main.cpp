@@ -216,10 +216,21 @@ static void setupWindowIcon(const Config &conf, SDL_Window *win) {
     }
 }
 
+/* Headless runs must work without a display or audio device;
+ * explicit user choices in the environment are kept */
+static void setupHeadlessDrivers() {
+    SDL_setenv("SDL_VIDEODRIVER", "offscreen", 0);
+    SDL_setenv("ALSOFT_DRIVERS", "null", 0);
+}
+
 int main(int argc, char *argv[]) {
     SDL_SetHint(SDL_HINT_VIDEO_MINIMIZE_ON_FOCUS_LOSS, "0");
     SDL_SetHint(SDL_HINT_ACCELEROMETER_AS_JOYSTICK, "0");
 
+    /* The video driver has to be picked before SDL is initialized */
+    if (Config::headlessRequested(argc, argv))
+      setupHeadlessDrivers();
+
 #ifdef GLES2_HEADER
     SDL_SetHint(SDL_HINT_OPENGL_ES_DRIVER, "1");
 #endif
@@ -254,6 +265,18 @@ int main(int argc, char *argv[]) {
     Config conf;
     conf.read(argc, argv);
 
+    /* Headless mode enabled from the config file only */
+    if (conf.headless.enabled && !Config::headlessRequested(argc, argv)) {
+      setupHeadlessDrivers();
+
+      SDL_QuitSubSystem(SDL_INIT_VIDEO);
+      if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0) {
+        showInitError(std::string("Error initializing headless video: ") + SDL_GetError());
+        SDL_Quit();
+        return 0;
+      }
+    }
+
 #if defined(__WIN32__)
     // Create a debug console in debug mode
     if (conf.winConsole) {
@@ -362,6 +385,8 @@ int main(int argc, char *argv[]) {
       winFlags |= SDL_WINDOW_RESIZABLE;
     if (conf.fullscreen)
       winFlags |= SDL_WINDOW_FULLSCREEN_DESKTOP;
+    if (conf.headless.enabled)
+      winFlags |= SDL_WINDOW_HIDDEN;
     
 #ifdef GLES2_HEADER
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES);
@@ -30,6 +30,13 @@
 #include "glstate.h"
 #include "shader.h"
 #include "texpool.h"
+#include "streambuffer.h"
+#include "tileatlascache.h"
+#include "windowbasecache.h"
+#include "animationclock.h"
+#include "frameprofiler.h"
+#include "savewriter.h"
+#include "imagewriter.h"
 #include "font.h"
 #include "eventthread.h"
 #include "gl-util.h"
@@ -37,6 +44,7 @@
 #include "quad.h"
 #include "binding.h"
 #include "exception.h"
+#include "debugwriter.h"
 
 #ifdef MKXPZ_STEAM
 #include "steam/steam.h"
@@ -51,6 +59,17 @@ SharedState *SharedState::instance = 0;
 int SharedState::rgssVersion = 0;
 static GlobalIBO *_globalIBO = 0;
 
+/* Upper bound for tileAtlasCacheSize (in MiB), which keeps
+ * the cache's 32 bit byte accounting well clear of overflow */
+#define TILE_ATLAS_CACHE_MAX 1024
+
+static uint32_t atlasCacheBudget(int sizeMiB)
+{
+	const uint64_t mib = clamp(sizeMiB, 0, TILE_ATLAS_CACHE_MAX);
+
+	return mib * 1024 * 1024;
+}
+
 static const char *gameArchExt()
 {
 	if (rgssVer == 1)
@@ -92,6 +111,20 @@ struct SharedStatePrivate
 
 	TexPool texPool;
 
+	StreamBuffer streamBuffer;
+
+	TileAtlasCache atlasCache;
+
+	WindowBaseCache windowBaseCache;
+
+	AnimationClock animationClock;
+
+	FrameProfiler profiler;
+
+	SaveWriter saveWriter;
+
+	ImageWriter imageWriter;
+
 	SharedFontState fontState;
 	Font *defaultFont;
 
@@ -121,6 +154,7 @@ struct SharedStatePrivate
 	      audio(*threadData),
 	      oneshot(*threadData),
 	      _glState(threadData->config),
+	      atlasCache(atlasCacheBudget(threadData->config.tileAtlasCacheSize)),
 	      fontState(threadData->config),
 	      stampCounter(0)
 	{}
@@ -171,6 +205,21 @@ struct SharedStatePrivate
 		/* Reuse starting values */
 		TEXFBO::allocEmpty(gpTexFBO, globalTexW, globalTexH);
 		TEXFBO::linkFBO(gpTexFBO);
+
+		try
+		{
+			profiler.setCsvPath(config.profile.csvPath.c_str());
+			profiler.setTracePath(config.profile.tracePath.c_str());
+		}
+		catch (const Exception &exc)
+		{
+			Debug() << exc.msg;
+		}
+
+		if (!config.profile.csvPath.empty() || !config.profile.tracePath.empty())
+			profiler.setEnabled(true);
+
+		imageWriter.setPngCompression(config.pngCompressionLevel);
 	}
 
 	~SharedStatePrivate()
@@ -250,6 +299,13 @@ GSATT(Steam&, steam)
 GSATT(GLState&, _glState)
 GSATT(ShaderSet&, shaders)
 GSATT(TexPool&, texPool)
+GSATT(StreamBuffer&, streamBuffer)
+GSATT(TileAtlasCache&, atlasCache)
+GSATT(WindowBaseCache&, windowBaseCache)
+GSATT(AnimationClock&, animationClock)
+GSATT(FrameProfiler&, profiler)
+GSATT(SaveWriter&, saveWriter)
+GSATT(ImageWriter&, imageWriter)
 GSATT(Quad&, gpQuad)
 GSATT(SharedFontState&, fontState)
 
@@ -358,6 +414,7 @@ void SharedState::checkShutdown()
 
 	p->rtData.rqTermAck.set();
 	p->texPool.disable();
+	p->atlasCache.disable();
 	scriptBinding->terminate();
 }
 
@@ -48,6 +48,13 @@ class Steam;
 #endif
 class GLState;
 class TexPool;
+class StreamBuffer;
+class TileAtlasCache;
+class WindowBaseCache;
+class AnimationClock;
+class FrameProfiler;
+class SaveWriter;
+class ImageWriter;
 class Font;
 class SharedFontState;
 struct GlobalIBO;
@@ -86,6 +93,20 @@ struct SharedState
 
 	TexPool &texPool() const;
 
+	StreamBuffer &streamBuffer() const;
+
+	TileAtlasCache &atlasCache() const;
+
+	WindowBaseCache &windowBaseCache() const;
+
+	AnimationClock &animationClock() const;
+
+	FrameProfiler &profiler() const;
+
+	SaveWriter &saveWriter() const;
+
+	ImageWriter &imageWriter() const;
+
 	SharedFontState &fontState() const;
 	Font &defaultFont() const;
 
@@ -7,8 +7,31 @@
 
 #include <string>
 #include <iostream>
+#include <mutex>
+#include <condition_variable>
 #include <unistd.h>
 
+/* Where threads blocked in AtomicFlag::wait() sleep. Such waits
+ * are rare and short, so all flags share one wakeup channel;
+ * woken waiters simply recheck their own flag */
+struct FlagParking
+{
+	std::mutex mutex;
+	std::condition_variable cond;
+	SDL_atomic_t waiters;
+
+	FlagParking()
+	{
+		SDL_AtomicSet(&waiters, 0);
+	}
+
+	static FlagParking &get()
+	{
+		static FlagParking parking;
+		return parking;
+	}
+};
+
 struct AtomicFlag
 {
 	AtomicFlag()
@@ -29,11 +52,40 @@ struct AtomicFlag
 	void clear()
 	{
 		SDL_AtomicSet(&atom, 0);
+
+		/* Both this and the waiter's increment are full barriers,
+		 * so either we see the waiter here, or it sees the cleared
+		 * flag before going to sleep */
+		FlagParking &parking = FlagParking::get();
+
+		if (SDL_AtomicGet(&parking.waiters))
+		{
+			std::lock_guard<std::mutex> lock(parking.mutex);
+			parking.cond.notify_all();
+		}
 	}
     
-    void wait()
+    /* Blocks until the flag is cleared */
+    void wait() const
     {
-        while (SDL_AtomicGet(&atom)) {}
+        if (!SDL_AtomicGet(&atom))
+            return;
+        
+        /* Most waits end within microseconds; don't pay
+         * for a sleep/wakeup round trip on those */
+        for (int i = 0; i < 64; ++i)
+            if (!SDL_AtomicGet(&atom))
+                return;
+        
+        FlagParking &parking = FlagParking::get();
+        std::unique_lock<std::mutex> lock(parking.mutex);
+        
+        SDL_AtomicAdd(&parking.waiters, 1);
+        
+        while (SDL_AtomicGet(&atom))
+            parking.cond.wait(lock);
+        
+        SDL_AtomicAdd(&parking.waiters, -1);
     }
     
     void reset()